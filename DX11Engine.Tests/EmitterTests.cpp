@@ -0,0 +1,427 @@
+#include "Test.h"
+#include "../DX11Engine/Emitter.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Floats per particle in ParticleArrays
+#define FIELD_COUNT		17
+
+// --------------------------------------------------------
+// What the test emitters are made with, kept so the scalar
+// update can use the same values
+// --------------------------------------------------------
+struct EmitterSettings
+{
+	int MaxParticles;
+	int BurstsPerSecond;
+	int ParticlesPerBurst;
+	float EmitTime;
+	float Lifetime;
+	float StartSize;
+	float EndSize;
+	XMFLOAT4 StartColor;
+	XMFLOAT4 EndColor;
+	XMFLOAT3 Acceleration;
+};
+
+static EmitterSettings MakeSettings(int maxParticles, int burstsPerSecond, int particlesPerBurst, float emitTime, float lifetime)
+{
+	EmitterSettings settings;
+	settings.MaxParticles = maxParticles;
+	settings.BurstsPerSecond = burstsPerSecond;
+	settings.ParticlesPerBurst = particlesPerBurst;
+	settings.EmitTime = emitTime;
+	settings.Lifetime = lifetime;
+	settings.StartSize = 0.1f;
+	settings.EndSize = 1.5f;
+	settings.StartColor = XMFLOAT4(1, 0.5f, 0.25f, 1);
+	settings.EndColor = XMFLOAT4(0, 0, 1, 0);
+	settings.Acceleration = XMFLOAT3(0.5f, -9.8f, 0);
+	return settings;
+}
+
+static Emitter* MakeEmitter(const EmitterSettings& settings, bool analytic = false)
+{
+	return new Emitter(settings.MaxParticles, settings.BurstsPerSecond, settings.ParticlesPerBurst, settings.EmitTime, settings.Lifetime,
+		settings.StartSize, settings.EndSize, 0.0f, 3.0f, -1.0f, 1.0f, settings.StartColor, settings.EndColor,
+		XMFLOAT3(1, 4, 1), XMFLOAT3(-1, 2, -1), XMFLOAT3(1, 2, 3), settings.Acceleration, 0, 0, 0, 0, analytic);
+}
+
+// --------------------------------------------------------
+// A copy of an emitter's particles, field by field, in the
+// order ParticleArrays lists them
+// --------------------------------------------------------
+struct ParticleCopy
+{
+	std::vector<float> Fields[FIELD_COUNT];
+	int Capacity;
+};
+
+static void CopyParticles(Emitter* emitter, ParticleCopy& copy)
+{
+	const ParticleArrays& arrays = emitter->GetParticles();
+	const float* fields[FIELD_COUNT] = {
+		arrays.Position[0], arrays.Position[1], arrays.Position[2],
+		arrays.Color[0], arrays.Color[1], arrays.Color[2], arrays.Color[3],
+		arrays.StartPosition[0], arrays.StartPosition[1], arrays.StartPosition[2],
+		arrays.StartVelocity[0], arrays.StartVelocity[1], arrays.StartVelocity[2],
+		arrays.Size, arrays.Rotation, arrays.RotationalVelocity, arrays.Age };
+
+	copy.Capacity = emitter->GetParticleCapacity();
+	for (int f = 0; f < FIELD_COUNT; f++)
+		copy.Fields[f].assign(fields[f], fields[f] + copy.Capacity);
+}
+
+// --------------------------------------------------------
+// The particle update one particle at a time, as it was
+// before the arrays were split up.  Returns how many died.
+// --------------------------------------------------------
+static int UpdateReference(ParticleCopy& copy, const EmitterSettings& settings, float dt)
+{
+	std::vector<float>* f = copy.Fields;
+	const float* startColor = &settings.StartColor.x;
+	const float* endColor = &settings.EndColor.x;
+	const float* acceleration = &settings.Acceleration.x;
+
+	int died = 0;
+	for (int i = 0; i < copy.Capacity; i++)
+	{
+		float& age = f[16][i];
+		if (age >= settings.Lifetime)
+			continue;
+
+		age += dt;
+		if (age >= settings.Lifetime)
+		{
+			died++;
+			continue;
+		}
+
+		float agePercent = age / settings.Lifetime;
+		f[14][i] += dt * f[15][i];
+
+		for (int c = 0; c < 4; c++)
+			f[3 + c][i] = (endColor[c] - startColor[c]) * agePercent + startColor[c];
+
+		f[13][i] = settings.StartSize + agePercent * (settings.EndSize - settings.StartSize);
+
+		for (int c = 0; c < 3; c++)
+			f[c][i] = acceleration[c] * age * age * 0.5f + f[10 + c][i] * age + f[7 + c][i];
+	}
+
+	return died;
+}
+
+// Largest difference between two copies, relative to size
+static float CompareParticles(const ParticleCopy& a, const ParticleCopy& b)
+{
+	float worst = 0.0f;
+	for (int f = 0; f < FIELD_COUNT; f++)
+	{
+		for (int i = 0; i < a.Capacity; i++)
+		{
+			float x = a.Fields[f][i];
+			float y = b.Fields[f][i];
+			worst = max(worst, fabsf(x - y) / (1.0f + fabsf(x)));
+		}
+	}
+
+	return worst;
+}
+
+TEST(ParticleUpdateMatchesScalar)
+{
+	// Spawning stops at 1.2 seconds, with particles of every age
+	// and some dying on each update after.  1003 leaves padding
+	// at the end of the last block.
+	EmitterSettings settings = MakeSettings(1003, 20, 50, 1.2f, 1.0f);
+	Emitter* emitter = MakeEmitter(settings);
+
+	float dts[4] = { 0.05f, 0.07f, 0.016f, 0.1f };
+	float time = 0.0f;
+	int compared = 0;
+	for (int step = 0; step < 50; step++)
+	{
+		ParticleCopy expected;
+		CopyParticles(emitter, expected);
+		int living = emitter->GetLivingCount();
+
+		float dt = dts[step % 4];
+		int died = UpdateReference(expected, settings, dt);
+		emitter->Update(dt);
+		time += dt;
+
+		ParticleCopy actual;
+		CopyParticles(emitter, actual);
+
+		// Until spawning stops, new particles take over dead slots
+		if (time > settings.EmitTime + 0.01f)
+		{
+			CHECK(CompareParticles(expected, actual) < 1e-5f);
+			CHECK(emitter->GetLivingCount() == living - died);
+			compared++;
+		}
+	}
+
+	CHECK(compared > 10);
+	CHECK(emitter->GetLivingCount() == 0);
+	delete emitter;
+}
+
+TEST(ParallelParticleUpdateMatchesSerial)
+{
+	// Enough particles, over two emitters, for the workers
+	EmitterSettings settings = MakeSettings(20000, 10, 1000, 0.0f, 1.5f);
+	Emitter* serial[2];
+	Emitter* parallel[2];
+	for (int e = 0; e < 2; e++)
+	{
+		serial[e] = MakeEmitter(settings);
+		parallel[e] = MakeEmitter(settings);
+	}
+
+	WorkerPool pool(4);
+	for (int step = 0; step < 40; step++)
+	{
+		// Both sets spawn the same particles
+		srand(step);
+		serial[0]->Update(0.05f);
+		serial[1]->Update(0.05f);
+		srand(step);
+		Emitter::UpdateAll(parallel, 2, 0.05f, &pool);
+	}
+
+	for (int e = 0; e < 2; e++)
+	{
+		ParticleCopy a, b;
+		CopyParticles(serial[e], a);
+		CopyParticles(parallel[e], b);
+		CHECK(serial[e]->GetLivingCount() > PARTICLE_PARALLEL_MIN / 2);
+		CHECK(serial[e]->GetLivingCount() == parallel[e]->GetLivingCount());
+		CHECK(CompareParticles(a, b) == 0.0f);
+
+		delete serial[e];
+		delete parallel[e];
+	}
+}
+
+TEST(AnalyticParticlesMatchSimulated)
+{
+	// Steps of 1/64 second add up exactly in every particle's age
+	// and in the clock, so both emitters spawn and kill the same
+	// particles.  Stopping half a second after the clock wraps
+	// leaves particles spawned on either side of it.
+	EmitterSettings settings = MakeSettings(200, 10, 5, 0.0f, 2.0f);
+	Emitter* simulated = MakeEmitter(settings);
+	Emitter* analytic = MakeEmitter(settings, true);
+
+	const float dt = 1.0f / 64.0f;
+	const int stepNum = (int)(PARTICLE_TIME_WRAP * 64) + 32;
+
+	srand(11);
+	for (int step = 0; step < stepNum; step++)
+		simulated->Update(dt);
+	srand(11);
+	for (int step = 0; step < stepNum; step++)
+		analytic->Update(dt);
+
+	CHECK(analytic->GetParticles().Age == 0);
+	CHECK(analytic->GetLivingCount() == simulated->GetLivingCount());
+
+	const ParticleArrays& arrays = simulated->GetParticles();
+	const ParticleSpawn* spawns = analytic->GetSpawns();
+	float worst = 0.0f;
+	int wrapped = 0;
+	for (int i = 0; i < analytic->GetLivingCount(); i++)
+	{
+		int index = analytic->GetParticleIndex(i);
+		CHECK(index == simulated->GetParticleIndex(i));
+
+		ParticleInstance instance;
+		CHECK(analytic->EvaluateSpawn(spawns[index], instance));
+		if (spawns[index].SpawnTime > PARTICLE_TIME_WRAP - settings.Lifetime)
+			wrapped++;
+
+		float expected[9] = {
+			arrays.Position[0][index], arrays.Position[1][index], arrays.Position[2][index],
+			arrays.Color[0][index], arrays.Color[1][index], arrays.Color[2][index], arrays.Color[3][index],
+			arrays.Size[index], arrays.Rotation[index] };
+		float actual[9] = {
+			instance.Position.x, instance.Position.y, instance.Position.z,
+			instance.Color.x, instance.Color.y, instance.Color.z, instance.Color.w,
+			instance.Size, instance.Rotation };
+
+		for (int f = 0; f < 9; f++)
+			worst = max(worst, fabsf(expected[f] - actual[f]) / (1.0f + fabsf(expected[f])));
+	}
+
+	// The simulated emitter adds rotation up step by step and
+	// divides age by lifetime, where the analytic one multiplies
+	// by the inverse, so they can't agree to the bit.  1e-4 of
+	// each value is the accepted gap, well under a pixel.  The
+	// shader gets no such slack: EvaluateSpawn takes the same
+	// steps as AnalyticParticleVS, in the same order.
+	CHECK(worst < 1e-4f);
+	CHECK(wrapped > 10);
+	CHECK(wrapped < analytic->GetLivingCount());
+
+	delete simulated;
+	delete analytic;
+}
+
+// --------------------------------------------------------
+// Stands in for the context in the emitter's uploads and
+// draws, keeping what it was asked to do.  Maps hand out
+// memory of its own, and fail when told to.
+// --------------------------------------------------------
+struct RecordingContext
+{
+	std::vector<char> Memory;
+	std::vector<D3D11_MAP> Maps;
+	std::vector<UINT> UpdatedBytes;
+	std::vector<UINT> DrawOffsets;		// Of the instance binding, in bytes
+	std::vector<UINT> DrawCounts;
+	bool FailMaps;
+	int Unmaps;
+
+	RecordingContext(int bytes) : Memory(bytes), FailMaps(false), Unmaps(0) {}
+
+	HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT flags, D3D11_MAPPED_SUBRESOURCE* mapped)
+	{
+		Maps.push_back(mapType);
+		if (FailMaps)
+			return E_FAIL;
+
+		mapped->pData = &Memory[0];
+		return S_OK;
+	}
+
+	void Unmap(ID3D11Resource* resource, UINT subresource) { Unmaps++; }
+
+	void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch)
+	{
+		UpdatedBytes.push_back(box->right - box->left);
+	}
+
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) {}
+
+	void IASetVertexBuffers(UINT slot, UINT bufferNum, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+	{
+		DrawOffsets.push_back(offsets[1]);
+	}
+
+	void DrawIndexedInstanced(UINT indexNum, UINT instanceNum, UINT startIndex, INT baseVertex, UINT startInstance)
+	{
+		DrawCounts.push_back(instanceNum);
+	}
+};
+
+TEST(ParticleRingUploadsLiveRange)
+{
+	// 10 particles a frame, up to 40, and nothing dying.  The
+	// ring of 2 * 40 starts over on frames 1, 4 and 6.
+	EmitterSettings settings = MakeSettings(40, 1, 10, 0.0f, 100.0f);
+	Emitter* emitter = MakeEmitter(settings);
+	RecordingContext context(sizeof(ParticleInstance) * settings.MaxParticles * PARTICLE_RING_FRAMES);
+
+	int expectedOffset = 0;
+	for (int frame = 0; frame < 6; frame++)
+	{
+		emitter->Update(1.0f);
+		int living = emitter->GetLivingCount();
+		CHECK(living == min((frame + 1) * 10, settings.MaxParticles));
+
+		bool wraps = expectedOffset + living > settings.MaxParticles * PARTICLE_RING_FRAMES;
+		if (wraps || frame == 0)
+			expectedOffset = 0;
+
+		CHECK(emitter->CopyParticlesToGPU(&context));
+		emitter->DrawParticles(&context);
+
+		CHECK(context.Maps.back() == (wraps || frame == 0 ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE));
+		CHECK(emitter->GetUploadStats().FrameBytes == (int)sizeof(ParticleInstance) * living);
+		CHECK(context.DrawOffsets.back() == sizeof(ParticleInstance) * expectedOffset);
+		CHECK(context.DrawCounts.back() == (UINT)living);
+
+		// The oldest particle is written first
+		const ParticleInstance* first = (const ParticleInstance*)&context.Memory[0] + expectedOffset;
+		CHECK(first->Position.x == emitter->GetParticles().Position[0][emitter->GetParticleIndex(0)]);
+
+		expectedOffset += living;
+	}
+
+	CHECK(emitter->GetUploadStats().Discards == 3);
+	CHECK(context.Unmaps == 6);
+
+	// A failed map leaves the ring alone and draws nothing, so
+	// the next frame still appends after frame 6
+	context.FailMaps = true;
+	CHECK(!emitter->CopyParticlesToGPU(&context));
+	CHECK(emitter->GetUploadStats().FrameBytes == 0);
+	CHECK(context.Unmaps == 6);
+
+	context.FailMaps = false;
+	CHECK(emitter->CopyParticlesToGPU(&context));
+	emitter->DrawParticles(&context);
+	CHECK(context.Maps.back() == D3D11_MAP_WRITE_NO_OVERWRITE);
+	CHECK(context.DrawOffsets.back() == sizeof(ParticleInstance) * expectedOffset);
+
+	delete emitter;
+}
+
+TEST(AnalyticUploadsOnlySpawns)
+{
+	// 30 spawns a frame into a ring of 50, so the second frame's
+	// wrap around the end of the buffer
+	EmitterSettings settings = MakeSettings(50, 1, 30, 0.0f, 1.0f);
+	Emitter* emitter = MakeEmitter(settings, true);
+	RecordingContext context(0);
+
+	emitter->Update(1.0f);
+	CHECK(emitter->CopyParticlesToGPU(&context));
+	CHECK(emitter->GetUploadStats().FrameBytes == (int)sizeof(ParticleSpawn) * 30);
+	CHECK(context.UpdatedBytes.size() == 1);
+
+	// The first 30 die as the next 30 spawn at 30..49 and 0..9
+	emitter->Update(1.0f);
+	CHECK(emitter->CopyParticlesToGPU(&context));
+	emitter->DrawParticles(&context);
+	CHECK(emitter->GetUploadStats().FrameBytes == (int)sizeof(ParticleSpawn) * 30);
+	CHECK(context.UpdatedBytes.size() == 3 && context.UpdatedBytes[1] == sizeof(ParticleSpawn) * 20 && context.UpdatedBytes[2] == sizeof(ParticleSpawn) * 10);
+
+	// Drawn in the same two parts, and nothing new to send
+	CHECK(context.DrawOffsets.size() == 2 && context.DrawOffsets[0] == sizeof(ParticleSpawn) * 30 && context.DrawOffsets[1] == 0);
+	CHECK(emitter->CopyParticlesToGPU(&context));
+	CHECK(emitter->GetUploadStats().FrameBytes == 0);
+	CHECK(emitter->GetUploadStats().TotalBytes == sizeof(ParticleSpawn) * 60);
+	CHECK(context.Maps.empty());
+
+	delete emitter;
+}
+
+BENCHMARK(ParticleUpdateSpeed)
+{
+	WorkerPool pool;
+	int counts[3] = { 1000, 100000, 1000000 };
+
+	for (int c = 0; c < 3; c++)
+	{
+		// One burst fills the emitter, and nothing dies
+		EmitterSettings settings = MakeSettings(counts[c], 1, counts[c], 0.5f, 1000.0f);
+		Emitter* emitter = MakeEmitter(settings);
+		emitter->Update(0.01f);
+
+		ParticleCopy copy;
+		CopyParticles(emitter, copy);
+
+		int runNum = counts[c] < 100000 ? 100 : 10;
+		double scalar = Test::Measure(runNum, [&]() { UpdateReference(copy, settings, 0.0001f); });
+		double simd = Test::Measure(runNum, [&]() { emitter->Update(0.0001f); });
+		double threaded = Test::Measure(runNum, [&]() { Emitter::UpdateAll(&emitter, 1, 0.0001f, &pool); });
+
+		printf("\n  %7d particles: scalar %.3f ms, SIMD %.3f ms, SIMD on %d threads %.3f ms",
+			emitter->GetLivingCount(), scalar, simd, pool.GetThreadCount(), threaded);
+		delete emitter;
+	}
+}
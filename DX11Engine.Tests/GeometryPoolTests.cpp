@@ -0,0 +1,167 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../DX11Engine/GeometryPool.h"
+#include <cmath>
+
+// A pool with no device only runs its allocators, so these
+// check where things would go in the shared buffers
+
+TEST(PoolRangesAreReused)
+{
+	GeometryPool pool(0, 0);
+	UINT indices[6] = {};
+
+	GeometryRange a, b, c;
+	CHECK(pool.AllocateIndices(DXGI_FORMAT_R32_UINT, 6, indices, a));
+	CHECK(pool.AllocateIndices(DXGI_FORMAT_R32_UINT, 6, indices, b));
+	CHECK(a.Page == 0 && a.Offset == 0 && a.Count == 6);
+	CHECK(b.Page == 0 && b.Offset == 6);
+
+	// The gap left by a is taken again before anything new
+	pool.FreeIndices(DXGI_FORMAT_R32_UINT, a);
+	CHECK(a.Page == -1);
+	CHECK(pool.AllocateIndices(DXGI_FORMAT_R32_UINT, 3, indices, c));
+	CHECK(c.Page == 0 && c.Offset == 0);
+
+	// Freeing twice does nothing the second time
+	pool.FreeIndices(DXGI_FORMAT_R32_UINT, a);
+	GeometryAllocatorStats stats = pool.GetIndexStats(DXGI_FORMAT_R32_UINT);
+	CHECK(stats.Used == 9);
+	CHECK(stats.Allocations == 2);
+
+	// Nothing to allocate is a failure, not an empty range
+	GeometryRange empty;
+	CHECK(!pool.AllocateIndices(DXGI_FORMAT_R32_UINT, 0, indices, empty));
+	CHECK(empty.Page == -1);
+}
+
+TEST(PoolGrowsPages)
+{
+	GeometryPool pool(0, 0);
+	const void* streams[2] = {};
+
+	GeometryRange first, big, next;
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, GEOMETRY_POOL_PAGE_VERTICES - 10, streams, first));
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, GEOMETRY_POOL_PAGE_VERTICES * 2, streams, big));
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, 10, streams, next));
+
+	// Bigger than a page gets a page of its own size, and the
+	// first page's leftovers still get used
+	CHECK(first.Page == 0);
+	CHECK(big.Page == 1 && big.Offset == 0);
+	CHECK(next.Page == 0 && next.Offset == GEOMETRY_POOL_PAGE_VERTICES - 10);
+
+	GeometryAllocatorStats stats = pool.GetVertexStats(VERTEX_FORMAT_FULL);
+	CHECK(stats.Capacity == GEOMETRY_POOL_PAGE_VERTICES * 3);
+	CHECK(stats.Used == stats.Capacity);
+}
+
+TEST(PoolKeepsFormatsApart)
+{
+	GeometryPool pool(0, 0);
+	UINT indices[3] = {};
+	const void* streams[2] = {};
+
+	GeometryRange shortRange, longRange, fullRange, splitRange;
+	CHECK(pool.AllocateIndices(DXGI_FORMAT_R16_UINT, 3, indices, shortRange));
+	CHECK(pool.AllocateIndices(DXGI_FORMAT_R32_UINT, 3, indices, longRange));
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, 100, streams, fullRange));
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_SPLIT, 100, streams, splitRange));
+
+	// Each starts at the front of its own pages
+	CHECK(shortRange.Offset == 0 && longRange.Offset == 0);
+	CHECK(fullRange.Offset == 0 && splitRange.Offset == 0);
+
+	CHECK(pool.GetIndexStats(DXGI_FORMAT_R16_UINT).Used == 3);
+	CHECK(pool.GetIndexStats(DXGI_FORMAT_R32_UINT).Used == 3);
+
+	// Both of a split format's streams come out of one range
+	CHECK(pool.GetVertexStats(VERTEX_FORMAT_SPLIT).Used == 100);
+	CHECK(pool.GetVertexStats(VERTEX_FORMAT_PACKED).Used == 0);
+}
+
+TEST(PooledMeshGivesBackItsRanges)
+{
+	GeometryPool pool(0, 0);
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddGrid(4, 4, verts, indices);
+
+	{
+		Mesh mesh(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), 0, VERTEX_FORMAT_SPLIT, &pool);
+		CHECK(mesh.pool == &pool);
+		CHECK(pool.GetVertexStats(VERTEX_FORMAT_SPLIT).Used == verts.size());
+		CHECK(pool.GetIndexStats(mesh.GetIndexFormat()).Used == indices.size());
+	}
+
+	CHECK(pool.GetVertexStats(VERTEX_FORMAT_SPLIT).Used == 0);
+	CHECK(pool.GetIndexStats(DXGI_FORMAT_R16_UINT).Used == 0);
+}
+
+TEST(AllocatorFragmentationFollowsMerges)
+{
+	// Ten ranges of 10 fill it, and every other one of the
+	// first five frees leaves three gaps that can't merge
+	GeometryAllocator allocator(100);
+	unsigned int offsets[10];
+	for (int i = 0; i < 10; i++)
+		offsets[i] = allocator.Allocate(10);
+	CHECK(offsets[9] == 90);
+	CHECK(allocator.GetFragmentation() == 0.0f);
+
+	allocator.Free(offsets[1], 10);
+	allocator.Free(offsets[3], 10);
+	allocator.Free(offsets[5], 10);
+	CHECK(allocator.GetStats().FreeBlocks == 3);
+	CHECK(fabsf(allocator.GetFragmentation() - (1.0f - 10.0f / 30.0f)) < 1e-6f);
+
+	// 30 is free in all, but no block holds 20
+	CHECK(allocator.Allocate(20) == GEOMETRY_ALLOCATION_FAILED);
+
+	// Freeing between two gaps merges all three into one of 30
+	allocator.Free(offsets[2], 10);
+	CHECK(allocator.GetStats().FreeBlocks == 2);
+	CHECK(allocator.GetStats().LargestFreeBlock == 30);
+	CHECK(fabsf(allocator.GetFragmentation() - 0.25f) < 1e-6f);
+
+	allocator.Free(offsets[4], 10);
+	CHECK(allocator.GetStats().FreeBlocks == 1);
+	CHECK(allocator.GetFragmentation() == 0.0f);
+	CHECK(allocator.Allocate(20) == offsets[1]);
+
+	// What's still held, in no particular order
+	allocator.Free(offsets[8], 10);
+	allocator.Free(offsets[1], 20);
+	allocator.Free(offsets[0], 10);
+	allocator.Free(offsets[6], 10);
+	allocator.Free(offsets[9], 10);
+	allocator.Free(offsets[7], 10);
+	GeometryAllocatorStats stats = allocator.GetStats();
+	CHECK(stats.Used == 0 && stats.FreeBlocks == 1 && stats.LargestFreeBlock == 100);
+	CHECK(allocator.GetFragmentation() == 0.0f);
+}
+
+TEST(PoolFallsBackWhenGapsAreTooSmall)
+{
+	GeometryPool pool(0, 0);
+	const void* streams[2] = {};
+	const UINT quarter = GEOMETRY_POOL_PAGE_VERTICES / 4;
+
+	GeometryRange ranges[4];
+	for (int i = 0; i < 4; i++)
+		CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, quarter, streams, ranges[i]));
+	pool.FreeVertices(VERTEX_FORMAT_FULL, ranges[0]);
+	pool.FreeVertices(VERTEX_FORMAT_FULL, ranges[2]);
+
+	// Half a page is free on the first, but only in quarters
+	GeometryAllocatorStats stats = pool.GetVertexStats(VERTEX_FORMAT_FULL);
+	CHECK(stats.Capacity - stats.Used == quarter * 2);
+	CHECK(stats.LargestFreeBlock == quarter);
+
+	// So half a page goes on a new one, and a quarter still fits a gap
+	GeometryRange half, small;
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, quarter * 2, streams, half));
+	CHECK(half.Page == 1 && half.Offset == 0);
+	CHECK(pool.AllocateVertices(VERTEX_FORMAT_FULL, quarter, streams, small));
+	CHECK(small.Page == 0 && (small.Offset == 0 || small.Offset == quarter * 2));
+}
@@ -0,0 +1,30 @@
+#include "Test.h"
+#include <cstdio>
+#include <cstring>
+
+// --------------------------------------------------------
+// Runs every TEST, or every BENCHMARK when given -bench, and
+// exits with the number of failed checks so the post-build
+// step fails the build on any of them
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	bool benchmarks = argc > 1 && strcmp(argv[1], "-bench") == 0;
+
+	std::vector<TestCase>& cases = Test::GetCases();
+	int run = 0;
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		if (cases[i].Benchmark != benchmarks)
+			continue;
+
+		int failures = Test::GetFailureCount();
+		printf("%s", cases[i].Name);
+		cases[i].Function();
+		printf(Test::GetFailureCount() == failures ? " ok\n" : "\n");
+		run++;
+	}
+
+	printf("\n%d %s, %d failed checks\n", run, benchmarks ? "benchmarks" : "tests", Test::GetFailureCount());
+	return Test::GetFailureCount();
+}
@@ -0,0 +1,245 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../DX11Engine/Entity.h"
+#include <cmath>
+#include <cfloat>
+
+// --------------------------------------------------------
+// Every triangle, one at a time (Moller-Trumbore, both
+// sides), for the BVH to be checked and timed against
+// --------------------------------------------------------
+static bool IntersectAll(const std::vector<Vertex>& verts, const std::vector<UINT>& indices, XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit& hit)
+{
+	XMVECTOR o = XMLoadFloat3(&origin);
+	XMVECTOR d = XMLoadFloat3(&direction);
+	bool found = false;
+	hit.Distance = maxDistance;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&verts[indices[i]].Position);
+		XMVECTOR e1 = XMLoadFloat3(&verts[indices[i + 1]].Position) - v0;
+		XMVECTOR e2 = XMLoadFloat3(&verts[indices[i + 2]].Position) - v0;
+
+		XMVECTOR p = XMVector3Cross(d, e2);
+		float det = XMVectorGetX(XMVector3Dot(e1, p));
+		if (fabsf(det) < 1e-12f)
+			continue;
+
+		float inverse = 1.0f / det;
+		XMVECTOR s = o - v0;
+		float u = XMVectorGetX(XMVector3Dot(s, p)) * inverse;
+		XMVECTOR q = XMVector3Cross(s, e1);
+		float v = XMVectorGetX(XMVector3Dot(d, q)) * inverse;
+		float t = XMVectorGetX(XMVector3Dot(e2, q)) * inverse;
+
+		if (u >= 0 && v >= 0 && u + v <= 1 && t >= 0 && t < hit.Distance)
+		{
+			hit.Distance = t;
+			hit.Triangle = (UINT)(i / 3);
+			hit.U = u;
+			hit.V = v;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+// A shuffled sphere over a floor, so the tree can't lean on
+// the triangles' order
+static void BuildScene(int rings, std::vector<Vertex>& verts, std::vector<UINT>& indices, MeshBVH& bvh)
+{
+	TestMeshes::AddSphere(XMFLOAT3(0, 1, 0), 1.0f, rings, rings * 2, verts, indices);
+	TestMeshes::AddGrid(16, 16, verts, indices);
+	TestMeshes::ShuffleTriangles(indices, 3);
+	bvh.Build(&verts[0], &indices[0], (int)indices.size());
+}
+
+// Rays from around the scene towards points near it
+static void BuildRays(int rayNum, std::vector<XMFLOAT3>& origins, std::vector<XMFLOAT3>& directions)
+{
+	UINT seed = 99;
+	for (int r = 0; r < rayNum; r++)
+	{
+		float values[6];
+		for (int i = 0; i < 6; i++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			values[i] = (seed >> 8) / 16777216.0f * 2.0f - 1.0f;
+		}
+
+		XMFLOAT3 origin(values[0] * 4.0f, 2.0f + values[1] * 2.0f, values[2] * 4.0f);
+		XMFLOAT3 target(values[3] * 1.5f, 1.0f + values[4] * 1.5f, values[5] * 1.5f);
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3Normalize(XMLoadFloat3(&target) - XMLoadFloat3(&origin)));
+
+		origins.push_back(origin);
+		directions.push_back(direction);
+	}
+}
+
+TEST(BVHMatchesBruteForce)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	MeshBVH bvh;
+	BuildScene(16, verts, indices, bvh);
+	CHECK(bvh.GetTriangleCount() == (int)indices.size() / 3);
+
+	std::vector<XMFLOAT3> origins;
+	std::vector<XMFLOAT3> directions;
+	BuildRays(2000, origins, directions);
+
+	int mismatches = 0;
+	int hitNum = 0;
+	for (size_t r = 0; r < origins.size(); r++)
+	{
+		BVHHit expected, actual;
+		bool expectedHit = IntersectAll(verts, indices, origins[r], directions[r], FLT_MAX, expected);
+		bool actualHit = bvh.Intersect(origins[r], directions[r], FLT_MAX, actual);
+
+		// Ties on shared edges may pick either triangle, but
+		// never a different distance
+		if (expectedHit != actualHit || (expectedHit && fabsf(expected.Distance - actual.Distance) > 1e-4f))
+			mismatches++;
+		hitNum += expectedHit ? 1 : 0;
+
+		// Anything that hits closer than halfway is occluded there
+		if (expectedHit)
+		{
+			CHECK(bvh.IsOccluded(origins[r], directions[r], expected.Distance * 2.0f));
+			CHECK(!bvh.IsOccluded(origins[r], directions[r], expected.Distance * 0.99f));
+		}
+	}
+
+	CHECK(mismatches == 0);
+	CHECK(hitNum > 0 && hitNum < (int)origins.size());
+}
+
+// An entity of mesh moved, turned and scaled, as the game
+// places them
+static Entity* MakeEntity(Mesh* mesh, XMFLOAT3 position, XMFLOAT3 rotation, float scale)
+{
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+	Entity* entity = new Entity(mesh, (Material*)0, world, position, rotation, XMFLOAT3(scale, scale, scale));
+	entity->UpdateWorldMatrix();
+	return entity;
+}
+
+// --------------------------------------------------------
+// Three spheres down the z axis and off to the side, each
+// moved and scaled differently.  The sphere is finely enough
+// split that its surface is within 0.01 of the radius.
+// --------------------------------------------------------
+struct PickScene
+{
+	GeometryPool Pool;
+	Mesh* SphereMesh;
+	Entity* Entities[3];
+
+	PickScene() : Pool(0, 0)
+	{
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 32, 64, verts, indices);
+
+		MeshData data;
+		TestMeshes::BuildData(verts, indices, data);
+		SphereMesh = new Mesh(data, 0, VERTEX_FORMAT_FULL, &Pool);
+
+		Entities[0] = MakeEntity(SphereMesh, XMFLOAT3(0, 0, 5), XMFLOAT3(0, 0, 0), 1.0f);
+		Entities[1] = MakeEntity(SphereMesh, XMFLOAT3(0, 0, 10), XMFLOAT3(0.3f, 1.2f, 0), 2.0f);
+		Entities[2] = MakeEntity(SphereMesh, XMFLOAT3(5, 0, 5), XMFLOAT3(0, 0.7f, 0.4f), 0.5f);
+	}
+
+	~PickScene()
+	{
+		for (int i = 0; i < 3; i++)
+			delete Entities[i];
+		delete SphereMesh;
+	}
+};
+
+TEST(PickFindsNearestEntity)
+{
+	PickScene scene;
+	BVHHit hit;
+
+	// Through the middle of the first sphere, which hides the second
+	Entity* picked = Entity::Pick(scene.Entities, 3, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit);
+	CHECK(picked == scene.Entities[0]);
+	CHECK(picked && fabsf(hit.Distance - 4.0f) < 0.01f);
+
+	// From the far side the second, scaled up, is nearer
+	picked = Entity::Pick(scene.Entities, 3, XMFLOAT3(0, 0, 20), XMFLOAT3(0, 0, -1), FLT_MAX, hit);
+	CHECK(picked == scene.Entities[1]);
+	CHECK(picked && fabsf(hit.Distance - 8.0f) < 0.02f);
+
+	// The small one off to the side
+	picked = Entity::Pick(scene.Entities, 3, XMFLOAT3(5, 0, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit);
+	CHECK(picked == scene.Entities[2]);
+	CHECK(picked && fabsf(hit.Distance - 4.5f) < 0.01f);
+
+	// Above everything, and stopping short of the first sphere
+	CHECK(Entity::Pick(scene.Entities, 3, XMFLOAT3(0, 2.5f, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit) == 0);
+	CHECK(Entity::Pick(scene.Entities, 3, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), 3.5f, hit) == 0);
+	CHECK(Entity::Pick(scene.Entities, 0, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit) == 0);
+}
+
+TEST(LineOfSightStopsAtEntities)
+{
+	PickScene scene;
+
+	// Blocked by the first sphere, or clear above it
+	CHECK(!Entity::HasLineOfSight(scene.Entities, 3, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 7)));
+	CHECK(Entity::HasLineOfSight(scene.Entities, 3, XMFLOAT3(0, 1.5f, 0), XMFLOAT3(0, 1.5f, 7)));
+
+	// The second sphere's scale reaches up to y = 2 at z = 10
+	CHECK(!Entity::HasLineOfSight(scene.Entities, 3, XMFLOAT3(-5, 1.5f, 10), XMFLOAT3(5, 1.5f, 10)));
+	CHECK(Entity::HasLineOfSight(scene.Entities, 3, XMFLOAT3(-5, 2.5f, 10), XMFLOAT3(5, 2.5f, 10)));
+
+	// A point on a surface can be seen from outside it
+	BVHHit hit;
+	CHECK(Entity::Pick(scene.Entities, 3, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), FLT_MAX, hit) != 0);
+	CHECK(Entity::HasLineOfSight(scene.Entities, 3, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, hit.Distance)));
+	CHECK(Entity::HasLineOfSight(scene.Entities, 3, XMFLOAT3(1, 1, 1), XMFLOAT3(1, 1, 1)));
+}
+
+BENCHMARK(BVHRaySpeed)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	MeshBVH bvh;
+	double build = Test::Measure(1, [&]() { BuildScene(256, verts, indices, bvh); });
+
+	std::vector<XMFLOAT3> origins;
+	std::vector<XMFLOAT3> directions;
+	BuildRays(100000, origins, directions);
+	int rayNum = (int)origins.size();
+
+	BVHHit hit;
+	double closest = Test::Measure(3, [&]()
+	{
+		for (int r = 0; r < rayNum; r++)
+			bvh.Intersect(origins[r], directions[r], FLT_MAX, hit);
+	});
+	double any = Test::Measure(3, [&]()
+	{
+		for (int r = 0; r < rayNum; r++)
+			bvh.IsOccluded(origins[r], directions[r], FLT_MAX);
+	});
+
+	// Brute force on a sample, it's far too slow for them all
+	int sampleNum = 100;
+	double brute = Test::Measure(1, [&]()
+	{
+		for (int r = 0; r < sampleNum; r++)
+			IntersectAll(verts, indices, origins[r], directions[r], FLT_MAX, hit);
+	});
+
+	printf("\n  %d tris, %d nodes, built in %.2f ms: closest hit %.3f us/ray, any hit %.3f us/ray, brute force %.1f us/ray",
+		bvh.GetTriangleCount(), bvh.GetNodeCount(), build,
+		closest * 1000.0 / rayNum, any * 1000.0 / rayNum, brute * 1000.0 / sampleNum);
+}
@@ -0,0 +1,132 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include <algorithm>
+
+// A 16:9 camera at position looking along direction
+static void PlaceCamera(Camera& camera, XMFLOAT3 position, XMFLOAT3 direction)
+{
+	camera.position = position;
+	camera.direction = direction;
+
+	XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&position), XMLoadFloat3(&direction), XMVectorSet(0, 1, 0, 0));
+	XMStoreFloat4x4(&camera.viewMat, XMMatrixTranspose(view));
+}
+
+static XMFLOAT4X4 Translation(float x, float y, float z)
+{
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixTranspose(XMMatrixTranslation(x, y, z)));
+	return world;
+}
+
+TEST(ClustersStayWithinLimits)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 32, 64, verts, indices);
+
+	MeshData data;
+	TestMeshes::BuildData(verts, indices, data);
+
+	UINT next = 0;
+	for (size_t i = 0; i < data.Clusters.size(); i++)
+	{
+		const MeshCluster& cluster = data.Clusters[i];
+		CHECK(cluster.StartIndex == next);
+		CHECK(cluster.IndexCount / 3 <= CLUSTER_MAX_TRIANGLES);
+		next += cluster.IndexCount;
+
+		// Every corner inside the bounding sphere
+		for (UINT j = cluster.StartIndex; j < cluster.StartIndex + cluster.IndexCount; j++)
+		{
+			XMVECTOR offset = XMLoadFloat3(&data.Vertices[data.Indices[j]].Position) - XMLoadFloat3(&cluster.Center);
+			if (XMVectorGetX(XMVector3Length(offset)) > cluster.Radius * 1.0001f)
+			{
+				CHECK(XMVectorGetX(XMVector3Length(offset)) <= cluster.Radius * 1.0001f);
+				break;
+			}
+		}
+	}
+	CHECK(next == indices.size());
+}
+
+TEST(CullStatsAddUp)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 32, 64, verts, indices);
+
+	MeshData data;
+	TestMeshes::BuildData(verts, indices, data);
+	int clusterNum = (int)data.Clusters.size();
+
+	Camera camera(1600, 900);
+	PlaceCamera(camera, XMFLOAT3(0, 0, -5), XMFLOAT3(0, 0, 1));
+
+	std::vector<UINT> visible(clusterNum);
+	std::vector<UINT> counted(clusterNum);
+
+	// In front of the camera: the far side faces away
+	ClusterCullStats stats = {};
+	int visibleNum = MeshClusterizer::CullClusters(&data.Clusters[0], clusterNum, Translation(0, 0, 0), &camera, &visible[0], 0);
+	int countedNum = MeshClusterizer::CullClusters(&data.Clusters[0], clusterNum, Translation(0, 0, 0), &camera, &counted[0], &stats);
+
+	CHECK(visibleNum == countedNum);
+	CHECK(std::equal(visible.begin(), visible.begin() + visibleNum, counted.begin()));
+	CHECK(stats.Clusters == (UINT)clusterNum);
+	CHECK(stats.Triangles == indices.size() / 3);
+	CHECK(stats.FrustumClusters == 0);
+	CHECK(stats.BackfaceClusters > 0);
+	CHECK(stats.Clusters - stats.BackfaceClusters == (UINT)visibleNum);
+
+	// Behind the camera: nothing is left, all of it frustum culled
+	stats = ClusterCullStats();
+	visibleNum = MeshClusterizer::CullClusters(&data.Clusters[0], clusterNum, Translation(0, 0, -20), &camera, &visible[0], &stats);
+
+	CHECK(visibleNum == 0);
+	CHECK(stats.FrustumClusters == (UINT)clusterNum);
+	CHECK(stats.FrustumTriangles == indices.size() / 3);
+	CHECK(stats.BackfaceClusters == 0);
+}
+
+BENCHMARK(CullClustersSpeed)
+{
+	// A field of spheres, roughly half of them in view
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 128, 256, verts, indices);
+
+	MeshData data;
+	TestMeshes::BuildData(verts, indices, data);
+	int clusterNum = (int)data.Clusters.size();
+
+	Camera camera(1600, 900);
+	PlaceCamera(camera, XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1));
+
+	std::vector<XMFLOAT4X4> worlds;
+	for (int x = -8; x < 8; x++)
+	{
+		for (int z = -8; z < 8; z++)
+			worlds.push_back(Translation(x * 4.0f, 0, z * 4.0f));
+	}
+
+	std::vector<UINT> visible(clusterNum);
+	ClusterCullStats stats = {};
+	bool counting = false;
+	int visibleNum = 0;
+
+	auto cull = [&]()
+	{
+		visibleNum = 0;
+		for (size_t i = 0; i < worlds.size(); i++)
+			visibleNum += MeshClusterizer::CullClusters(&data.Clusters[0], clusterNum, worlds[i], &camera, &visible[0], counting ? &stats : 0);
+	};
+
+	double ms = Test::Measure(10, cull);
+	counting = true;
+	double countingMs = Test::Measure(10, cull);
+
+	double clusters = (double)clusterNum * worlds.size();
+	printf("\n  %.0f clusters (%d tris each at most): %.2f ms, %.1f ns per cluster, %.1f ns counting stats; %d visible",
+		clusters, CLUSTER_MAX_TRIANGLES, ms, ms * 1e6 / clusters, countingMs * 1e6 / clusters, visibleNum);
+}
@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../DX11Engine/MeshCodec.h"
+#include "../DX11Engine/MeshOptimizer.h"
+#include <cstring>
+
+static bool VerticesRoundTrip(const void* vertices, int vertNum, int stride)
+{
+	std::vector<unsigned char> encoded;
+	MeshCodec::EncodeVertices(vertices, vertNum, stride, encoded);
+
+	std::vector<unsigned char> decoded((size_t)vertNum * stride + 1);
+	if (!MeshCodec::DecodeVertices(&decoded[0], vertNum, stride, encoded.data(), encoded.size()))
+		return false;
+
+	return memcmp(&decoded[0], vertices, (size_t)vertNum * stride) == 0;
+}
+
+TEST(CodecVerticesRoundTrip)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(1, 2, 3), 5.0f, 24, 32, verts, indices);
+
+	// Counts either side of a group of 16 and a block
+	int vertNums[7] = { 0, 1, 15, 17, MESH_CODEC_BLOCK_VERTICES, MESH_CODEC_BLOCK_VERTICES + 1, (int)verts.size() };
+	for (int i = 0; i < 7; i++)
+		CHECK(VerticesRoundTrip(verts.data(), vertNums[i], sizeof(Vertex)));
+
+	// Noise can't be predicted, so every byte is escaped
+	std::vector<UINT> noise(1000);
+	UINT seed = 12345;
+	for (size_t i = 0; i < noise.size(); i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		noise[i] = seed;
+	}
+	CHECK(VerticesRoundTrip(&noise[0], 250, 16));
+	CHECK(VerticesRoundTrip(&noise[0], 15, MESH_CODEC_MAX_STRIDE - 4));
+}
+
+TEST(CodecIndicesRoundTrip)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 24, 32, verts, indices);
+
+	// Cache ordered and scattered, the best and worst cases
+	std::vector<UINT> ordered = indices;
+	MeshOptimizer::OptimizeVertexCache(&ordered[0], (int)ordered.size(), (int)verts.size());
+	std::vector<UINT> shuffled = indices;
+	TestMeshes::ShuffleTriangles(shuffled, 7);
+
+	const std::vector<UINT>* lists[2] = { &ordered, &shuffled };
+	for (int l = 0; l < 2; l++)
+	{
+		const std::vector<UINT>& list = *lists[l];
+		std::vector<unsigned char> encoded;
+		MeshCodec::EncodeIndices(&list[0], (int)list.size(), encoded);
+
+		std::vector<UINT> decoded(list.size());
+		CHECK(MeshCodec::DecodeIndices(&decoded[0], (int)decoded.size(), encoded.data(), encoded.size()));
+		CHECK(decoded == list);
+	}
+}
+
+TEST(CodecRejectsBadData)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 8, 8, verts, indices);
+	int vertNum = (int)verts.size();
+
+	std::vector<unsigned char> encoded;
+	MeshCodec::EncodeVertices(&verts[0], vertNum, sizeof(Vertex), encoded);
+	std::vector<Vertex> decoded(vertNum);
+
+	// Too short, too long, or asked for the wrong count
+	CHECK(!MeshCodec::DecodeVertices(&decoded[0], vertNum, sizeof(Vertex), &encoded[0], encoded.size() - 1));
+	encoded.push_back(0);
+	CHECK(!MeshCodec::DecodeVertices(&decoded[0], vertNum, sizeof(Vertex), &encoded[0], encoded.size()));
+	encoded.pop_back();
+	CHECK(!MeshCodec::DecodeVertices(&decoded[0], vertNum - 1, sizeof(Vertex), &encoded[0], encoded.size()));
+
+	// Strides the codec doesn't take
+	CHECK(!MeshCodec::DecodeVertices(&decoded[0], vertNum, 6, &encoded[0], encoded.size()));
+	CHECK(!MeshCodec::DecodeVertices(&decoded[0], vertNum, MESH_CODEC_MAX_STRIDE + 4, &encoded[0], encoded.size()));
+
+	// Not whole triangles
+	std::vector<UINT> decodedIndices(indices.size());
+	MeshCodec::EncodeIndices(&indices[0], (int)indices.size(), encoded);
+	CHECK(!MeshCodec::DecodeIndices(&decodedIndices[0], (int)indices.size() - 1, &encoded[0], encoded.size()));
+}
+
+BENCHMARK(CodecSpeed)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 512, 1024, verts, indices);
+	MeshOptimizer::OptimizeVertexCache(&indices[0], (int)indices.size(), (int)verts.size());
+	int vertNum = (int)verts.size();
+	int indexNum = (int)indices.size();
+
+	std::vector<unsigned char> vertexData;
+	std::vector<unsigned char> indexData;
+	double encode = Test::Measure(3, [&]()
+	{
+		MeshCodec::EncodeVertices(&verts[0], vertNum, sizeof(Vertex), vertexData);
+		MeshCodec::EncodeIndices(&indices[0], indexNum, indexData);
+	});
+
+	std::vector<Vertex> decodedVerts(vertNum);
+	std::vector<UINT> decodedIndices(indexNum);
+	double decode = Test::Measure(5, [&]()
+	{
+		MeshCodec::DecodeVertices(&decodedVerts[0], vertNum, sizeof(Vertex), &vertexData[0], vertexData.size());
+		MeshCodec::DecodeIndices(&decodedIndices[0], indexNum, &indexData[0], indexData.size());
+	});
+
+	double rawSize = (double)vertNum * sizeof(Vertex) + (double)indexNum * sizeof(UINT);
+	printf("\n  %d verts, %d indices: %.2fx smaller, encoded in %.2f ms, decoded at %.2f GB/s",
+		vertNum, indexNum, rawSize / (vertexData.size() + indexData.size()), encode, rawSize / (decode * 1e6));
+}
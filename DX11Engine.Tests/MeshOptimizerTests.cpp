@@ -0,0 +1,84 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../DX11Engine/MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+
+// A row of overlapping spheres, which overdraws from most
+// directions, with the triangles in a random order
+static void BuildSpheres(std::vector<Vertex>& verts, std::vector<UINT>& indices)
+{
+	for (int i = 0; i < 5; i++)
+		TestMeshes::AddSphere(XMFLOAT3(i * 0.6f, 0, 0), 1.0f, 16, 32, verts, indices);
+	TestMeshes::ShuffleTriangles(indices, 1);
+}
+
+// Each triangle as its three positions, starting from the
+// smallest so a rotated triangle still compares equal
+static std::vector<std::array<float, 9>> GetTriangles(const std::vector<Vertex>& verts, const std::vector<UINT>& indices, UINT start, UINT count)
+{
+	std::vector<std::array<float, 9>> triangles;
+	for (UINT i = start; i < start + count; i += 3)
+	{
+		std::array<float, 9> corners[3];
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				const XMFLOAT3& p = verts[indices[i + (r + c) % 3]].Position;
+				corners[r][c * 3 + 0] = p.x;
+				corners[r][c * 3 + 1] = p.y;
+				corners[r][c * 3 + 2] = p.z;
+			}
+		}
+		triangles.push_back(*std::min_element(corners, corners + 3));
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST(OptimizeReducesACMRAndOverdraw)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	BuildSpheres(verts, indices);
+
+	std::vector<MeshSubmesh> submeshes(1, MeshSubmesh());
+	submeshes[0].IndexCount[0] = (UINT)indices.size();
+
+	int indexNum = (int)indices.size();
+	float acmrBefore = MeshOptimizer::CalculateACMR(&indices[0], indexNum, (int)verts.size(), VERTEX_CACHE_SIZE);
+	float overdrawBefore = MeshOptimizer::EstimateOverdraw(&verts[0], &indices[0], indexNum, (int)verts.size());
+
+	Mesh::Optimize(verts, indices, submeshes);
+
+	float acmrAfter = MeshOptimizer::CalculateACMR(&indices[0], indexNum, (int)verts.size(), VERTEX_CACHE_SIZE);
+	float overdrawAfter = MeshOptimizer::EstimateOverdraw(&verts[0], &indices[0], indexNum, (int)verts.size());
+
+	CHECK(acmrAfter <= acmrBefore);
+	CHECK(acmrAfter < 1.0f);
+	CHECK(overdrawAfter <= overdrawBefore);
+}
+
+TEST(OptimizeKeepsTrianglesInTheirSubmesh)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	BuildSpheres(verts, indices);
+
+	// Two submeshes, split unevenly
+	std::vector<MeshSubmesh> submeshes(2, MeshSubmesh());
+	submeshes[0].IndexCount[0] = (UINT)indices.size() / 3 / 3 * 3;
+	submeshes[1].StartIndex[0] = submeshes[0].IndexCount[0];
+	submeshes[1].IndexCount[0] = (UINT)indices.size() - submeshes[0].IndexCount[0];
+
+	std::vector<std::array<float, 9>> before[2];
+	for (int i = 0; i < 2; i++)
+		before[i] = GetTriangles(verts, indices, submeshes[i].StartIndex[0], submeshes[i].IndexCount[0]);
+
+	Mesh::Optimize(verts, indices, submeshes);
+
+	for (int i = 0; i < 2; i++)
+		CHECK(GetTriangles(verts, indices, submeshes[i].StartIndex[0], submeshes[i].IndexCount[0]) == before[i]);
+}
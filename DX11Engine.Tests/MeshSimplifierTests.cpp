@@ -0,0 +1,62 @@
+#include "Test.h"
+#include "TestMeshes.h"
+
+TEST(LODChainGetsCoarser)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 32, 64, verts, indices);
+
+	// Two materials, so each is simplified on its own
+	std::vector<MeshSubmesh> submeshes(2, MeshSubmesh());
+	submeshes[0].IndexCount[0] = (UINT)indices.size() / 2;
+	submeshes[1].StartIndex[0] = submeshes[0].IndexCount[0];
+	submeshes[1].IndexCount[0] = (UINT)indices.size() - submeshes[0].IndexCount[0];
+	submeshes[1].MaterialSlot = 1;
+
+	std::vector<MeshLOD> lods;
+	MeshSimplifier::GenerateLODs(&verts[0], (int)verts.size(), indices, lods, submeshes);
+
+	CHECK(lods.size() > 1);
+	CHECK(lods.size() <= MESH_MAX_LODS);
+	CHECK(lods[0].StartIndex == 0);
+	CHECK(lods[0].Error == 0.0f);
+
+	UINT end = 0;
+	for (size_t i = 0; i < lods.size(); i++)
+	{
+		// One after another, with fewer triangles and more error
+		// each time, but nothing like the size of the sphere
+		CHECK(lods[i].StartIndex == end);
+		CHECK(lods[i].IndexCount % 3 == 0);
+		end = lods[i].StartIndex + lods[i].IndexCount;
+
+		if (i > 0)
+		{
+			CHECK(lods[i].IndexCount < lods[i - 1].IndexCount);
+			CHECK(lods[i].Error >= lods[i - 1].Error);
+		}
+		CHECK(lods[i].Error < 0.1f);
+
+		// Submeshes split each LOD between them
+		UINT submeshTotal = 0;
+		for (size_t s = 0; s < submeshes.size(); s++)
+		{
+			CHECK(submeshes[s].StartIndex[i] >= lods[i].StartIndex);
+			CHECK(submeshes[s].StartIndex[i] + submeshes[s].IndexCount[i] <= end);
+			CHECK(submeshes[s].IndexCount[i] > 0);
+			submeshTotal += submeshes[s].IndexCount[i];
+		}
+		CHECK(submeshTotal == lods[i].IndexCount);
+	}
+
+	CHECK(end == indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] >= verts.size())
+		{
+			CHECK(indices[i] < verts.size());
+			break;
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../DX11Engine/MeshCache.h"
+#include "../DX11Engine/MeshStream.h"
+#include <cstdio>
+
+#define STREAM_TEST_CACHE		"MeshStreamTest.meshbin"
+#define STREAM_TEST_HASH		0x1234
+
+// A sphere with its LOD chain, laid out and cached the way
+// Mesh::Load does it
+static void WriteCache(MeshData& data)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 32, 64, verts, indices);
+	TestMeshes::BuildData(verts, indices, data);
+
+	data.LODs.clear();
+	MeshSimplifier::GenerateLODs(&data.Vertices[0], (int)data.Vertices.size(), data.Indices, data.LODs, data.Submeshes);
+	MeshStream::Reorder(data);
+
+	MeshCache::Write(STREAM_TEST_CACHE, STREAM_TEST_HASH, &data.Vertices[0], (int)data.Vertices.size(), &data.Indices[0], (int)data.Indices.size(),
+		&data.LODs[0], (int)data.LODs.size(), &data.Submeshes[0], (int)data.Submeshes.size(), data.Box, data.Sphere);
+}
+
+TEST(CacheLevelsDecodeAlone)
+{
+	MeshData data;
+	WriteCache(data);
+
+	{
+		MeshCache cache(STREAM_TEST_CACHE);
+		CHECK(cache.IsValid(STREAM_TEST_HASH));
+
+		const MeshCacheHeader* header = cache.GetHeader();
+		const MeshCacheLevel* levels = cache.GetLevels();
+		CHECK(header->LODCount > 2);
+
+		// One level at a time ends up the same as all at once
+		std::vector<Vertex> verts(header->VertexCount);
+		std::vector<UINT> indices(header->IndexCount);
+		UINT vertNum = 0;
+		UINT indexNum = 0;
+		for (UINT i = 0; i < header->LODCount; i++)
+		{
+			CHECK(cache.DecodeLevel(i, vertNum, verts.data() + vertNum, indices.data() + indexNum));
+			vertNum += levels[i].VertexCount;
+			indexNum += levels[i].IndexCount;
+		}
+		CHECK(vertNum == header->VertexCount && indexNum == header->IndexCount);
+		CHECK(memcmp(&verts[0], &data.Vertices[0], verts.size() * sizeof(Vertex)) == 0);
+		CHECK(indices == data.Indices);
+
+		// Without the verts before it, a level points past its own
+		if (levels[1].IndexCount > 0)
+			CHECK(!cache.DecodeLevel(1, 0, &verts[0], &indices[0]));
+	}
+
+	remove(STREAM_TEST_CACHE);
+}
+
+TEST(StreamedLevelsAppend)
+{
+	MeshData full;
+	WriteCache(full);
+
+	{
+		MeshStream stream(STREAM_TEST_CACHE, STREAM_TEST_HASH);
+		CHECK(stream.IsOpen());
+		CHECK(!MeshStream(STREAM_TEST_CACHE, STREAM_TEST_HASH + 1).IsOpen());
+
+		GeometryPool pool(0, 0);
+		Mesh mesh(0, 0, 0, 0, 0, VERTEX_FORMAT_PACKED, &pool);
+		Mesh late(0, 0, 0, 0, 0, VERTEX_FORMAT_PACKED, &pool);
+
+		// Only the next level will do
+		MeshData data;
+		CHECK(!stream.Decode(1, data));
+
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		for (int level = 0; level < stream.GetLevelCount(); level++)
+		{
+			CHECK(stream.Decode(level, data));
+			CHECK(data.FirstVertex == verts.size() && data.FirstIndex == indices.size());
+			CHECK(data.TotalVertices == full.Vertices.size() && data.TotalIndices == full.Indices.size());
+			verts.insert(verts.end(), data.Vertices.begin(), data.Vertices.end());
+			indices.insert(indices.end(), data.Indices.begin(), data.Indices.end());
+
+			mesh.SetData(data, 0);
+			CHECK(mesh.vertexCount == verts.size() && mesh.indexCount == indices.size());
+			CHECK(mesh.GetLODCount() == level + 1);
+			CHECK(mesh.GetIndexCount() == (int)data.LODs[0].IndexCount);
+			CHECK(mesh.GetBVH()->GetTriangleCount() == (int)data.LODs[0].IndexCount / 3);
+
+			// The first level reserves room for the rest, so the
+			// mesh never moves in the pool
+			CHECK(mesh.vertexRange.Count == full.Vertices.size());
+			CHECK(pool.GetVertexStats(VERTEX_FORMAT_PACKED).Used == full.Vertices.size());
+			CHECK(pool.GetIndexStats(mesh.GetIndexFormat()).Used == full.Indices.size());
+
+			// A mesh that missed the levels before can't take this one
+			if (level > 0)
+				late.SetData(data, 0);
+			CHECK(late.vertexCount == 0);
+		}
+
+		// Decoding, and packing against the whole mesh's bounds,
+		// loses nothing along the way
+		CHECK(verts.size() == full.Vertices.size());
+		CHECK(memcmp(&verts[0], &full.Vertices[0], verts.size() * sizeof(Vertex)) == 0);
+		CHECK(indices == full.Indices);
+		CHECK(mesh.GetIndexFormat() == Mesh::ChooseIndexFormat((int)full.Vertices.size()));
+		CHECK(!stream.Decode(stream.GetLevelCount(), data));
+	}
+
+	remove(STREAM_TEST_CACHE);
+}
@@ -0,0 +1,152 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include <cfloat>
+
+// A grid trimmed or added to until it has exactly vertNum
+// verts, every one of them used
+static void BuildMesh(int vertNum, std::vector<Vertex>& verts, std::vector<UINT>& indices)
+{
+	TestMeshes::AddGrid(255, 255, verts, indices);	// 65536 verts
+
+	if (vertNum < (int)verts.size())
+	{
+		std::vector<UINT> kept;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			if (indices[i] < (UINT)vertNum && indices[i + 1] < (UINT)vertNum && indices[i + 2] < (UINT)vertNum)
+				kept.insert(kept.end(), indices.begin() + i, indices.begin() + i + 3);
+		}
+		indices.swap(kept);
+		verts.resize(vertNum);
+	}
+
+	while ((int)verts.size() < vertNum)
+	{
+		Vertex vert = verts.back();
+		vert.Position.y += 1.0f;
+		UINT triangle[3] = { 0, (UINT)verts.size() - 1, (UINT)verts.size() };
+		indices.insert(indices.end(), triangle, triangle + 3);
+		verts.push_back(vert);
+	}
+}
+
+TEST(IndexFormatBoundaries)
+{
+	// Indices 0 - 65535 all fit in 16 bits
+	CHECK(Mesh::ChooseIndexFormat(1) == DXGI_FORMAT_R16_UINT);
+	CHECK(Mesh::ChooseIndexFormat(65535) == DXGI_FORMAT_R16_UINT);
+	CHECK(Mesh::ChooseIndexFormat(65536) == DXGI_FORMAT_R16_UINT);
+	CHECK(Mesh::ChooseIndexFormat(65537) == DXGI_FORMAT_R32_UINT);
+
+	CHECK(Mesh::GetIndexSize(DXGI_FORMAT_R16_UINT) == 2);
+	CHECK(Mesh::GetIndexSize(DXGI_FORMAT_R32_UINT) == 4);
+}
+
+TEST(MeshIndexFormatBoundaries)
+{
+	// A pool with no device only runs its allocators, which is
+	// all a Mesh needs to pick its format and ranges
+	GeometryPool pool(0, 0);
+
+	int vertNums[3] = { 65535, 65536, 65537 };
+	DXGI_FORMAT formats[3] = { DXGI_FORMAT_R16_UINT, DXGI_FORMAT_R16_UINT, DXGI_FORMAT_R32_UINT };
+
+	for (int i = 0; i < 3; i++)
+	{
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		BuildMesh(vertNums[i], verts, indices);
+		CHECK((int)verts.size() == vertNums[i]);
+
+		Mesh mesh(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), 0, VERTEX_FORMAT_FULL, &pool);
+		CHECK(mesh.GetIndexFormat() == formats[i]);
+		CHECK(mesh.GetIndexCount() == (int)indices.size());
+	}
+}
+
+TEST(ShortIndicesWithPooledBaseVertex)
+{
+	GeometryPool pool(0, 0);
+
+	// Something already in the pool, so the next mesh starts
+	// past where a 16-bit index could reach on its own
+	std::vector<Vertex> first;
+	std::vector<UINT> firstIndices;
+	BuildMesh(65536, first, firstIndices);
+	Mesh before(&first[0], (int)first.size(), &firstIndices[0], (int)firstIndices.size(), 0, VERTEX_FORMAT_FULL, &pool);
+
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	BuildMesh(65536, verts, indices);
+	Mesh mesh(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), 0, VERTEX_FORMAT_FULL, &pool);
+
+	// Indices stay relative to the mesh, and the base vertex
+	// moves them to where it is in the pool
+	CHECK(mesh.GetIndexFormat() == DXGI_FORMAT_R16_UINT);
+	CHECK(mesh.GetBaseVertex() == 65536);
+	CHECK(mesh.GetStartIndex() == (UINT)firstIndices.size());
+	CHECK(mesh.indexRange.Page == before.indexRange.Page);
+
+	GeometryAllocatorStats shortStats = pool.GetIndexStats(DXGI_FORMAT_R16_UINT);
+	GeometryAllocatorStats longStats = pool.GetIndexStats(DXGI_FORMAT_R32_UINT);
+	CHECK(shortStats.Used == firstIndices.size() + indices.size());
+	CHECK(longStats.Used == 0);
+}
+
+TEST(BoundsHoldEveryVertex)
+{
+	MeshData data;
+	TestMeshes::AddSphere(XMFLOAT3(3, -2, 5), 2.0f, 12, 16, data.Vertices, data.Indices);
+	TestMeshes::AddGrid(8, 3, data.Vertices, data.Indices);
+	Mesh::CalculateBounds(data);
+
+	XMVECTOR boxMin = XMLoadFloat3(&data.Box.Center) - XMLoadFloat3(&data.Box.Extents);
+	XMVECTOR boxMax = XMLoadFloat3(&data.Box.Center) + XMLoadFloat3(&data.Box.Extents);
+	XMVECTOR pointMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR pointMax = XMVectorReplicate(-FLT_MAX);
+	XMVECTOR epsilon = XMVectorReplicate(1e-4f);
+
+	bool inBox = true;
+	bool inSphere = true;
+	for (size_t v = 0; v < data.Vertices.size(); v++)
+	{
+		XMVECTOR point = XMLoadFloat3(&data.Vertices[v].Position);
+		inBox &= XMVector3GreaterOrEqual(point, boxMin - epsilon) && XMVector3LessOrEqual(point, boxMax + epsilon);
+
+		float distance = XMVectorGetX(XMVector3Length(point - XMLoadFloat3(&data.Sphere.Center)));
+		inSphere &= distance <= data.Sphere.Radius * 1.0001f;
+
+		pointMin = XMVectorMin(pointMin, point);
+		pointMax = XMVectorMax(pointMax, point);
+	}
+	CHECK(inBox);
+	CHECK(inSphere);
+
+	// The box touches the outermost verts on every side
+	CHECK(XMVector3NearEqual(boxMin, pointMin, epsilon));
+	CHECK(XMVector3NearEqual(boxMax, pointMax, epsilon));
+}
+
+TEST(BoundsWithFewOrNoVertices)
+{
+	// No verts leaves the defaults rather than reading past the end
+	MeshData empty;
+	Mesh::CalculateBounds(empty);
+	CHECK(empty.Box.Extents.x == BoundingBox().Extents.x && empty.Sphere.Radius == BoundingSphere().Radius);
+
+	// Fewer verts than the reduction takes at once, and the ones
+	// after the last whole four, still count
+	for (int vertNum = 1; vertNum <= 7; vertNum++)
+	{
+		MeshData data;
+		data.Vertices.resize(vertNum);
+		for (int v = 0; v < vertNum; v++)
+			data.Vertices[v].Position = XMFLOAT3((float)v, -(float)(v * v), v == vertNum - 1 ? 10.0f : 0.0f);
+		Mesh::CalculateBounds(data);
+
+		float last = (float)(vertNum - 1);
+		CHECK(data.Box.Center.x == last * 0.5f && data.Box.Extents.x == last * 0.5f);
+		CHECK(data.Box.Center.y == -last * last * 0.5f);
+		CHECK(data.Box.Center.z == (vertNum == 1 ? 10.0f : 5.0f));
+	}
+}
@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "../DX11Engine/ObjLoader.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Whether ParseFloat reads text to the same bits, and stops at
+// the same place, as strtof
+static bool MatchesStrtof(const char* text)
+{
+	const char* p = text;
+	float parsed = ObjLoader::ParseFloat(p, text + strlen(text));
+
+	char* expectedEnd;
+	float expected = strtof(text, &expectedEnd);
+	return memcmp(&parsed, &expected, sizeof(float)) == 0 && p == expectedEnd;
+}
+
+TEST(ParseFloatMatchesStrtofAtEdges)
+{
+	const char* edges[] =
+	{
+		"0", "-0", "+1", "0.1", "-12.5", "3.14159265358979", ".5", "5.",
+		"1e-7", "1E10", "2.5e-3", "-7.25e+2",
+		"1.17549435e-38", "1.1754942e-38", "1.4e-45", "3.4028235e38", "3.4028236e38", "1e39", "1e-46",
+		"123456789012345678901234567890", "0.000000000000000000000000000001",
+		"9007199254740993", "0.30000000000000004", "00000000000000000000000012.75",
+
+		// Exactly halfway between two floats, where rounding to
+		// double first then to float goes the wrong way
+		"16777217", "16777217.000001", "1.000000059604644775390625",
+		"1.0000000596046448", "1.0000000596046446", "33554434.99999999",
+
+		// Few enough digits for the fast path, but the double
+		// product lands exactly on a float halfway point
+		"3.898516168470482e+19",
+	};
+
+	for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++)
+		CHECK(MatchesStrtof(edges[i]));
+
+	// Half-written numbers read as much as strtof does, but the
+	// dangling parts are skipped rather than left for the next
+	const char* broken[] = { "1e", "1e+", "-", "" };
+	for (size_t i = 0; i < sizeof(broken) / sizeof(broken[0]); i++)
+	{
+		const char* p = broken[i];
+		const char* end = p + strlen(p);
+		CHECK(ObjLoader::ParseFloat(p, end) == strtof(broken[i], 0));
+		CHECK(p == end);
+	}
+}
+
+TEST(ParseFloatMatchesStrtofOnRandomText)
+{
+	// Every float printed the ways exporters print them, and
+	// long random digit runs that fall between floats
+	srand(5);
+	char text[64];
+	int mismatches = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		unsigned int bits = ((unsigned int)rand() << 17) ^ ((unsigned int)rand() << 2) ^ (unsigned int)rand();
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		if (value != value || value - value != 0)
+			continue;
+
+		const char* formats[3] = { "%.9g", "%.6f", "%.17g" };
+		snprintf(text, sizeof(text), formats[i % 3], value);
+		mismatches += MatchesStrtof(text) ? 0 : 1;
+
+		int digits = 1 + rand() % 20;
+		int point = rand() % (digits + 1);
+		char* c = text;
+		if (rand() & 1)
+			*c++ = '-';
+		for (int d = 0; d < digits; d++)
+		{
+			if (d == point)
+				*c++ = '.';
+			*c++ = (char)('0' + rand() % 10);
+		}
+		snprintf(c, 8, "e%d", rand() % 80 - 40);
+		mismatches += MatchesStrtof(text) ? 0 : 1;
+	}
+
+	CHECK(mismatches == 0);
+}
+
+TEST(HugeIndicesStayOutOfRange)
+{
+	// 4294967298 wraps around to 2 in 32 bits, which would weld
+	// that corner onto the second one
+	const char* obj =
+		"v 1 2 3\n"
+		"v 4 5 6\n"
+		"v 7 8 9\n"
+		"f 1 2 4294967298\n"
+		"f 1 2 -99999999999\n";
+
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	std::vector<MeshSubmesh> submeshes;
+	ObjLoader::Parse(obj, strlen(obj), verts, indices, submeshes, 1);
+
+	// Both out of range corners have no position, so they're
+	// one vertex at the origin rather than a real one
+	CHECK(indices.size() == 6);
+	CHECK(verts.size() == 3);
+	CHECK(indices[1] == indices[4]);
+
+	UINT outside = indices[1];
+	CHECK(outside < verts.size());
+	CHECK(outside < verts.size() && verts[outside].Position.x == 0 && verts[outside].Position.y == 0);
+}
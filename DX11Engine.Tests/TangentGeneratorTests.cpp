@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include "../DX11Engine/TangentGenerator.h"
+#include <cmath>
+
+// --------------------------------------------------------
+// Lengyel's method one triangle at a time, the way
+// Mesh::CalculateTangents worked before TangentGenerator,
+// for Generate to be checked and timed against
+// --------------------------------------------------------
+static void GenerateReference(Vertex* vertices, int vertNum, const UINT* indices, int indexNum)
+{
+	std::vector<XMFLOAT3> sums(vertNum, XMFLOAT3(0, 0, 0));
+
+	for (int i = 0; i + 2 < indexNum; i += 3)
+	{
+		UINT corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+		const Vertex& v1 = vertices[corners[0]];
+		const Vertex& v2 = vertices[corners[1]];
+		const Vertex& v3 = vertices[corners[2]];
+
+		float x1 = v2.Position.x - v1.Position.x;
+		float y1 = v2.Position.y - v1.Position.y;
+		float z1 = v2.Position.z - v1.Position.z;
+
+		float x2 = v3.Position.x - v1.Position.x;
+		float y2 = v3.Position.y - v1.Position.y;
+		float z2 = v3.Position.z - v1.Position.z;
+
+		float s1 = v2.UV.x - v1.UV.x;
+		float t1 = v2.UV.y - v1.UV.y;
+
+		float s2 = v3.UV.x - v1.UV.x;
+		float t2 = v3.UV.y - v1.UV.y;
+
+		float det = s1 * t2 - s2 * t1;
+		float r = det != 0.0f ? 1.0f / det : 0.0f;
+
+		for (int c = 0; c < 3; c++)
+		{
+			sums[corners[c]].x += (t2 * x1 - t1 * x2) * r;
+			sums[corners[c]].y += (t2 * y1 - t1 * y2) * r;
+			sums[corners[c]].z += (t2 * z1 - t1 * z2) * r;
+		}
+	}
+
+	for (int v = 0; v < vertNum; v++)
+	{
+		// Gram-Schmidt against the normal
+		XMVECTOR n = XMLoadFloat3(&vertices[v].Normal);
+		XMVECTOR t = XMLoadFloat3(&sums[v]);
+		t = t - n * XMVector3Dot(n, t);
+
+		if (XMVectorGetX(XMVector3LengthSq(t)) < 1e-12f)
+		{
+			XMVECTOR axis = fabsf(vertices[v].Normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+			t = XMVector3Cross(n, axis);
+		}
+
+		XMStoreFloat3(&vertices[v].Tangent, XMVector3Normalize(t));
+	}
+}
+
+// Largest angle, in degrees, between two sets of tangents
+static float CompareTangents(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+	float worst = 0.0f;
+	for (size_t v = 0; v < a.size(); v++)
+	{
+		XMVECTOR ta = XMLoadFloat3(&a[v].Tangent);
+		XMVECTOR tb = XMLoadFloat3(&b[v].Tangent);
+
+		// atan2 stays accurate for tiny angles, unlike acos
+		float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(ta, tb)));
+		float cosine = XMVectorGetX(XMVector3Dot(ta, tb));
+		worst = max(worst, XMConvertToDegrees(atan2f(sine, cosine)));
+	}
+
+	return worst;
+}
+
+static void CheckAgainstReference(std::vector<Vertex>& verts, const std::vector<UINT>& indices, int threadCount)
+{
+	std::vector<Vertex> reference = verts;
+	GenerateReference(&reference[0], (int)reference.size(), &indices[0], (int)indices.size());
+	TangentGenerator::Generate(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), threadCount);
+
+	CHECK(CompareTangents(verts, reference) < 0.01f);
+}
+
+TEST(TangentsMatchReference)
+{
+	// Triangle counts that aren't a multiple of 4 leave lanes
+	// at the end unused
+	for (int segments = 5; segments < 9; segments++)
+	{
+		std::vector<Vertex> verts;
+		std::vector<UINT> indices;
+		TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 3, segments, verts, indices);
+		indices.resize(indices.size() - (segments - 5) * 3);
+		CheckAgainstReference(verts, indices, 1);
+	}
+
+	// A degenerate UV triangle adds nothing
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddGrid(4, 4, verts, indices);
+	verts[indices[0]].UV = verts[indices[1]].UV = verts[indices[2]].UV;
+	CheckAgainstReference(verts, indices, 1);
+}
+
+TEST(ThreadedTangentsMatchReference)
+{
+	// Enough triangles to be split between threads
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 128, 128, verts, indices);
+	CHECK(indices.size() / 3 >= TANGENT_PARALLEL_MIN_TRIANGLES);
+
+	std::vector<Vertex> serial = verts;
+	TangentGenerator::Generate(&serial[0], (int)serial.size(), &indices[0], (int)indices.size(), 1);
+	CheckAgainstReference(verts, indices, 4);
+	CHECK(CompareTangents(verts, serial) < 0.01f);
+}
+
+BENCHMARK(TangentSpeed)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(0, 0, 0), 1.0f, 512, 1024, verts, indices);
+	int vertNum = (int)verts.size();
+	int indexNum = (int)indices.size();
+
+	std::vector<Vertex> work = verts;
+	double reference = Test::Measure(5, [&]() { GenerateReference(&work[0], vertNum, &indices[0], indexNum); });
+	double simd = Test::Measure(5, [&]() { TangentGenerator::Generate(&work[0], vertNum, &indices[0], indexNum, 1); });
+	double threaded = Test::Measure(5, [&]() { TangentGenerator::Generate(&work[0], vertNum, &indices[0], indexNum); });
+
+	printf("\n  %d tris: reference %.2f ms, SIMD %.2f ms, SIMD on every thread %.2f ms",
+		indexNum / 3, reference, simd, threaded);
+}
@@ -0,0 +1,45 @@
+#include "Test.h"
+#include <chrono>
+#include <cstdio>
+
+static int failureCount = 0;
+
+std::vector<TestCase>& Test::GetCases()
+{
+	// Made on first use, since registrations run during static
+	// initialization in whatever order the linker picks
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+void Test::Register(const char * name, TestFunction function, bool benchmark)
+{
+	TestCase testCase = { name, function, benchmark };
+	GetCases().push_back(testCase);
+}
+
+void Test::Fail(const char * file, int line, const char * expression)
+{
+	printf("\n  %s(%d): CHECK(%s) failed", file, line, expression);
+	failureCount++;
+}
+
+int Test::GetFailureCount()
+{
+	return failureCount;
+}
+
+double Test::Measure(int runNum, const std::function<void()>& work)
+{
+	double best = 0.0;
+	for (int i = 0; i < runNum; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		work();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (i == 0 || ms < best)
+			best = ms;
+	}
+	return best;
+}
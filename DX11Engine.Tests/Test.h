@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+// --------------------------------------------------------
+// Just enough of a test harness for the engine's CPU side.
+//
+// TEST and BENCHMARK define a function and register it with
+// Main, which runs every test on each build and the
+// benchmarks only when asked to (-bench).  CHECK notes a
+// failure and carries on, so one run reports every broken
+// check instead of stopping at the first.
+// --------------------------------------------------------
+typedef void(*TestFunction)();
+
+struct TestCase
+{
+	const char* Name;
+	TestFunction Function;
+	bool Benchmark;
+};
+
+class Test
+{
+public:
+	static std::vector<TestCase>& GetCases();
+	static void Register(const char* name, TestFunction function, bool benchmark);
+
+	static void Fail(const char* file, int line, const char* expression);
+	static int GetFailureCount();
+
+	// Best of runNum runs of work, in milliseconds
+	static double Measure(int runNum, const std::function<void()>& work);
+};
+
+// Registers a function before main runs
+struct TestRegistration
+{
+	TestRegistration(const char* name, TestFunction function, bool benchmark) { Test::Register(name, function, benchmark); }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	((expression) ? (void)0 : Test::Fail(__FILE__, __LINE__, #expression))
@@ -0,0 +1,97 @@
+#include "TestMeshes.h"
+
+void TestMeshes::AddSphere(XMFLOAT3 center, float radius, int rings, int segments, std::vector<Vertex>& verts, std::vector<UINT>& indices)
+{
+	UINT base = (UINT)verts.size();
+
+	for (int r = 0; r <= rings; r++)
+	{
+		float phi = XM_PI * r / rings;
+		for (int s = 0; s <= segments; s++)
+		{
+			float theta = XM_2PI * s / segments;
+
+			Vertex vert = {};
+			vert.Normal = XMFLOAT3(sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta));
+			vert.Position = XMFLOAT3(center.x + vert.Normal.x * radius, center.y + vert.Normal.y * radius, center.z + vert.Normal.z * radius);
+			vert.UV = XMFLOAT2((float)s / segments, (float)r / rings);
+			verts.push_back(vert);
+		}
+	}
+
+	// Clockwise seen from outside
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			UINT a = base + r * (segments + 1) + s;
+			UINT b = a + segments + 1;
+			UINT quad[6] = { a, a + 1, b, a + 1, b + 1, b };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+void TestMeshes::AddGrid(int width, int height, std::vector<Vertex>& verts, std::vector<UINT>& indices)
+{
+	UINT base = (UINT)verts.size();
+
+	for (int z = 0; z <= height; z++)
+	{
+		for (int x = 0; x <= width; x++)
+		{
+			Vertex vert = {};
+			vert.Position = XMFLOAT3((float)x, 0.0f, (float)z);
+			vert.Normal = XMFLOAT3(0, 1, 0);
+			vert.UV = XMFLOAT2((float)x / width, 1.0f - (float)z / height);
+			verts.push_back(vert);
+		}
+	}
+
+	for (int z = 0; z < height; z++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			UINT a = base + z * (width + 1) + x;
+			UINT b = a + width + 1;
+			UINT quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+}
+
+void TestMeshes::ShuffleTriangles(std::vector<UINT>& indices, unsigned int seed)
+{
+	int triNum = (int)indices.size() / 3;
+	for (int i = triNum - 1; i > 0; i--)
+	{
+		// Numerical Recipes' LCG, so every compiler gets the same order
+		seed = seed * 1664525u + 1013904223u;
+		int j = (int)((seed >> 8) % (unsigned int)(i + 1));
+
+		for (int c = 0; c < 3; c++)
+		{
+			UINT index = indices[i * 3 + c];
+			indices[i * 3 + c] = indices[j * 3 + c];
+			indices[j * 3 + c] = index;
+		}
+	}
+}
+
+void TestMeshes::BuildData(const std::vector<Vertex>& verts, const std::vector<UINT>& indices, MeshData & data)
+{
+	data.Vertices = verts;
+	data.Indices = indices;
+	Mesh::CalculateTangents(&data.Vertices[0], (int)data.Vertices.size(), &data.Indices[0], (int)data.Indices.size());
+
+	MeshLOD full = { 0, (UINT)data.Indices.size(), 0.0f };
+	data.LODs.assign(1, full);
+
+	MeshSubmesh whole = {};
+	whole.IndexCount[0] = (UINT)data.Indices.size();
+	data.Submeshes.assign(1, whole);
+
+	Mesh::CalculateBounds(data);
+	Mesh::BuildClusters(data);
+	Mesh::BuildBVH(data);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../DX11Engine/Mesh.h"
+#include <vector>
+
+// --------------------------------------------------------
+// Meshes built in code for the tests, so they don't depend
+// on what's in Assets or where they're run from.  Verts come
+// without tangents, the way ObjLoader leaves them.
+// --------------------------------------------------------
+class TestMeshes
+{
+public:
+	// A UV sphere of the given radius around center
+	static void AddSphere(XMFLOAT3 center, float radius, int rings, int segments, std::vector<Vertex>& verts, std::vector<UINT>& indices);
+
+	// A width x height grid of quads on the XZ plane, facing up,
+	// with every vert shared
+	static void AddGrid(int width, int height, std::vector<Vertex>& verts, std::vector<UINT>& indices);
+
+	// Puts the triangles in a random order that's the same for
+	// every run with the same seed
+	static void ShuffleTriangles(std::vector<UINT>& indices, unsigned int seed);
+
+	// Wraps verts and indices up the way the Vertex* Mesh
+	// constructor does: tangents, one LOD, one submesh, bounds,
+	// clusters and BVH
+	static void BuildData(const std::vector<Vertex>& verts, const std::vector<UINT>& indices, MeshData& data);
+};
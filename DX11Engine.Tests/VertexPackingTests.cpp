@@ -0,0 +1,48 @@
+#include "Test.h"
+#include "TestMeshes.h"
+#include <cmath>
+
+TEST(PackingErrorStaysWithinFormatPrecision)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	TestMeshes::AddSphere(XMFLOAT3(3, -2, 5), 10.0f, 32, 64, verts, indices);
+	Mesh::CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+	VertexPackingError error = VertexPacking::MeasureError(&verts[0], (int)verts.size());
+
+	// Half a 16-bit UNORM step of the 20 unit bounds on each axis
+	float step = 20.0f / 65535.0f;
+	CHECK(error.Position <= step * 0.5f * sqrtf(3.0f));
+
+	// Octahedral SNORM16 is good to a few thousandths of a degree
+	CHECK(error.Normal < 0.01f);
+	CHECK(error.Tangent < 0.01f);
+
+	// Half floats have 11 bits of precision below 1
+	CHECK(error.UV <= 1.0f / 2048.0f);
+}
+
+TEST(OctahedralEncodingKeepsAxes)
+{
+	// Every axis, including -z where the octahedron folds over
+	XMFLOAT3 axes[6] = { XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+	for (int i = 0; i < 6; i++)
+	{
+		XMFLOAT3 decoded = VertexPacking::DecodeOctahedral(VertexPacking::EncodeOctahedral(axes[i]));
+		CHECK(fabsf(decoded.x - axes[i].x) < 1e-4f);
+		CHECK(fabsf(decoded.y - axes[i].y) < 1e-4f);
+		CHECK(fabsf(decoded.z - axes[i].z) < 1e-4f);
+	}
+}
+
+TEST(PackedStridesMatchStructs)
+{
+	CHECK(VertexPacking::GetStride(VERTEX_FORMAT_FULL, 0) == sizeof(Vertex));
+	CHECK(VertexPacking::GetStride(VERTEX_FORMAT_PACKED, 0) == sizeof(PackedVertex));
+	CHECK(sizeof(PackedVertex) == 20);
+
+	CHECK(VertexPacking::GetStreamCount(VERTEX_FORMAT_PACKED_SPLIT) == 2);
+	CHECK(VertexPacking::GetStride(VERTEX_FORMAT_PACKED_SPLIT, 0) == sizeof(XMFLOAT3));
+	CHECK(VertexPacking::GetStride(VERTEX_FORMAT_PACKED_SPLIT, 1) == sizeof(PackedVertexAttributes));
+}
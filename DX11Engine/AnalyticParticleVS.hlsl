@@ -0,0 +1,84 @@
+// Must match PARTICLE_TIME_WRAP in Emitter.h
+#define TIME_WRAP 1024.0f
+
+// Constant buffer for C++ data being passed in
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float4 startColor;
+	float4 endColor;
+	float3 acceleration;
+	float time;
+	float inverseLifetime;
+	float startSize;
+	float endSize;
+};
+
+// A corner of the shared quad, and what the particle it's
+// drawn for was spawned with.  The _PER_INSTANCE inputs come
+// from the second slot, laid out like ParticleSpawn.
+struct VertexShaderInput
+{
+	float2 uv				: TEXCOORD;
+	float3 startPosition	: START_POSITION_PER_INSTANCE;
+	float spawnTime			: SPAWN_TIME_PER_INSTANCE;
+	float3 startVelocity	: START_VELOCITY_PER_INSTANCE;
+	float2 rotation			: ROTATION_PER_INSTANCE;	// Start and velocity
+};
+
+// Defines the output data of our vertex shader
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv           : TEXCOORD0;
+	float4 color		: TEXCOORD1;
+};
+
+float2x2 GetRotationMatrix(float rotation)
+{
+	float c = cos(rotation);
+	float s = sin(rotation);
+
+	return float2x2(c, -s, s, c);
+}
+
+// The entry point for our vertex shader
+VertexToPixel main(VertexShaderInput input)
+{
+	// Set up output
+	VertexToPixel output;
+
+	// The same steps, in the same order, as
+	// Emitter::EvaluateSpawn, which AnalyticParticlesMatchSimulated
+	// tests; change both together.  Precise keeps the compiler
+	// from fusing or reordering them.
+	precise float age = time - input.spawnTime;
+	if (age < 0)
+		age += TIME_WRAP;
+	precise float agePercent = age * inverseLifetime;
+
+	precise float3 position = acceleration * age * age * 0.5f + input.startVelocity * age + input.startPosition;
+	precise float4 color = (endColor - startColor) * agePercent + startColor;
+	precise float size = startSize + agePercent * (endSize - startSize);
+	precise float rotation = input.rotation.x + age * input.rotation.y;
+
+	// Calculate output position
+	matrix viewProj = mul(view, projection);
+	output.position = mul(float4(position, 1.0f), viewProj);
+
+	// Use UV to offset position (billboarding)
+	float2 offset = input.uv * 2 - 1;
+	offset *= size;
+	offset.y *= -1;
+	float2x2 rotMat = GetRotationMatrix(rotation);
+	offset = mul(rotMat, offset);
+
+	output.position.xy += offset;
+
+	// Pass uv through
+	output.uv = input.uv;
+	output.color = color;
+
+	return output;
+}
@@ -0,0 +1,485 @@
+#include "AssetLoader.h"
+#include "DDSTextureLoader.h"
+#include <fstream>
+
+AssetLoader::AssetLoader(ID3D11Device* device, ID3D11DeviceContext* context, int threadNum)
+{
+	this->device = device;
+	this->context = context;
+
+	pendingCount = 0;
+	stopping = false;
+
+	BuildPlaceholderCube(placeholderCube);
+
+	if (threadNum <= 0)
+		threadNum = max((int)std::thread::hardware_concurrency() - 1, 1);
+
+	for (int i = 0; i < threadNum; i++)
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	// Whatever never got swapped in is just thrown away
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		delete jobs[i].Mesh;
+		delete jobs[i].Texture;
+	}
+	for (size_t i = 0; i < finished.size(); i++)
+	{
+		delete finished[i].Mesh;
+		delete finished[i].Texture;
+	}
+
+	// Streams between levels aren't in either list
+	for (size_t i = 0; i < streamingMeshes.size(); i++)
+	{
+		if (!streamingMeshes[i]->Loading)
+			delete streamingMeshes[i];
+	}
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i]->View) { textures[i]->View->Release(); }
+		delete textures[i];
+	}
+}
+
+Mesh * AssetLoader::LoadMesh(const char * file, MeshVertexFormat format, GeometryPool * pool)
+{
+	Mesh* mesh = new Mesh(placeholderCube, device, format, pool);
+
+	// Ride along with a load of the same file that's already going
+	for (size_t i = 0; i < loadingMeshes.size(); i++)
+	{
+		if (loadingMeshes[i]->File == file)
+		{
+			loadingMeshes[i]->Meshes.push_back(mesh);
+			pendingCount++;
+			return mesh;
+		}
+	}
+
+	MeshRequest* request = new MeshRequest();
+	request->File = file;
+	request->Meshes.push_back(mesh);
+	request->Succeeded = false;
+	request->Stream = 0;
+	request->Level = 0;
+	request->Loading = true;
+	request->Shown = false;
+	loadingMeshes.push_back(request);
+
+	Job job = { request, 0 };
+	Submit(job);
+	return mesh;
+}
+
+TextureHandle * AssetLoader::LoadTexture(const wchar_t * file, XMFLOAT4 placeholder)
+{
+	TextureRequest* request = new TextureRequest();
+	request->File = file;
+	request->Handle = CreatePlaceholder(placeholder, false);
+	request->Cubemap = false;
+	request->Width = 0;
+	request->Height = 0;
+	request->Succeeded = false;
+
+	Job job = { 0, request };
+	Submit(job);
+	return request->Handle;
+}
+
+TextureHandle * AssetLoader::LoadCubemap(const wchar_t * file, XMFLOAT4 placeholder)
+{
+	TextureRequest* request = new TextureRequest();
+	request->File = file;
+	request->Handle = CreatePlaceholder(placeholder, true);
+	request->Cubemap = true;
+	request->Width = 0;
+	request->Height = 0;
+	request->Succeeded = false;
+
+	Job job = { 0, request };
+	Submit(job);
+	return request->Handle;
+}
+
+// --------------------------------------------------------
+// Creates the GPU side of everything the workers have
+// finished with.  Only call this on the device's thread.
+// --------------------------------------------------------
+void AssetLoader::Update()
+{
+	std::vector<Job> done;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		done.swap(finished);
+	}
+
+	for (size_t i = 0; i < done.size(); i++)
+	{
+		if (done[i].Mesh)
+			FinishMesh(done[i].Mesh);
+		else
+			FinishTexture(done[i].Texture);
+	}
+
+	// Load the next level of anything drawn closer than the
+	// detail it has so far holds up to.  Every mesh's request
+	// is taken, so old ones don't pile up.
+	for (size_t i = 0; i < streamingMeshes.size(); i++)
+	{
+		MeshRequest* request = streamingMeshes[i];
+
+		bool wanted = false;
+		for (size_t j = 0; j < request->Meshes.size(); j++)
+			wanted = request->Meshes[j]->TakeRefinementRequest() || wanted;
+
+		if (!wanted || request->Loading)
+			continue;
+
+		request->Level++;
+		request->Loading = true;
+
+		Job job = { request, 0 };
+		Enqueue(job);
+	}
+}
+
+int AssetLoader::GetPendingCount()
+{
+	return pendingCount;
+}
+
+void AssetLoader::Submit(Job job)
+{
+	pendingCount++;
+
+	Enqueue(job);
+}
+
+void AssetLoader::Enqueue(Job job)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		jobs.push_back(job);
+	}
+	jobAdded.notify_one();
+}
+
+void AssetLoader::WorkerLoop()
+{
+	// WIC is COM, and each thread gets its own factory
+	CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	IWICImagingFactory* factory = 0;
+	CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			jobAdded.wait(guard, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+				break;
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		if (job.Mesh)
+		{
+			LoadMeshLevel(job.Mesh);
+		}
+		else if (job.Texture->Cubemap)
+		{
+			// DDS files are already laid out for the GPU, so there's
+			// nothing to do off the main thread but read them
+			job.Texture->Succeeded = ReadFile(job.Texture->File.c_str(), job.Texture->Data);
+		}
+		else
+		{
+			job.Texture->Succeeded = factory && DecodeImage(factory, job.Texture);
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		finished.push_back(job);
+	}
+
+	if (factory) { factory->Release(); }
+	CoUninitialize();
+}
+
+// --------------------------------------------------------
+// Streams the mesh through its cache when there's one worth
+// streaming, a level per call.  Otherwise loads the whole
+// thing, building the cache for next time, on this worker's
+// thread alone; the other workers are busy with other files.
+// --------------------------------------------------------
+void AssetLoader::LoadMeshLevel(MeshRequest * request)
+{
+	if (!request->Shown && !request->Stream)
+	{
+		MeshStream* stream = new MeshStream(request->File.c_str());
+		if (stream->GetLevelCount() > 1)
+			request->Stream = stream;
+		else
+			delete stream;
+	}
+
+	if (request->Stream)
+		request->Succeeded = request->Stream->Decode(request->Level, request->Data);
+	else
+		request->Succeeded = Mesh::Load(request->File.c_str(), request->Data, 1);
+}
+
+// --------------------------------------------------------
+// Decodes an image file to RGBA8.  Greyscale maps come out
+// with the value in r, g and b, so shaders reading .r still
+// see the same thing.
+// --------------------------------------------------------
+bool AssetLoader::DecodeImage(IWICImagingFactory * factory, TextureRequest * request)
+{
+	IWICBitmapDecoder* decoder = 0;
+	IWICBitmapFrameDecode* frame = 0;
+	IWICFormatConverter* converter = 0;
+
+	bool succeeded =
+		SUCCEEDED(factory->CreateDecoderFromFilename(request->File.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+		SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+		SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+		SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0.0, WICBitmapPaletteTypeCustom)) &&
+		SUCCEEDED(converter->GetSize(&request->Width, &request->Height));
+
+	succeeded = succeeded &&
+		request->Width <= D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION &&
+		request->Height <= D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+
+	if (succeeded)
+	{
+		UINT rowPitch = request->Width * 4;
+		request->Data.resize(rowPitch * request->Height);
+		succeeded = SUCCEEDED(converter->CopyPixels(0, rowPitch, (UINT)request->Data.size(), &request->Data[0]));
+	}
+
+	if (converter) { converter->Release(); }
+	if (frame) { frame->Release(); }
+	if (decoder) { decoder->Release(); }
+
+	return succeeded;
+}
+
+bool AssetLoader::ReadFile(const wchar_t * file, std::vector<unsigned char>& data)
+{
+	std::ifstream stream(file, std::ios::binary | std::ios::ate);
+	if (!stream.is_open())
+		return false;
+
+	data.resize((size_t)stream.tellg());
+	stream.seekg(0);
+	stream.read((char*)data.data(), data.size());
+
+	return !data.empty() && !stream.fail();
+}
+
+void AssetLoader::FinishMesh(MeshRequest * request)
+{
+	// A file that failed to load leaves its meshes as they were,
+	// placeholders or the last level streamed in
+	for (size_t i = 0; i < request->Meshes.size(); i++)
+	{
+		if (request->Succeeded)
+			request->Meshes[i]->SetData(request->Data, device);
+		if (!request->Shown)
+			pendingCount--;
+	}
+
+	// Nothing new can ride along once something's been shown
+	for (size_t i = 0; i < loadingMeshes.size(); i++)
+	{
+		if (loadingMeshes[i] == request)
+		{
+			loadingMeshes.erase(loadingMeshes.begin() + i);
+			break;
+		}
+	}
+
+	bool firstLevel = !request->Shown;
+	request->Shown = true;
+	request->Loading = false;
+	request->Data = MeshData();
+
+	// Wait for the next level to be wanted
+	if (request->Succeeded && request->Stream && request->Level + 1 < request->Stream->GetLevelCount())
+	{
+		if (firstLevel)
+			streamingMeshes.push_back(request);
+		return;
+	}
+
+	for (size_t i = 0; i < streamingMeshes.size(); i++)
+	{
+		if (streamingMeshes[i] == request)
+		{
+			streamingMeshes.erase(streamingMeshes.begin() + i);
+			break;
+		}
+	}
+
+	delete request;
+}
+
+void AssetLoader::FinishTexture(TextureRequest * request)
+{
+	ID3D11ShaderResourceView* view = 0;
+
+	if (request->Succeeded && request->Cubemap)
+	{
+		CreateDDSTextureFromMemory(device, &request->Data[0], request->Data.size(), 0, &view);
+	}
+	else if (request->Succeeded)
+	{
+		// Mip 0 from the decoded image, the rest generated from it
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = request->Width;
+		desc.Height = request->Height;
+		desc.MipLevels = 0;
+		desc.ArraySize = 1;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+		ID3D11Texture2D* texture = 0;
+		if (SUCCEEDED(device->CreateTexture2D(&desc, 0, &texture)))
+		{
+			context->UpdateSubresource(texture, 0, 0, &request->Data[0], request->Width * 4, 0);
+			if (SUCCEEDED(device->CreateShaderResourceView(texture, 0, &view)))
+				context->GenerateMips(view);
+			texture->Release();
+		}
+	}
+
+	// A texture that failed to load keeps its placeholder
+	if (view)
+	{
+		if (request->Handle->View) { request->Handle->View->Release(); }
+		request->Handle->View = view;
+		request->Handle->Loaded = true;
+	}
+
+	pendingCount--;
+	delete request;
+}
+
+// --------------------------------------------------------
+// A 1x1 texture of one colour, or a cube map with every
+// face that colour
+// --------------------------------------------------------
+TextureHandle * AssetLoader::CreatePlaceholder(XMFLOAT4 color, bool cubemap)
+{
+	UINT texel =
+		(UINT)(color.x * 255.0f + 0.5f) |
+		(UINT)(color.y * 255.0f + 0.5f) << 8 |
+		(UINT)(color.z * 255.0f + 0.5f) << 16 |
+		(UINT)(color.w * 255.0f + 0.5f) << 24;
+
+	D3D11_SUBRESOURCE_DATA faces[6] = {};
+	for (int i = 0; i < 6; i++)
+	{
+		faces[i].pSysMem = &texel;
+		faces[i].SysMemPitch = sizeof(UINT);
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = cubemap ? 6 : 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = cubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = desc.Format;
+	viewDesc.ViewDimension = cubemap ? D3D11_SRV_DIMENSION_TEXTURECUBE : D3D11_SRV_DIMENSION_TEXTURE2D;
+	if (cubemap)
+		viewDesc.TextureCube.MipLevels = 1;
+	else
+		viewDesc.Texture2D.MipLevels = 1;
+
+	TextureHandle* handle = new TextureHandle();
+	handle->View = 0;
+	handle->Loaded = false;
+
+	ID3D11Texture2D* texture = 0;
+	if (SUCCEEDED(device->CreateTexture2D(&desc, faces, &texture)))
+	{
+		device->CreateShaderResourceView(texture, &viewDesc, &handle->View);
+		texture->Release();
+	}
+
+	textures.push_back(handle);
+	return handle;
+}
+
+// --------------------------------------------------------
+// A cube from -0.5 to 0.5 on each axis, the same size as the
+// cube and sphere models, so it also covers a light volume
+// --------------------------------------------------------
+void AssetLoader::BuildPlaceholderCube(MeshData & data)
+{
+	// Each face's normal and a direction across it
+	const XMFLOAT3 normals[6] = { XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+	const XMFLOAT3 rights[6] = { XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0), XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(1, 0, 0) };
+	const float corners[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+
+	for (int f = 0; f < 6; f++)
+	{
+		XMVECTOR normal = XMLoadFloat3(&normals[f]);
+		XMVECTOR right = XMLoadFloat3(&rights[f]);
+		XMVECTOR up = XMVector3Cross(right, normal);	// Keeps the corners clockwise from outside
+
+		UINT base = (UINT)data.Vertices.size();
+		for (int c = 0; c < 4; c++)
+		{
+			Vertex vert = {};
+			XMStoreFloat3(&vert.Position, (normal + right * corners[c][0] + up * corners[c][1]) * 0.5f);
+			vert.Normal = normals[f];
+			vert.UV = XMFLOAT2((corners[c][0] + 1) * 0.5f, (1 - corners[c][1]) * 0.5f);
+			data.Vertices.push_back(vert);
+		}
+
+		UINT quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+		data.Indices.insert(data.Indices.end(), quad, quad + 6);
+	}
+
+	Mesh::CalculateTangents(&data.Vertices[0], (int)data.Vertices.size(), &data.Indices[0], (int)data.Indices.size());
+
+	MeshLOD full = { 0, (UINT)data.Indices.size(), 0.0f };
+	data.LODs.assign(1, full);
+
+	MeshSubmesh whole = {};
+	whole.IndexCount[0] = (UINT)data.Indices.size();
+	data.Submeshes.assign(1, whole);
+
+	Mesh::CalculateBounds(data);
+	Mesh::BuildClusters(data);
+	Mesh::BuildBVH(data);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Mesh.h"
+#include "MeshStream.h"
+#include "TextureHandle.h"
+#include "GeometryPool.h"
+#include <DirectXMath.h>
+#include <d3d11.h>
+#include <wincodec.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Loads meshes and textures on worker threads.
+//
+// The Load calls return straight away with something that
+// can be drawn: meshes start out as a unit cube and textures
+// as a single texel of a given colour.  Workers read, parse
+// and decode the files, then Update, called once a frame on
+// the thread that owns the device, creates the GPU resources
+// and swaps them in for the placeholders.
+//
+// Meshes with an up to date cache and several LODs are
+// streamed: the coarsest LOD is swapped in first, and each
+// finer one is only loaded once a mesh is drawn close enough
+// to need it, so far away meshes never spend time decoding
+// detail they don't show.  Buffers have room for every LOD
+// from the start, so each level only decodes and uploads
+// what it adds.
+//
+// A file asked for again while it's still loading is only
+// loaded once.  Meshes belong to whoever asked for them, but
+// must outlive the loader's last Update; texture handles
+// belong to the loader.
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	// threadNum of 0 uses one thread per core, less the main thread's
+	AssetLoader(ID3D11Device* device, ID3D11DeviceContext* context, int threadNum = 0);
+	~AssetLoader();
+
+	Mesh* LoadMesh(const char* file, MeshVertexFormat format = VERTEX_FORMAT_FULL, GeometryPool* pool = 0);
+
+	// PNG, JPG etc. through WIC, with a full mip chain
+	TextureHandle* LoadTexture(const wchar_t* file, XMFLOAT4 placeholder);
+
+	// DDS cube maps, with a cube placeholder to match
+	TextureHandle* LoadCubemap(const wchar_t* file, XMFLOAT4 placeholder);
+
+	// Swaps in everything that has finished loading
+	void Update();
+
+	// Assets asked for that haven't been swapped in yet.  A
+	// streamed mesh stops counting once its first level is in.
+	int GetPendingCount();
+
+private:
+	struct MeshRequest
+	{
+		std::string File;
+		std::vector<Mesh*> Meshes;		// Everything waiting on this file
+		MeshData Data;
+		bool Succeeded;
+
+		MeshStream* Stream;				// Set when it's loaded a level at a time
+		int Level;						// The level being loaded, or last loaded
+		bool Loading;					// Queued or on a worker
+		bool Shown;						// Something has been swapped in
+
+		~MeshRequest() { delete Stream; }
+	};
+
+	struct TextureRequest
+	{
+		std::wstring File;
+		TextureHandle* Handle;
+		bool Cubemap;
+		std::vector<unsigned char> Data;	// RGBA8 texels, or the whole DDS file
+		UINT Width;
+		UINT Height;
+		bool Succeeded;
+	};
+
+	// One of the two is set
+	struct Job
+	{
+		MeshRequest* Mesh;
+		TextureRequest* Texture;
+	};
+
+	void Submit(Job job);
+	void Enqueue(Job job);
+	void WorkerLoop();
+	static void LoadMeshLevel(MeshRequest* request);
+
+	static bool DecodeImage(IWICImagingFactory* factory, TextureRequest* request);
+	static bool ReadFile(const wchar_t* file, std::vector<unsigned char>& data);
+
+	void FinishMesh(MeshRequest* request);
+	void FinishTexture(TextureRequest* request);
+
+	TextureHandle* CreatePlaceholder(XMFLOAT4 color, bool cubemap);
+	static void BuildPlaceholderCube(MeshData& data);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+
+	MeshData placeholderCube;
+	std::vector<TextureHandle*> textures;
+
+	// Only touched on the main thread
+	std::vector<MeshRequest*> loadingMeshes;
+	std::vector<MeshRequest*> streamingMeshes;	// Shown, with finer levels still to load
+	int pendingCount;
+
+	// Shared with the workers, under lock
+	std::mutex lock;
+	std::condition_variable jobAdded;
+	std::deque<Job> jobs;
+	std::vector<Job> finished;
+	bool stopping;
+
+	std::vector<std::thread> workers;
+};
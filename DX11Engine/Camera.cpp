@@ -54,6 +54,25 @@ void Camera::GenerateProjection(float width, float height)
 		100.0f);					// Far clip plane distance
 	XMStoreFloat4x4(&projMat, XMMatrixTranspose(P)); // Transpose for HLSL!
 	XMStoreFloat4x4(&inverseProjMat, XMMatrixTranspose(XMMatrixInverse(nullptr, P)));
+
+	screenHeight = height;
+}
+
+void Camera::GetScreenRay(float x, float y, float width, float height, XMFLOAT3 & origin, XMFLOAT3 & direction)
+{
+	// Pixels to normalized device coordinates, y pointing up
+	float ndcX = x / width * 2.0f - 1.0f;
+	float ndcY = 1.0f - y / height * 2.0f;
+
+	XMMATRIX inverseProj = XMMatrixTranspose(XMLoadFloat4x4(&inverseProjMat));
+	XMMATRIX inverseView = XMMatrixTranspose(XMLoadFloat4x4(&inverseViewMat));
+
+	// The pixel on the near and far planes, back into the world
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0, 1), inverseProj), inverseView);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1, 1), inverseProj), inverseView);
+
+	XMStoreFloat3(&origin, nearPoint);
+	XMStoreFloat3(&direction, XMVector3Normalize(farPoint - nearPoint));
 }
 
 void Camera::CheckInput(float deltaTime)
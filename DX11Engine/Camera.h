@@ -16,10 +16,15 @@ public:
 	void MouseRotate(float x, float y);
 	void GenerateProjection(float width, float height);
 
+	// World space ray through pixel (x, y) of a width by height
+	// screen, starting on the near plane
+	void GetScreenRay(float x, float y, float width, float height, XMFLOAT3& origin, XMFLOAT3& direction);
+
 	XMFLOAT4X4 viewMat;
 	XMFLOAT4X4 inverseViewMat;
 	XMFLOAT4X4 projMat;
 	XMFLOAT4X4 inverseProjMat;
+	float screenHeight;			// In pixels, for projecting sizes onto the screen
 
 	XMFLOAT3 position;
 	XMFLOAT3 direction;
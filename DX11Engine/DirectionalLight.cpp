@@ -1,6 +1,6 @@
 #include "DirectionalLight.h"
 
-DirectionalLight::DirectionalLight(XMFLOAT4X4 world, ID3D11ShaderResourceView* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot) :
+DirectionalLight::DirectionalLight(XMFLOAT4X4 world, TextureHandle* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot) :
 	Light(world, nullptr, sky, vs, ps, sample, ambient, diffuse, pos, rot, XMFLOAT3(1, 1, 1))
 {
 	
@@ -23,7 +23,7 @@ void DirectionalLight::PrepareShader(Camera* camera, ID3D11ShaderResourceView* a
 	pixelShader->SetShaderResourceView("normalBuffer", normal);
 	pixelShader->SetShaderResourceView("depthBuffer", depth);
 	pixelShader->SetShaderResourceView("pbrBuffer", pbr);
-	pixelShader->SetShaderResourceView("SkyTexture", skybox);
+	pixelShader->SetShaderResourceView("SkyTexture", skybox->View);
 	pixelShader->SetMatrix4x4("inView", camera->inverseViewMat);
 	pixelShader->SetMatrix4x4("inProjection", camera->inverseProjMat);
 
@@ -47,5 +47,6 @@ void DirectionalLight::Draw(ID3D11DeviceContext * context, Camera* camera, ID3D1
 
 	PrepareShader(camera, albedo, normal, pbr, depth);
 
-	context->DrawIndexed(3, 0, 0);
+	// Fullscreen triangle made from SV_VertexID, no buffers needed
+	context->Draw(3, 0);
 }
\ No newline at end of file
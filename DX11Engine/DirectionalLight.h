@@ -4,7 +4,7 @@
 class DirectionalLight : public Light
 {
 public:
-	DirectionalLight(XMFLOAT4X4 iWorld, ID3D11ShaderResourceView* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot);
+	DirectionalLight(XMFLOAT4X4 iWorld, TextureHandle* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot);
 	~DirectionalLight();
 
 	void PrepareShader(Camera* camera, ID3D11ShaderResourceView* albedo, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* pbr, ID3D11ShaderResourceView* depth);
@@ -1,7 +1,77 @@
 #include "Emitter.h"
+#include <intrin.h>
+#include <immintrin.h>
+#include <malloc.h>
 
 using namespace DirectX;
 
+// Fields in ParticleArrays, each an array of floats
+#define PARTICLE_FIELD_COUNT	17
+
+// Set bits in each four bit mask
+static const int BitCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// --------------------------------------------------------
+// The handful of operations the particle update needs, four
+// lanes wide with SSE and eight with AVX, so one update
+// works with either
+// --------------------------------------------------------
+struct SSELanes
+{
+	typedef __m128 Type;
+	static const int Width = 4;
+
+	static Type Set(float f) { return _mm_set1_ps(f); }
+	static Type Load(const float* p) { return _mm_load_ps(p); }
+	static void Store(float* p, Type v) { _mm_store_ps(p, v); }
+	static Type Add(Type a, Type b) { return _mm_add_ps(a, b); }
+	static Type Subtract(Type a, Type b) { return _mm_sub_ps(a, b); }
+	static Type Multiply(Type a, Type b) { return _mm_mul_ps(a, b); }
+	static Type Divide(Type a, Type b) { return _mm_div_ps(a, b); }
+	static Type Less(Type a, Type b) { return _mm_cmplt_ps(a, b); }
+	static Type AndNot(Type a, Type b) { return _mm_andnot_ps(a, b); }
+	static Type Select(Type a, Type b, Type mask) { return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b)); }
+	static int Count(Type mask) { return BitCounts[_mm_movemask_ps(mask)]; }
+	static void Finish() {}
+};
+
+struct AVXLanes
+{
+	typedef __m256 Type;
+	static const int Width = 8;
+
+	static Type Set(float f) { return _mm256_set1_ps(f); }
+	static Type Load(const float* p) { return _mm256_load_ps(p); }
+	static void Store(float* p, Type v) { _mm256_store_ps(p, v); }
+	static Type Add(Type a, Type b) { return _mm256_add_ps(a, b); }
+	static Type Subtract(Type a, Type b) { return _mm256_sub_ps(a, b); }
+	static Type Multiply(Type a, Type b) { return _mm256_mul_ps(a, b); }
+	static Type Divide(Type a, Type b) { return _mm256_div_ps(a, b); }
+	static Type Less(Type a, Type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Type AndNot(Type a, Type b) { return _mm256_andnot_ps(a, b); }
+	static Type Select(Type a, Type b, Type mask) { return _mm256_blendv_ps(a, b, mask); }
+	static int Count(Type mask) { int bits = _mm256_movemask_ps(mask); return BitCounts[bits & 15] + BitCounts[bits >> 4]; }
+
+	// Avoids the penalty for going back to SSE code with the
+	// upper halves of the registers still dirty
+	static void Finish() { _mm256_zeroupper(); }
+};
+
+// --------------------------------------------------------
+// Whether the CPU has AVX and the OS saves its registers
+// --------------------------------------------------------
+static bool SupportsAVX()
+{
+	int info[4];
+	__cpuid(info, 1);
+
+	bool osSaves = (info[2] & (1 << 27)) != 0;
+	bool hasAVX = (info[2] & (1 << 28)) != 0;
+	return osSaves && hasAVX && (_xgetbv(0) & 6) == 6;
+}
+
+static const bool UseAVX = SupportsAVX();
+
 Emitter::Emitter(
 	int maxParticles,
 	int burstsPerSecond,
@@ -23,13 +93,15 @@ Emitter::Emitter(
 	ID3D11Device* device,
 	SimpleVertexShader* vs,
 	SimplePixelShader* ps,
-	ID3D11ShaderResourceView* texture
+	TextureHandle* texture,
+	bool analytic
 )
 {
 	// Save params
 	this->vs = vs;
 	this->ps = ps;
 	this->texture = texture;
+	this->analytic = analytic;
 
 	this->maxParticles = maxParticles;
 	this->emitTime = emitTime;
@@ -57,75 +129,219 @@ Emitter::Emitter(
 	firstAliveIndex = 0;
 	firstDeadIndex = 0;
 
-	// Make particle array
-	particles = new Particle[maxParticles];
+	// Make particle arrays, all in one allocation.  Every
+	// particle starts (and the padding stays) dead.  Analytic
+	// particles only need their spawns.
+	particles = {};
+	particleCapacity = 0;
+	particleMemory = 0;
+	if (!analytic)
+	{
+		particleCapacity = (maxParticles + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE * PARTICLE_BLOCK_SIZE;
+		particleMemory = (float*)_aligned_malloc(sizeof(float) * PARTICLE_FIELD_COUNT * particleCapacity, 32);
+		memset(particleMemory, 0, sizeof(float) * PARTICLE_FIELD_COUNT * particleCapacity);
+
+		float* field = particleMemory;
+		for (int i = 0; i < 3; i++, field += particleCapacity) particles.Position[i] = field;
+		for (int i = 0; i < 4; i++, field += particleCapacity) particles.Color[i] = field;
+		for (int i = 0; i < 3; i++, field += particleCapacity) particles.StartPosition[i] = field;
+		for (int i = 0; i < 3; i++, field += particleCapacity) particles.StartVelocity[i] = field;
+		particles.Size = field;					field += particleCapacity;
+		particles.Rotation = field;				field += particleCapacity;
+		particles.RotationalVelocity = field;	field += particleCapacity;
+		particles.Age = field;
+
+		for (int i = 0; i < particleCapacity; i++)
+			particles.Age[i] = lifetime;
+	}
 
-	// Create particle vertices
-	localParticleVertices = new ParticleVertex[4 * maxParticles];
-	for (int i = 0; i < maxParticles * 4; i += 4)
+	// Starts full, so the first upload discards
+	ringInstanceCount = maxParticles * PARTICLE_RING_FRAMES;
+	ringOffset = ringInstanceCount;
+	drawOffset = 0;
+	uploadStats = {};
+
+	analyticTime = 0;
+	analyticClock = 0;
+	inverseLifetime = 1.0f / lifetime;
+	unsentSpawns = 0;
+	instanceBuffer = 0;
+	spawns = 0;
+	spawnBuffer = 0;
+
+	if (analytic)
+	{
+		// Spawns are written a few at a time, anywhere in the
+		// buffer, and the driver keeps frames still being drawn
+		// from seeing them
+		spawns = new ParticleSpawn[maxParticles];
+
+		D3D11_BUFFER_DESC sbDesc = {};
+		sbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		sbDesc.Usage = D3D11_USAGE_DEFAULT;
+		sbDesc.ByteWidth = sizeof(ParticleSpawn) * maxParticles;
+		if (device) { device->CreateBuffer(&sbDesc, 0, &spawnBuffer); }
+	}
+	else
 	{
-		localParticleVertices[i + 0].UV = XMFLOAT2(0, 0);
-		localParticleVertices[i + 1].UV = XMFLOAT2(1, 0);
-		localParticleVertices[i + 2].UV = XMFLOAT2(1, 1);
-		localParticleVertices[i + 3].UV = XMFLOAT2(0, 1);
+		D3D11_BUFFER_DESC vbDesc = {};
+		vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		vbDesc.Usage = D3D11_USAGE_DYNAMIC;
+		vbDesc.ByteWidth = sizeof(ParticleInstance) * ringInstanceCount;
+		if (device) { device->CreateBuffer(&vbDesc, 0, &instanceBuffer); }
 	}
 
+	cornerBuffer = 0;
+	indexBuffer = 0;
+	if (!device)
+		return;
 
-	D3D11_BUFFER_DESC vbDesc = {};
-	vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	vbDesc.Usage = D3D11_USAGE_DYNAMIC;
-	vbDesc.ByteWidth = sizeof(ParticleVertex) * 4 * maxParticles;
-	device->CreateBuffer(&vbDesc, 0, &vertexBuffer);
+	// Every particle is the same quad, its corners told apart by UV
+	XMFLOAT2 corners[4] = { XMFLOAT2(0, 0), XMFLOAT2(1, 0), XMFLOAT2(1, 1), XMFLOAT2(0, 1) };
+	unsigned short indices[6] = { 0, 1, 2, 0, 2, 3 };
 
-	unsigned int* indices = new unsigned int[maxParticles * 6];
-	int indexCount = 0;
-	for (int i = 0; i < maxParticles * 4; i += 4)
-	{
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 1;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i + 3;
-	}
-	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indices;
+	D3D11_BUFFER_DESC cbDesc = {};
+	cbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	cbDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	cbDesc.ByteWidth = sizeof(corners);
+
+	D3D11_SUBRESOURCE_DATA cornerData = {};
+	cornerData.pSysMem = corners;
+	device->CreateBuffer(&cbDesc, &cornerData, &cornerBuffer);
 
 	D3D11_BUFFER_DESC ibDesc = {};
 	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibDesc.CPUAccessFlags = 0;
-	ibDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibDesc.ByteWidth = sizeof(unsigned int) * maxParticles * 6;
-	device->CreateBuffer(&ibDesc, &indexData, &indexBuffer);
+	ibDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	ibDesc.ByteWidth = sizeof(indices);
 
-	delete[] indices;
+	D3D11_SUBRESOURCE_DATA indexData = {};
+	indexData.pSysMem = indices;
+	device->CreateBuffer(&ibDesc, &indexData, &indexBuffer);
 }
 
 
 Emitter::~Emitter()
 {
-	delete[] particles;
-	delete[] localParticleVertices;
-	vertexBuffer->Release();
-	indexBuffer->Release();
+	_aligned_free(particleMemory);
+	delete[] spawns;
+	if (instanceBuffer) { instanceBuffer->Release(); }
+	if (spawnBuffer) { spawnBuffer->Release(); }
+	if (cornerBuffer) { cornerBuffer->Release(); }
+	if (indexBuffer) { indexBuffer->Release(); }
 }
 
 void Emitter::Update(float dt)
 {
+	Emitter* self = this;
+	UpdateAll(&self, 1, dt, 0);
+}
+
+// --------------------------------------------------------
+// Chunks only ever touch their own particles, and each keeps
+// its own count of deaths, so they can run in any order on
+// any thread.  The counts are added up afterwards in chunk
+// order, which is emitter order.
+// --------------------------------------------------------
+void Emitter::UpdateAll(Emitter ** emitters, int emitterNum, float dt, WorkerPool * pool)
+{
+	std::vector<ParticleChunk> chunks;
+	for (int i = 0; i < emitterNum; i++)
+		emitters[i]->AddChunks(chunks);
+
+	int particleNum = 0;
+	for (size_t i = 0; i < chunks.size(); i++)
+		particleNum += (chunks[i].LastBlock - chunks[i].FirstBlock) * PARTICLE_BLOCK_SIZE;
+
+	auto update = [&chunks, dt](int i)
+	{
+		ParticleChunk& chunk = chunks[i];
+		chunk.Died = chunk.Owner->UpdateBlocks(dt, chunk.FirstBlock, chunk.LastBlock);
+	};
+
+	if (pool && particleNum >= PARTICLE_PARALLEL_MIN)
+	{
+		pool->Run((int)chunks.size(), update);
+	}
+	else
+	{
+		for (size_t i = 0; i < chunks.size(); i++)
+			update((int)i);
+	}
+
+	size_t chunk = 0;
+	for (int i = 0; i < emitterNum; i++)
+	{
+		int died = 0;
+		for (; chunk < chunks.size() && chunks[chunk].Owner == emitters[i]; chunk++)
+			died += chunks[chunk].Died;
+
+		emitters[i]->FinishUpdate(dt, died);
+	}
+}
+
+// --------------------------------------------------------
+// Living particles run from firstAliveIndex up to
+// firstDeadIndex, wrapping around.  Whole blocks are
+// updated, as dead particles in them are left alone.
+// --------------------------------------------------------
+void Emitter::AddChunks(std::vector<ParticleChunk>& chunks)
+{
+	// Analytic particles are never updated
+	if (livingParticleCount == 0 || analytic)
+		return;
+
+	int blockCount = particleCapacity / PARTICLE_BLOCK_SIZE;
+	int aliveBlock = firstAliveIndex / PARTICLE_BLOCK_SIZE;
+	int deadBlock = (firstDeadIndex + PARTICLE_BLOCK_SIZE - 1) / PARTICLE_BLOCK_SIZE;
+
 	if (firstAliveIndex < firstDeadIndex)
 	{
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+		AddChunks(chunks, aliveBlock, deadBlock);
+	}
+	else if (deadBlock >= aliveBlock)
+	{
+		AddChunks(chunks, 0, blockCount);		// Both ends share a block
 	}
 	else
 	{
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			UpdateSingleParticle(dt, i);
-		for (int i = 0; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+		AddChunks(chunks, aliveBlock, blockCount);
+		AddChunks(chunks, 0, deadBlock);
+	}
+}
+
+void Emitter::AddChunks(std::vector<ParticleChunk>& chunks, int firstBlock, int lastBlock)
+{
+	const int chunkBlocks = PARTICLE_CHUNK_SIZE / PARTICLE_BLOCK_SIZE;
+
+	for (int block = firstBlock; block < lastBlock; block += chunkBlocks)
+	{
+		ParticleChunk chunk = { this, block, min(block + chunkBlocks, lastBlock), 0 };
+		chunks.push_back(chunk);
+	}
+}
+
+void Emitter::FinishUpdate(float dt, int died)
+{
+	// Analytic particles die once they're older than their
+	// lifetime, so only the ones about to die are looked at.
+	// The clock adds up in double, so small steps aren't lost
+	// to rounding, and is only made a float once wrapped.
+	if (analytic)
+	{
+		analyticTime += dt;
+		if (analyticTime >= PARTICLE_TIME_WRAP)
+			analyticTime -= PARTICLE_TIME_WRAP;
+		analyticClock = (float)analyticTime;
+
+		while (died < livingParticleCount && GetAge(spawns[(firstAliveIndex + died) % maxParticles]) >= lifetime)
+			died++;
 	}
 
+	// All particles live as long, so the oldest die first
+	firstAliveIndex = (firstAliveIndex + died) % maxParticles;
+	livingParticleCount -= died;
+
 	totalTimeSinceEmit += dt;
 	timeSinceEmit += dt;
 
@@ -139,42 +355,85 @@ void Emitter::Update(float dt)
 	}
 }
 
-void Emitter::UpdateSingleParticle(float dt, int index)
+int Emitter::UpdateBlocks(float dt, int firstBlock, int lastBlock)
 {
-	if (particles[index].Age >= lifetime)
-		return;
+	if (UseAVX)
+		return UpdateBlocks<AVXLanes>(dt, firstBlock, lastBlock);
+	return UpdateBlocks<SSELanes>(dt, firstBlock, lastBlock);
+}
+
+// --------------------------------------------------------
+// Ages every particle in the blocks, then moves, spins and
+// fades the ones still alive.  Particles that were already
+// dead, or die now, keep everything but their age as it was.
+// --------------------------------------------------------
+template<class Lanes>
+int Emitter::UpdateBlocks(float dt, int firstBlock, int lastBlock)
+{
+	typedef typename Lanes::Type Type;
 
-	particles[index].Age += dt;
-	if (particles[index].Age >= lifetime)
+	Type deltaTime = Lanes::Set(dt);
+	Type life = Lanes::Set(lifetime);
+	Type half = Lanes::Set(0.5f);
+
+	Type sizeStart = Lanes::Set(startSize);
+	Type sizeRange = Lanes::Set(endSize - startSize);
+
+	const float* colorStart = &startColor.x;
+	const float* colorEnd = &endColor.x;
+	Type colorFrom[4];
+	Type colorRange[4];
+	for (int c = 0; c < 4; c++)
 	{
-		// move alive count
-		firstAliveIndex++;
-		firstAliveIndex %= maxParticles;
-		livingParticleCount--;
-		return;
+		colorFrom[c] = Lanes::Set(colorStart[c]);
+		colorRange[c] = Lanes::Set(colorEnd[c] - colorStart[c]);
 	}
 
-	float agePercent = particles[index].Age / lifetime;
+	const float* acceleration = &emitterAcceleration.x;
+	Type accel[3];
+	for (int c = 0; c < 3; c++)
+		accel[c] = Lanes::Set(acceleration[c]);
+
+	int died = 0;
+	int end = lastBlock * PARTICLE_BLOCK_SIZE;
+	for (int i = firstBlock * PARTICLE_BLOCK_SIZE; i < end; i += Lanes::Width)
+	{
+		Type age = Lanes::Load(particles.Age + i);
+		Type wasAlive = Lanes::Less(age, life);
+
+		age = Lanes::Select(age, Lanes::Add(age, deltaTime), wasAlive);
+		Lanes::Store(particles.Age + i, age);
+
+		Type alive = Lanes::Less(age, life);
+		died += Lanes::Count(Lanes::AndNot(alive, wasAlive));
+
+		Type agePercent = Lanes::Divide(age, life);
 
-	particles[index].Rotation += dt * particles[index].RotationalVelocity;
+		Type rotation = Lanes::Load(particles.Rotation + i);
+		Type spun = Lanes::Add(rotation, Lanes::Multiply(deltaTime, Lanes::Load(particles.RotationalVelocity + i)));
+		Lanes::Store(particles.Rotation + i, Lanes::Select(rotation, spun, alive));
 
-	XMStoreFloat4(
-		&particles[index].Color,
-		XMVectorLerp(
-			XMLoadFloat4(&startColor),
-			XMLoadFloat4(&endColor),
-			agePercent));
+		for (int c = 0; c < 4; c++)
+		{
+			Type color = Lanes::Add(Lanes::Multiply(colorRange[c], agePercent), colorFrom[c]);
+			Lanes::Store(particles.Color[c] + i, Lanes::Select(Lanes::Load(particles.Color[c] + i), color, alive));
+		}
 
-	particles[index].Size = startSize + agePercent * (endSize - startSize);
+		Type size = Lanes::Add(sizeStart, Lanes::Multiply(agePercent, sizeRange));
+		Lanes::Store(particles.Size + i, Lanes::Select(Lanes::Load(particles.Size + i), size, alive));
 
-	XMVECTOR startPos = XMLoadFloat3(&particles[index].StartPosition);
-	XMVECTOR startVel = XMLoadFloat3(&particles[index].StartVelocity);
-	XMVECTOR accel = XMLoadFloat3(&emitterAcceleration);
-	float t = particles[index].Age;
+		// accel * t * t / 2 + startVel * t + startPos
+		for (int c = 0; c < 3; c++)
+		{
+			Type fall = Lanes::Multiply(Lanes::Multiply(Lanes::Multiply(accel[c], age), age), half);
+			Type travel = Lanes::Multiply(Lanes::Load(particles.StartVelocity[c] + i), age);
+			Type position = Lanes::Add(Lanes::Add(fall, travel), Lanes::Load(particles.StartPosition[c] + i));
+			Lanes::Store(particles.Position[c] + i, Lanes::Select(Lanes::Load(particles.Position[c] + i), position, alive));
+		}
+	}
 
-	XMStoreFloat3(
-		&particles[index].Position,
-		accel * t * t / 2.0f + startVel * t + startPos);
+	Lanes::Finish();
+	return died;
 }
 
 void Emitter::ResetParticle(int index)
@@ -185,17 +444,38 @@ void Emitter::ResetParticle(int index)
 	float rRange = maxRotation - minRotation;
 	float rVRange = maxRotVel - minRotVel;
 
-	particles[index].Age = 0;
-	particles[index].Size = startSize;
-	particles[index].Color = startColor;
-	particles[index].Position = emitterPosition;
-	particles[index].Rotation = minRotation + (((float)rand() / RAND_MAX) * rRange);
-	particles[index].RotationalVelocity = minRotVel + (((float)rand() / RAND_MAX) * rVRange);
-	particles[index].StartPosition = emitterPosition;
-	particles[index].StartVelocity = XMFLOAT3(0, 0, 0);
-	particles[index].StartVelocity.x = minStartVelocity.x + (((float)rand() / RAND_MAX) * xVelocityRange);
-	particles[index].StartVelocity.y = minStartVelocity.y + (((float)rand() / RAND_MAX) * yVelocityRange);
-	particles[index].StartVelocity.z = minStartVelocity.z + (((float)rand() / RAND_MAX) * zVelocityRange);
+	// Analytic particles are written straight to their spawn,
+	// with the random values drawn in the same order
+	if (analytic)
+	{
+		ParticleSpawn& spawn = spawns[index];
+		spawn.StartPosition = emitterPosition;
+		spawn.SpawnTime = analyticClock;
+		spawn.StartRotation = minRotation + (((float)rand() / RAND_MAX) * rRange);
+		spawn.RotationalVelocity = minRotVel + (((float)rand() / RAND_MAX) * rVRange);
+		spawn.StartVelocity.x = minStartVelocity.x + (((float)rand() / RAND_MAX) * xVelocityRange);
+		spawn.StartVelocity.y = minStartVelocity.y + (((float)rand() / RAND_MAX) * yVelocityRange);
+		spawn.StartVelocity.z = minStartVelocity.z + (((float)rand() / RAND_MAX) * zVelocityRange);
+		return;
+	}
+
+	particles.Age[index] = 0;
+	particles.Size[index] = startSize;
+	particles.Color[0][index] = startColor.x;
+	particles.Color[1][index] = startColor.y;
+	particles.Color[2][index] = startColor.z;
+	particles.Color[3][index] = startColor.w;
+	particles.Position[0][index] = emitterPosition.x;
+	particles.Position[1][index] = emitterPosition.y;
+	particles.Position[2][index] = emitterPosition.z;
+	particles.Rotation[index] = minRotation + (((float)rand() / RAND_MAX) * rRange);
+	particles.RotationalVelocity[index] = minRotVel + (((float)rand() / RAND_MAX) * rVRange);
+	particles.StartPosition[0][index] = emitterPosition.x;
+	particles.StartPosition[1][index] = emitterPosition.y;
+	particles.StartPosition[2][index] = emitterPosition.z;
+	particles.StartVelocity[0][index] = minStartVelocity.x + (((float)rand() / RAND_MAX) * xVelocityRange);
+	particles.StartVelocity[1][index] = minStartVelocity.y + (((float)rand() / RAND_MAX) * yVelocityRange);
+	particles.StartVelocity[2][index] = minStartVelocity.z + (((float)rand() / RAND_MAX) * zVelocityRange);
 }
 
 void Emitter::ResetEmitter()
@@ -216,87 +496,109 @@ void Emitter::SpawnParticle()
 
 	ResetParticle(firstDeadIndex);
 
+	if (analytic)
+		unsentSpawns = min(unsentSpawns + 1, maxParticles);
+
 	firstDeadIndex++;
 	firstDeadIndex %= maxParticles;
 
 	livingParticleCount++;
 }
 
-void Emitter::CopyParticlesToGPU(ID3D11DeviceContext* context)
+void Emitter::CopyOneParticle(int index, ParticleInstance& instance)
 {
-	if (firstAliveIndex < firstDeadIndex)
+	instance.Position = XMFLOAT3(particles.Position[0][index], particles.Position[1][index], particles.Position[2][index]);
+	instance.Color = XMFLOAT4(particles.Color[0][index], particles.Color[1][index], particles.Color[2][index], particles.Color[3][index]);
+	instance.Size = particles.Size[index];
+	instance.Rotation = particles.Rotation[index];
+}
+
+void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera)
+{
+	if (livingParticleCount == 0)
+		return;
+
+	if (!CopyParticlesToGPU(context))
+		return;
+
+	vs->SetMatrix4x4("view", camera->viewMat);
+	vs->SetMatrix4x4("projection", camera->projMat);
+	if (analytic)
 	{
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
+		vs->SetFloat4("startColor", startColor);
+		vs->SetFloat4("endColor", endColor);
+		vs->SetFloat3("acceleration", emitterAcceleration);
+		vs->SetFloat("time", analyticClock);
+		vs->SetFloat("inverseLifetime", inverseLifetime);
+		vs->SetFloat("startSize", startSize);
+		vs->SetFloat("endSize", endSize);
 	}
-	else
-	{
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			CopyOneParticle(i);
+	vs->SetShader();
+	vs->CopyAllBufferData();
 
-		for (int i = 0; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
-	}
+	ps->SetShaderResourceView("particle", texture->View);
+	ps->SetShader();
+	ps->CopyAllBufferData();
 
-	D3D11_MAPPED_SUBRESOURCE mapped = {};
-	context->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	DrawParticles(context);
+}
 
-	memcpy(mapped.pData, localParticleVertices, sizeof(ParticleVertex) * 4 * maxParticles);
+const ParticleArrays & Emitter::GetParticles()
+{
+	return particles;
+}
 
-	context->Unmap(vertexBuffer, 0);
+int Emitter::GetParticleCapacity()
+{
+	return particleCapacity;
 }
 
-void Emitter::CopyOneParticle(int index)
+int Emitter::GetLivingCount()
 {
-	int i = index * 4;
-
-	localParticleVertices[i + 0].Position = particles[index].Position;
-	localParticleVertices[i + 1].Position = particles[index].Position;
-	localParticleVertices[i + 2].Position = particles[index].Position;
-	localParticleVertices[i + 3].Position = particles[index].Position;
-
-	localParticleVertices[i + 0].Size = particles[index].Size;
-	localParticleVertices[i + 1].Size = particles[index].Size;
-	localParticleVertices[i + 2].Size = particles[index].Size;
-	localParticleVertices[i + 3].Size = particles[index].Size;
-
-	localParticleVertices[i + 0].Color = particles[index].Color;
-	localParticleVertices[i + 1].Color = particles[index].Color;
-	localParticleVertices[i + 2].Color = particles[index].Color;
-	localParticleVertices[i + 3].Color = particles[index].Color;
-
-	localParticleVertices[i + 0].Rotation = particles[index].Rotation;
-	localParticleVertices[i + 1].Rotation = particles[index].Rotation;
-	localParticleVertices[i + 2].Rotation = particles[index].Rotation;
-	localParticleVertices[i + 3].Rotation = particles[index].Rotation;
+	return livingParticleCount;
 }
 
-void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera)
+const ParticleUploadStats & Emitter::GetUploadStats()
 {
-	CopyParticlesToGPU(context);
+	return uploadStats;
+}
 
-	UINT stride = sizeof(ParticleVertex);
-	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+int Emitter::GetParticleIndex(int living)
+{
+	return (firstAliveIndex + living) % maxParticles;
+}
 
-	vs->SetMatrix4x4("view", camera->viewMat);
-	vs->SetMatrix4x4("projection", camera->projMat);
-	vs->SetShader();
-	vs->CopyAllBufferData();
+const ParticleSpawn * Emitter::GetSpawns()
+{
+	return spawns;
+}
 
-	ps->SetShaderResourceView("particle", texture);
-	ps->SetShader();
-	ps->CopyAllBufferData();
+float Emitter::GetAge(const ParticleSpawn & spawn)
+{
+	float age = analyticClock - spawn.SpawnTime;
+	if (age < 0)
+		age += PARTICLE_TIME_WRAP;
+	return age;
+}
 
-	if (firstAliveIndex < firstDeadIndex)
-	{
-		context->DrawIndexed(livingParticleCount * 6, firstAliveIndex * 6, 0);
-	}
-	else
-	{
-		context->DrawIndexed(firstDeadIndex * 6, 0, 0);
+bool Emitter::EvaluateSpawn(const ParticleSpawn & spawn, ParticleInstance & instance)
+{
+	// Step for step the same as AnalyticParticleVS.hlsl
+	float age = GetAge(spawn);
+	float agePercent = age * inverseLifetime;
 
-		context->DrawIndexed((maxParticles - firstAliveIndex) * 6, firstAliveIndex * 6, 0);
-	}
+	// accel * t * t / 2 + startVel * t + startPos
+	instance.Position.x = emitterAcceleration.x * age * age * 0.5f + spawn.StartVelocity.x * age + spawn.StartPosition.x;
+	instance.Position.y = emitterAcceleration.y * age * age * 0.5f + spawn.StartVelocity.y * age + spawn.StartPosition.y;
+	instance.Position.z = emitterAcceleration.z * age * age * 0.5f + spawn.StartVelocity.z * age + spawn.StartPosition.z;
+
+	instance.Color.x = (endColor.x - startColor.x) * agePercent + startColor.x;
+	instance.Color.y = (endColor.y - startColor.y) * agePercent + startColor.y;
+	instance.Color.z = (endColor.z - startColor.z) * agePercent + startColor.z;
+	instance.Color.w = (endColor.w - startColor.w) * agePercent + startColor.w;
+
+	instance.Size = startSize + agePercent * (endSize - startSize);
+	instance.Rotation = spawn.StartRotation + age * spawn.RotationalVelocity;
+
+	return age < lifetime;
 }
@@ -5,28 +5,114 @@
 
 #include "Camera.h"
 #include "SimpleShader.h"
+#include "TextureHandle.h"
+#include "WorkerPool.h"
+#include <vector>
 
-struct Particle
+// Particles updated at once by the widest update, and what
+// the arrays are padded out to
+#define PARTICLE_BLOCK_SIZE		8
+
+// Most particles one job of a parallel update takes on
+#define PARTICLE_CHUNK_SIZE		4096
+
+// Fewer particles than this, over all emitters, aren't worth
+// waking the workers for
+#define PARTICLE_PARALLEL_MIN	16384
+
+class Emitter;
+
+// --------------------------------------------------------
+// Blocks of one emitter that one job updates, and how many
+// of their particles died
+// --------------------------------------------------------
+struct ParticleChunk
 {
-	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT4 Color;
-	DirectX::XMFLOAT3 StartPosition;
-	DirectX::XMFLOAT3 StartVelocity;
-	float Size;
-	float Rotation;
-	float RotationalVelocity;
-	float Age;
+	Emitter* Owner;
+	int FirstBlock;
+	int LastBlock;
+	int Died;
+};
+
+// --------------------------------------------------------
+// Every particle's fields, each in its own array, so the
+// update loads eight particles' worth of a field at once.
+// The arrays are 32 byte aligned and padded with dead
+// particles to a whole number of blocks.  Analytic emitters
+// keep their particles as spawns and have no arrays.
+// --------------------------------------------------------
+struct ParticleArrays
+{
+	float* Position[3];
+	float* Color[4];
+	float* StartPosition[3];
+	float* StartVelocity[3];
+	float* Size;
+	float* Rotation;
+	float* RotationalVelocity;
+	float* Age;
 };
 
-struct ParticleVertex
+// Full frames of particles the vertex ring holds
+#define PARTICLE_RING_FRAMES	2
+
+// --------------------------------------------------------
+// What an emitter has sent to the GPU: the ring uploads of
+// simulated emitters, or the new spawns of analytic ones
+// --------------------------------------------------------
+struct ParticleUploadStats
+{
+	int FrameBytes;				// The latest CopyParticlesToGPU's
+	unsigned long long TotalBytes;
+	int Discards;				// Uploads that started the ring over
+};
+
+// --------------------------------------------------------
+// One particle as the vertex shader sees it, drawn as an
+// instance of a shared quad.  Matches the _PER_INSTANCE
+// inputs of ParticleVS.
+// --------------------------------------------------------
+struct ParticleInstance
 {
 	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT2 UV;
 	DirectX::XMFLOAT4 Color;
 	float Size;
 	float Rotation;
 };
 
+// Seconds the analytic particle clock counts up to before it
+// starts over, so spawn times stay precise however long the
+// game runs.  Lifetimes have to be shorter.
+#define PARTICLE_TIME_WRAP		1024.0f
+
+// --------------------------------------------------------
+// What an analytic particle is spawned with.  The vertex
+// shader works the rest out from the time, so it's written
+// once and never touched again.  Matches the _PER_INSTANCE
+// inputs of AnalyticParticleVS.
+// --------------------------------------------------------
+struct ParticleSpawn
+{
+	DirectX::XMFLOAT3 StartPosition;
+	float SpawnTime;
+	DirectX::XMFLOAT3 StartVelocity;
+	float StartRotation;
+	float RotationalVelocity;
+};
+
+// --------------------------------------------------------
+// Spawns particles in bursts and draws them as billboards.
+//
+// Simulated emitters update every living particle on the CPU
+// and upload them all each frame.  Analytic emitters only
+// upload particles as they spawn, and AnalyticParticleVS
+// works out where each one is from the time, so the CPU's
+// work grows with the spawn rate rather than the particle
+// count.  They need the analytic vertex shader.
+//
+// Given a null device an emitter only keeps its particles,
+// which is enough to check the update without a GPU.
+// --------------------------------------------------------
 class Emitter
 {
 public:
@@ -51,23 +137,54 @@ public:
 		ID3D11Device* device,
 		SimpleVertexShader* vs,
 		SimplePixelShader* ps,
-		ID3D11ShaderResourceView* texture
+		TextureHandle* texture,
+		bool analytic = false
 	);
 	~Emitter();
 
 	void Update(float dt);
 
-	void UpdateSingleParticle(float dt, int index);
+	// Updates the particles of every emitter in chunks spread
+	// over the pool, then each emitter's ring and spawning in
+	// order on this thread.  Ends up exactly as calling Update
+	// on each in turn would.  No emitter may be listed twice.
+	static void UpdateAll(Emitter** emitters, int emitterNum, float dt, WorkerPool* pool);
+
 	void SpawnParticle();
 
 	void ResetParticle(int index);
 	void ResetEmitter();
 	void MoveEmitter(float x, float y, float z);
 
-	void CopyParticlesToGPU(ID3D11DeviceContext* context);
-	void CopyOneParticle(int index);
+	// The context calls are templated so tests can record them
+	// with a stand-in.  CopyParticlesToGPU returns false when
+	// nothing can be drawn this frame, and DrawParticles draws
+	// what it sent with whichever shaders are set.
+	template<class Context> bool CopyParticlesToGPU(Context* context);
+	template<class Context> void DrawParticles(Context* context);
+	void CopyOneParticle(int index, ParticleInstance& instance);
 	void Draw(ID3D11DeviceContext* context, Camera* camera);
 
+	const ParticleUploadStats& GetUploadStats();
+
+	// Every particle slot, padding and all, dead or alive
+	const ParticleArrays& GetParticles();
+	int GetParticleCapacity();
+	int GetLivingCount();
+
+	// Slot of the living particle that many spawns after the
+	// oldest, in the arrays or in the spawns
+	int GetParticleIndex(int living);
+
+	// Every analytic particle slot, as it was spawned
+	const ParticleSpawn* GetSpawns();
+
+	// The particle AnalyticParticleVS draws for a spawn at the
+	// current time, worked out with the same steps in the same
+	// order.  Change both together; AnalyticParticlesMatchSimulated
+	// holds this to the simulated emitter.  Returns false if it's dead.
+	bool EvaluateSpawn(const ParticleSpawn& spawn, ParticleInstance& instance);
+
 private:
 	// Emission stuff
 	int burstsPerSecond;
@@ -93,18 +210,175 @@ private:
 	float maxRotVel;
 
 	// Particle Array
-	Particle* particles;
+	ParticleArrays particles;
+	float* particleMemory;
 	int maxParticles;
+	int particleCapacity;		// maxParticles rounded up to a whole block
 	int firstDeadIndex;
 	int firstAliveIndex;
 
-	// Rendering
-	ParticleVertex* localParticleVertices;
-	ID3D11Buffer* vertexBuffer;
+	// Updates the blocks from firstBlock up to lastBlock, one
+	// Lanes::Width particles at a time.  Returns how many
+	// particles died.
+	template<class Lanes>
+	int UpdateBlocks(float dt, int firstBlock, int lastBlock);
+
+	void AddChunks(std::vector<ParticleChunk>& chunks);
+	void AddChunks(std::vector<ParticleChunk>& chunks, int firstBlock, int lastBlock);
+	void FinishUpdate(float dt, int died);
+	int UpdateBlocks(float dt, int firstBlock, int lastBlock);
+
+	// Analytic particles sit at the same index in spawns and
+	// spawnBuffer as in the ring.  Only spawns go to the GPU.
+	bool analytic;
+	double analyticTime;		// Wraps at PARTICLE_TIME_WRAP
+	float analyticClock;		// analyticTime as the shader gets it
+	float inverseLifetime;
+	ParticleSpawn* spawns;
+	ID3D11Buffer* spawnBuffer;
+	int unsentSpawns;			// Ending at firstDeadIndex
+
+	float GetAge(const ParticleSpawn& spawn);
+	template<class Context> void SendSpawns(Context* context);
+	template<class Context> void DrawInstances(Context* context, ID3D11Buffer* buffer, UINT stride, int first, int count);
+
+	// Rendering.  Each frame's living particles are appended to
+	// the instance ring, oldest first, and drawn from there as
+	// instances of the corner quad.  Analytic emitters draw
+	// spawnBuffer instead.
+	ID3D11Buffer* instanceBuffer;
+	ID3D11Buffer* cornerBuffer;
 	ID3D11Buffer* indexBuffer;
+	int ringInstanceCount;
+	int ringOffset;				// Where the next upload goes, in instances
+	int drawOffset;				// Where the latest one went
+	ParticleUploadStats uploadStats;
 
-	ID3D11ShaderResourceView* texture;
+	TextureHandle* texture;
 	SimpleVertexShader* vs;
 	SimplePixelShader* ps;
 };
 
+// --------------------------------------------------------
+// Packs the living particles together, oldest first, straight
+// into the ring.  The GPU may still be drawing earlier
+// frames' particles, so the ring is only discarded when they
+// don't fit in what's left of it.  Nothing moves unless the
+// map works, so a failed one leaves the ring as it was.
+// --------------------------------------------------------
+template<class Context>
+bool Emitter::CopyParticlesToGPU(Context* context)
+{
+	uploadStats.FrameBytes = 0;
+
+	if (analytic)
+	{
+		SendSpawns(context);
+		return true;
+	}
+
+	if (livingParticleCount == 0)
+		return false;
+
+	int offset = ringOffset;
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (offset + livingParticleCount > ringInstanceCount)
+	{
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		offset = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(instanceBuffer, 0, mapType, 0, &mapped)))
+		return false;
+
+	// Mapped memory is write-combined, so it's only ever written,
+	// front to back, and never read
+	ParticleInstance* instances = (ParticleInstance*)mapped.pData + offset;
+	int slot = 0;
+	for (int i = firstAliveIndex; i < maxParticles && slot < livingParticleCount; i++)
+		CopyOneParticle(i, instances[slot++]);
+	for (int i = 0; slot < livingParticleCount; i++)
+		CopyOneParticle(i, instances[slot++]);
+
+	context->Unmap(instanceBuffer, 0);
+
+	drawOffset = offset;
+	ringOffset = offset + livingParticleCount;
+
+	uploadStats.FrameBytes = sizeof(ParticleInstance) * livingParticleCount;
+	uploadStats.TotalBytes += uploadStats.FrameBytes;
+	if (mapType == D3D11_MAP_WRITE_DISCARD)
+		uploadStats.Discards++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the particles spawned since the last upload, which
+// end at firstDeadIndex and may wrap around.  Nothing else
+// in the buffer changes.
+// --------------------------------------------------------
+template<class Context>
+void Emitter::SendSpawns(Context* context)
+{
+	if (unsentSpawns == 0)
+		return;
+
+	int first = (firstDeadIndex - unsentSpawns + maxParticles) % maxParticles;
+	int firstRun = min(unsentSpawns, maxParticles - first);
+
+	// Buffers are addressed in bytes along x
+	D3D11_BOX box = {};
+	box.left = sizeof(ParticleSpawn) * first;
+	box.right = sizeof(ParticleSpawn) * (first + firstRun);
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(spawnBuffer, 0, &box, spawns + first, 0, 0);
+
+	if (firstRun < unsentSpawns)
+	{
+		box.left = 0;
+		box.right = sizeof(ParticleSpawn) * (unsentSpawns - firstRun);
+		context->UpdateSubresource(spawnBuffer, 0, &box, spawns, 0, 0);
+	}
+
+	uploadStats.FrameBytes = sizeof(ParticleSpawn) * unsentSpawns;
+	uploadStats.TotalBytes += uploadStats.FrameBytes;
+	unsentSpawns = 0;
+}
+
+template<class Context>
+void Emitter::DrawParticles(Context* context)
+{
+	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+
+	if (analytic)
+	{
+		// Living particles are where they spawned, so a wrapped
+		// ring is drawn in two parts
+		int firstRun = min(livingParticleCount, maxParticles - firstAliveIndex);
+		DrawInstances(context, spawnBuffer, sizeof(ParticleSpawn), firstAliveIndex, firstRun);
+		if (firstRun < livingParticleCount)
+			DrawInstances(context, spawnBuffer, sizeof(ParticleSpawn), 0, livingParticleCount - firstRun);
+	}
+	else
+	{
+		DrawInstances(context, instanceBuffer, sizeof(ParticleInstance), drawOffset, livingParticleCount);
+	}
+}
+
+// --------------------------------------------------------
+// Instances are found by offsetting the binding rather than
+// with a start instance, which 9_3 level hardware may not
+// have
+// --------------------------------------------------------
+template<class Context>
+void Emitter::DrawInstances(Context* context, ID3D11Buffer* buffer, UINT stride, int first, int count)
+{
+	ID3D11Buffer* buffers[2] = { cornerBuffer, buffer };
+	UINT strides[2] = { sizeof(DirectX::XMFLOAT2), stride };
+	UINT offsets[2] = { 0, stride * first };
+	context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+
+	context->DrawIndexedInstanced(6, count, 0, 0, 0);
+}
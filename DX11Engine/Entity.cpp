@@ -5,7 +5,14 @@ Entity::Entity(Mesh * iMesh, Material* iMaterial, XMFLOAT4X4 iWorld, XMFLOAT3 iP
 	GameObject(iWorld, iPos, iRot, iScale)
 {
 	mesh = iMesh;
-	material = iMaterial;
+	materials.assign(1, iMaterial);
+}
+
+Entity::Entity(Mesh * iMesh, Material ** iMaterials, int materialNum, XMFLOAT4X4 iWorld, XMFLOAT3 iPos, XMFLOAT3 iRot, XMFLOAT3 iScale) :
+	GameObject(iWorld, iPos, iRot, iScale)
+{
+	mesh = iMesh;
+	materials.assign(iMaterials, iMaterials + materialNum);
 }
 
 Entity::~Entity()
@@ -13,28 +20,176 @@ Entity::~Entity()
 
 }
 
-void Entity::Draw(ID3D11DeviceContext* context, XMFLOAT4X4 proj, XMFLOAT4X4 view)
+Material * Entity::GetMaterial(UINT slot)
 {
-	GameObject::Draw(context, proj, view);
+	return materials[min(slot, (UINT)materials.size() - 1)];
+}
 
-	material->PrepareMaterial(proj, view, worldMatrix);
+void Entity::Draw(ID3D11DeviceContext* context, Camera* camera, ClusterCullStats* stats)
+{
+	GameObject::Draw(context, camera->projMat, camera->viewMat);
 
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
+	// Farther away, a coarser LOD looks the same
+	int lodIndex = mesh->SelectLOD(camera, worldMatrix);
 
-	ID3D11Buffer* vb = mesh->GetVertexBuffer();
+	// Coarser LODs are cheap enough to draw whole, up close
+	// the clusters that are off screen or facing away get skipped
+	bool cullClusters = lodIndex == 0 && mesh->GetClusterCount() > 1;
+	const MeshCluster* clusters = 0;
+	if (cullClusters)
+	{
+		clusters = mesh->GetClusters();
+		visibleClusters.resize(mesh->GetClusterCount());
+	}
 
 	// Draw Mesh
-	context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-	context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-
-	// Finally do the actual drawing
-	//  - Do this ONCE PER OBJECT you intend to draw
-	//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
-	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-	//     vertices in the currently set VERTEX BUFFER
-	context->DrawIndexed(
-		mesh->numIndices,     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
+	//  - Every submesh shares the same buffers, so they're bound
+	//     once and each submesh is just another range of indices
+	mesh->BindVertexStreams(context);
+	mesh->BindIndexBuffer(context);
+
+	Material* preparedMaterial = 0;
+	for (int i = 0; i < mesh->GetSubmeshCount(); i++)
+	{
+		const MeshSubmesh& submesh = mesh->GetSubmesh(i);
+		if (submesh.IndexCount[lodIndex] == 0)
+			continue;
+
+		int visibleNum = 0;
+		if (cullClusters)
+		{
+			visibleNum = MeshClusterizer::CullClusters(clusters + submesh.FirstCluster, submesh.ClusterCount, worldMatrix, camera, &visibleClusters[0], stats);
+			if (visibleNum == 0)
+				continue;
+		}
+
+		// Neighbouring submeshes often share a material
+		Material* material = GetMaterial(submesh.MaterialSlot);
+		if (material != preparedMaterial)
+		{
+			material->PrepareMaterial(camera->projMat, camera->viewMat, worldMatrix, mesh);
+			preparedMaterial = material;
+		}
+
+		if (!cullClusters)
+		{
+			// Finally do the actual drawing
+			//  - Do this ONCE PER SUBMESH you intend to draw
+			//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
+			//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
+			//     vertices in the currently set VERTEX BUFFER
+			context->DrawIndexed(
+				submesh.IndexCount[lodIndex],     // The number of indices to use (we could draw a subset if we wanted)
+				mesh->GetStartIndex() + submesh.StartIndex[lodIndex],     // Offset to the first index we want to use
+				mesh->GetBaseVertex());    // Offset to add to each index when looking up vertices
+			continue;
+		}
+
+		// Neighbouring clusters are neighbouring index ranges, so
+		// each run of visible ones is a single draw
+		const MeshCluster* submeshClusters = clusters + submesh.FirstCluster;
+		for (int c = 0; c < visibleNum; )
+		{
+			UINT start = submeshClusters[visibleClusters[c]].StartIndex;
+			UINT count = submeshClusters[visibleClusters[c]].IndexCount;
+
+			int j = c + 1;
+			while (j < visibleNum && visibleClusters[j] == visibleClusters[j - 1] + 1)
+			{
+				count += submeshClusters[visibleClusters[j]].IndexCount;
+				j++;
+			}
+
+			context->DrawIndexed(count, mesh->GetStartIndex() + start, mesh->GetBaseVertex());
+			c = j;
+		}
+	}
+}
+
+void Entity::GetWorldBounds(BoundingBox & box, BoundingSphere & sphere)
+{
+	mesh->GetWorldBounds(worldMatrix, box, sphere);
+}
+
+bool Entity::Raycast(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit & hit)
+{
+	XMFLOAT3 modelOrigin;
+	XMFLOAT3 modelDirection;
+	if (!ToModelSpace(origin, direction, modelOrigin, modelDirection))
+		return false;
+
+	return mesh->GetBVH()->Intersect(modelOrigin, modelDirection, maxDistance, hit);
+}
+
+bool Entity::IsOccluding(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance)
+{
+	XMFLOAT3 modelOrigin;
+	XMFLOAT3 modelDirection;
+	if (!ToModelSpace(origin, direction, modelOrigin, modelDirection))
+		return false;
+
+	return mesh->GetBVH()->IsOccluded(modelOrigin, modelDirection, maxDistance);
+}
+
+Entity* Entity::Pick(Entity* const* entities, int entityNum, XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit & hit)
+{
+	Entity* closest = 0;
+	for (int i = 0; i < entityNum; i++)
+	{
+		// Every hit after the first has to be nearer
+		BVHHit entityHit;
+		if (entities[i]->Raycast(origin, direction, maxDistance, entityHit))
+		{
+			closest = entities[i];
+			hit = entityHit;
+			maxDistance = entityHit.Distance;
+		}
+	}
+
+	return closest;
+}
+
+bool Entity::HasLineOfSight(Entity* const* entities, int entityNum, XMFLOAT3 from, XMFLOAT3 to)
+{
+	XMVECTOR ray = XMLoadFloat3(&to) - XMLoadFloat3(&from);
+	float distance = XMVectorGetX(XMVector3Length(ray));
+	if (distance == 0.0f)
+		return true;
+
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, ray / distance);
+
+	// Stop just short of to, so whatever it sits on doesn't count
+	distance *= 0.999f;
+	for (int i = 0; i < entityNum; i++)
+	{
+		if (entities[i]->IsOccluding(from, direction, distance))
+			return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Moves the ray into the mesh's model space, or returns
+// false when it misses the mesh's bounds entirely.  The
+// direction isn't renormalized, so a distance along it is
+// the same distance along the world space ray.
+// --------------------------------------------------------
+bool Entity::ToModelSpace(XMFLOAT3 origin, XMFLOAT3 direction, XMFLOAT3 & modelOrigin, XMFLOAT3 & modelDirection)
+{
+	if (mesh->GetBVH()->IsEmpty())
+		return false;
+
+	BoundingBox box;
+	BoundingSphere sphere;
+	float distance;
+	GetWorldBounds(box, sphere);
+	if (!sphere.Intersects(XMLoadFloat3(&origin), XMLoadFloat3(&direction), distance))
+		return false;
+
+	XMMATRIX inverseWorld = XMMatrixInverse(nullptr, XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix)));
+	XMStoreFloat3(&modelOrigin, XMVector3TransformCoord(XMLoadFloat3(&origin), inverseWorld));
+	XMStoreFloat3(&modelDirection, XMVector3TransformNormal(XMLoadFloat3(&direction), inverseWorld));
+	return true;
 }
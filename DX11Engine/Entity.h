@@ -3,6 +3,7 @@
 #include "GameObject.h"
 #include "Vertex.h"
 #include "Mesh.h"
+#include "Camera.h"
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -10,12 +11,38 @@ using namespace DirectX;
 class Entity : public GameObject
 {
 public:
-	Material* material;
+	std::vector<Material*> materials;	// One per material slot of the mesh
 	Mesh* mesh;
 
+	// One material for every submesh
 	Entity(Mesh* iMesh, Material* iMaterial, XMFLOAT4X4 iWorld, XMFLOAT3 iPos, XMFLOAT3 iRot, XMFLOAT3 iScale);
+	// iMaterials[slot] for each submesh, the last one for slots past the end
+	Entity(Mesh* iMesh, Material** iMaterials, int materialNum, XMFLOAT4X4 iWorld, XMFLOAT3 iPos, XMFLOAT3 iRot, XMFLOAT3 iScale);
 	~Entity();
 
-	void Draw(ID3D11DeviceContext* context, XMFLOAT4X4 proj, XMFLOAT4X4 view);
+	Material* GetMaterial(UINT slot);
+
+	// Adds what cluster culling rejected to stats, when given
+	void Draw(ID3D11DeviceContext* context, Camera* camera, ClusterCullStats* stats = 0);
+
+	// The mesh's bounds at the entity's current world matrix
+	void GetWorldBounds(BoundingBox& box, BoundingSphere& sphere);
+
+	// World space ray casts against the mesh at the entity's
+	// current world matrix.  direction must be normalized, and
+	// hit.Distance is along it in world units.
+	bool Raycast(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit& hit);
+	bool IsOccluding(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance);
+
+	// The same against every entity in a scene.  Pick returns
+	// the nearest one hit, or 0, and HasLineOfSight ignores
+	// whatever to sits on.
+	static Entity* Pick(Entity* const* entities, int entityNum, XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit& hit);
+	static bool HasLineOfSight(Entity* const* entities, int entityNum, XMFLOAT3 from, XMFLOAT3 to);
+
+private:
+	std::vector<UINT> visibleClusters;
+
+	bool ToModelSpace(XMFLOAT3 origin, XMFLOAT3 direction, XMFLOAT3& modelOrigin, XMFLOAT3& modelDirection);
 };
 
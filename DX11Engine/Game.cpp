@@ -18,7 +18,8 @@ Game::Game(HINSTANCE hInstance)
 		true)			   // Show extra stats (fps) in title bar?
 {
 	// Initialize fields
-	vertexShader = 0;
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+		vertexShaders[i] = 0;
 	pixelShader = 0;
 
 #if defined(DEBUG) || defined(_DEBUG)
@@ -38,7 +39,8 @@ Game::~Game()
 {
 	// Delete our simple shader objects, which
 	// will clean up their own internal DirectX stuff
-	delete vertexShader;
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+		delete vertexShaders[i];
 	delete pixelShader;
 	delete lightShader;
 
@@ -48,10 +50,16 @@ Game::~Game()
 	delete helix;
 	delete sphere;
 	delete torus;
+	delete lightVolume;
+	delete skyCube;
+	delete geometryPool;
 
 	delete particleVS;
+	delete analyticParticleVS;
 	delete particlePS;
 	delete emitter;
+	delete analyticEmitter;
+	delete particlePool;
 
 	delete skyboxPS;
 	delete skyboxVS;
@@ -70,24 +78,13 @@ Game::~Game()
 	delete floorMat;
 	delete scratchedMat;
 
-	stoneTexture->Release();
-	stoneNormal->Release();
-	stoneRoughness->Release();
-	stoneMetal->Release();
-	floorTexture->Release();
-	floorNormal->Release();
-	floorRoughness->Release();
-	floorMetal->Release();
-	scratchedTexture->Release();
-	scratchedNormal->Release();
-	scratchedRoughness->Release();
-	scratchedMetal->Release();
+	// Owns the textures
+	delete assetLoader;
+
 	sampleState->Release();
-	particleTexture->Release();
 	particleBlendState->Release();
 	particleDepthState->Release();
 	noBlendState->Release();
-	skybox->Release();
 	skyboxRasterState->Release();
 	skyboxDepthState->Release();
 	lightDepthState->Release();
@@ -116,25 +113,37 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// Meshes and textures load on other threads, and stand-ins
+	// are drawn until they're done (see AssetLoader::Update)
+	assetLoader = new AssetLoader(device, context);
+
 	LoadShaders();
 	CreateMatrices();
 	CreateBasicGeometry();
 
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/rough_albedo.png", 0, &stoneTexture);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/rough_normals.png", 0, &stoneNormal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/rough_roughness.png", 0, &stoneRoughness);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/rough_metal.png", 0, &stoneMetal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/floor_albedo.png", 0, &floorTexture);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/floor_normals.png", 0, &floorNormal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/floor_roughness.png", 0, &floorRoughness);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/floor_metal.png", 0, &floorMetal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/scratched_albedo.png", 0, &scratchedTexture);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/scratched_normals.png", 0, &scratchedNormal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/scratched_roughness.png", 0, &scratchedRoughness);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/scratched_metal.png", 0, &scratchedMetal);
-	CreateWICTextureFromFile(device, context, L"Assets/Textures/particle.jpg", 0, &particleTexture);
-
-	CreateDDSTextureFromFile(device, L"Assets/Textures/skybox.dds", 0, &skybox);
+	// Placeholders: grey albedo, flat normals, half rough, not metal
+	XMFLOAT4 albedo = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	XMFLOAT4 flat = XMFLOAT4(0.5f, 0.5f, 1.0f, 1.0f);
+	XMFLOAT4 rough = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	XMFLOAT4 metal = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+	stoneTexture = assetLoader->LoadTexture(L"Assets/Textures/rough_albedo.png", albedo);
+	stoneNormal = assetLoader->LoadTexture(L"Assets/Textures/rough_normals.png", flat);
+	stoneRoughness = assetLoader->LoadTexture(L"Assets/Textures/rough_roughness.png", rough);
+	stoneMetal = assetLoader->LoadTexture(L"Assets/Textures/rough_metal.png", metal);
+	floorTexture = assetLoader->LoadTexture(L"Assets/Textures/floor_albedo.png", albedo);
+	floorNormal = assetLoader->LoadTexture(L"Assets/Textures/floor_normals.png", flat);
+	floorRoughness = assetLoader->LoadTexture(L"Assets/Textures/floor_roughness.png", rough);
+	floorMetal = assetLoader->LoadTexture(L"Assets/Textures/floor_metal.png", metal);
+	scratchedTexture = assetLoader->LoadTexture(L"Assets/Textures/scratched_albedo.png", albedo);
+	scratchedNormal = assetLoader->LoadTexture(L"Assets/Textures/scratched_normals.png", flat);
+	scratchedRoughness = assetLoader->LoadTexture(L"Assets/Textures/scratched_roughness.png", rough);
+	scratchedMetal = assetLoader->LoadTexture(L"Assets/Textures/scratched_metal.png", metal);
+
+	// Black adds nothing with the particles' additive blending
+	particleTexture = assetLoader->LoadTexture(L"Assets/Textures/particle.jpg", XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+
+	skybox = assetLoader->LoadCubemap(L"Assets/Textures/skybox.dds", XMFLOAT4(0.4f, 0.5f, 0.6f, 1.0f));
 
 	sampleDesc = { };
 	sampleDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -145,9 +154,9 @@ void Game::Init()
 
 	device->CreateSamplerState(&sampleDesc, &sampleState);
 
-	stoneMat = new Material(vertexShader, pixelShader, XMFLOAT2(2, 2), stoneTexture, stoneNormal, stoneRoughness, stoneMetal, skybox, sampleState);
-	floorMat = new Material(vertexShader, pixelShader, XMFLOAT2(2, 2), floorTexture, floorNormal, floorRoughness, floorMetal, skybox, sampleState);
-	scratchedMat = new Material(vertexShader, pixelShader, XMFLOAT2(2, 2), scratchedTexture, scratchedNormal, scratchedRoughness, scratchedMetal, skybox, sampleState);
+	stoneMat = new Material(vertexShaders, pixelShader, XMFLOAT2(2, 2), stoneTexture, stoneNormal, stoneRoughness, stoneMetal, skybox, sampleState);
+	floorMat = new Material(vertexShaders, pixelShader, XMFLOAT2(2, 2), floorTexture, floorNormal, floorRoughness, floorMetal, skybox, sampleState);
+	scratchedMat = new Material(vertexShaders, pixelShader, XMFLOAT2(2, 2), scratchedTexture, scratchedNormal, scratchedRoughness, scratchedMetal, skybox, sampleState);
 
 	CreateEntities();
 
@@ -183,6 +192,7 @@ void Game::Init()
 	device->CreateBlendState(&blendState, &noBlendState);
 
 	// Set up particles
+	particlePool = new WorkerPool();
 	emitter = new Emitter(
 		1000,							// Max particles
 		20,								// Bursts per second
@@ -206,6 +216,31 @@ void Game::Init()
 		particlePS,
 		particleTexture);
 
+	// The same again on the other side, worked out on the GPU
+	analyticEmitter = new Emitter(
+		1000,							// Max particles
+		20,								// Bursts per second
+		5,							// Particles per burst
+		0,								// Emitter lifetime
+		2,								// Particle lifetime
+		2,								// Start size
+		0.2f,							// End size
+		-3.141593f,						// Minimum Rotation
+		3.141593f,						// Maximum Rotation
+		-3.141593f,						// Minimum Rotational Velocity
+		3.141593f,						// Maximum Rotational Velocity
+		XMFLOAT4(1, 0.1f, 0.1f, 1),		// Start color
+		XMFLOAT4(1, 0.6f, 0.1f, 0.00f),		// End color
+		XMFLOAT3(2, 10, 2),				// Max Start velocity
+		XMFLOAT3(-2, 5, -2),			// Min Start velocity
+		XMFLOAT3(-3, 0, 0),				// Start position
+		XMFLOAT3(0, -9, 0),				// Start acceleration
+		device,
+		analyticParticleVS,
+		particlePS,
+		particleTexture,
+		true);
+
 	// Some states for the sky drawing ----------------------
 
 	// Rasterize state for drawing the "inside"
@@ -262,8 +297,25 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
-	vertexShader = new SimpleVertexShader(device, context);
-	vertexShader->LoadShaderFile(L"VertexShader.cso");
+	// One G-buffer vertex shader per mesh vertex format.  Reflection
+	// can't produce the packed or split layouts, so every one of them
+	// gets its layout built from VertexPacking instead.
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+	{
+		MeshVertexFormat format = (MeshVertexFormat)i;
+		const wchar_t* file = (format & VERTEX_FORMAT_PACKED) ? L"PackedVertexShader.cso" : L"VertexShader.cso";
+
+		ID3DBlob* blob = 0;
+		ID3D11InputLayout* layout = 0;
+		if (D3DReadFileToBlob(file, &blob) == S_OK)
+		{
+			VertexPacking::CreateInputLayout(device, format, blob->GetBufferPointer(), blob->GetBufferSize(), &layout);
+			blob->Release();
+		}
+
+		vertexShaders[i] = new SimpleVertexShader(device, context, layout, false);
+		vertexShaders[i]->LoadShaderFile(file);
+	}
 
 	pixelShader = new SimplePixelShader(device, context);
 	pixelShader->LoadShaderFile(L"DeferredPS.cso");
@@ -274,6 +326,9 @@ void Game::LoadShaders()
 	particleVS = new SimpleVertexShader(device, context);
 	particleVS->LoadShaderFile(L"ParticleVS.cso");
 
+	analyticParticleVS = new SimpleVertexShader(device, context);
+	analyticParticleVS->LoadShaderFile(L"AnalyticParticleVS.cso");
+
 	particlePS = new SimplePixelShader(device, context);
 	particlePS->LoadShaderFile(L"ParticlePS.cso");
 
@@ -358,17 +413,26 @@ void Game::CreateBasicGeometry()
 	XMFLOAT4 green = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 	XMFLOAT4 blue = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 
-	cone = new Mesh("cone.obj", device);
+	// Every static mesh shares the pool's buffers
+	geometryPool = new GeometryPool(device, context);
+
+	cone = assetLoader->LoadMesh("cone.obj", VERTEX_FORMAT_PACKED, geometryPool);
 
-	cube = new Mesh("cube.obj", device);
+	cube = assetLoader->LoadMesh("cube.obj", VERTEX_FORMAT_PACKED, geometryPool);
 
-	cylinder = new Mesh("cylinder.obj", device);
+	cylinder = assetLoader->LoadMesh("cylinder.obj", VERTEX_FORMAT_PACKED, geometryPool);
 
-	helix = new Mesh("helix.obj", device);
+	helix = assetLoader->LoadMesh("helix.obj", VERTEX_FORMAT_PACKED, geometryPool);
 
-	sphere = new Mesh("sphere.obj", device);
+	sphere = assetLoader->LoadMesh("sphere.obj", VERTEX_FORMAT_PACKED, geometryPool);
 
-	torus = new Mesh("torus.obj", device);
+	torus = assetLoader->LoadMesh("torus.obj", VERTEX_FORMAT_PACKED, geometryPool);
+
+	// Light volumes and the skybox only read positions.  The volume
+	// reaches the edge of a unit diameter sphere everywhere, so a
+	// point light scaled to twice its range lights all of it.
+	lightVolume = ProxyMesh::CreateIcosphere(device, 0.5f);
+	skyCube = ProxyMesh::CreateCube(device, 0.5f);
 }
 
 void Game::CreateEntities()
@@ -385,10 +449,10 @@ void Game::CreateEntities()
 
 void Game::CreateLights()
 {
-	PointLight* temp1 = new PointLight(worldMatrix, sphere, skybox, pointLightVS, pointLightPS, sampleState, XMFLOAT4(+0.1f, +0.1f, +0.1f, +1.0f), XMFLOAT4(+0.4f, +0.4f, +1.0f, +1.0f), XMFLOAT3(-1.0f, 0.0f, -1.0f), XMFLOAT3(0, 0, 0), 10.0f);
+	PointLight* temp1 = new PointLight(worldMatrix, lightVolume, skybox, pointLightVS, pointLightPS, sampleState, XMFLOAT4(+0.1f, +0.1f, +0.1f, +1.0f), XMFLOAT4(+0.4f, +0.4f, +1.0f, +1.0f), XMFLOAT3(-1.0f, 0.0f, -1.0f), XMFLOAT3(0, 0, 0), 10.0f);
 	pLights.push_back(temp1);
 
-	PointLight* temp2 = new PointLight(worldMatrix, sphere, skybox, pointLightVS, pointLightPS, sampleState, XMFLOAT4(+0.1f, +0.1f, +0.1f, +1.0f), XMFLOAT4(+1.0f, +0.2f, +0.2f, +1.0f), XMFLOAT3(0.0f, 0.0f, 5.0f), XMFLOAT3(0, 0, 0), 7.0f);
+	PointLight* temp2 = new PointLight(worldMatrix, lightVolume, skybox, pointLightVS, pointLightPS, sampleState, XMFLOAT4(+0.1f, +0.1f, +0.1f, +1.0f), XMFLOAT4(+1.0f, +0.2f, +0.2f, +1.0f), XMFLOAT3(0.0f, 0.0f, 5.0f), XMFLOAT3(0, 0, 0), 7.0f);
 	pLights.push_back(temp2);
 
 	DirectionalLight* temp3 = new DirectionalLight(worldMatrix, skybox, dirLightVS, dirLightPS, sampleState, XMFLOAT4(+0.1f, +0.1f, +0.1f, +1.0f), XMFLOAT4(+0.5f, +0.8f, +0.9f, +1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0, -1.0, 1.0));
@@ -425,12 +489,16 @@ void Game::Update(float deltaTime, float totalTime)
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
+	// Swap in whatever has finished loading
+	assetLoader->Update();
+
 	entities[1]->rotation.y = totalTime / 2;
 	entities[2]->rotation.y = totalTime / 2;
 
 	pLights[1]->SetPosition(sinf(totalTime) * 5.0f, 1.0f, cosf(totalTime) * 5.0f);
 
-	emitter->Update(deltaTime);
+	Emitter* emitters[2] = { emitter, analyticEmitter };
+	Emitter::UpdateAll(emitters, 2, deltaTime, particlePool);
 
 	camera->Update(deltaTime);
 }
@@ -468,9 +536,12 @@ void Game::Draw(float deltaTime, float totalTime)
 		1.0f,
 		0);
 
+	// Particles, light volumes and the sky bound their own buffers last frame
+	geometryPool->ResetBindings();
+
 	for (int i = 0; i < entities.size(); i++)
 	{
-		entities[i]->Draw(context, camera->projMat, camera->viewMat);
+		entities[i]->Draw(context, camera);
 	}
 	ClearStates();
 
@@ -499,25 +570,20 @@ void Game::RenderParticles()
 	context->OMSetDepthStencilState(particleDepthState, 0);			// No depth WRITING
 
 	emitter->Draw(context, camera);
+	analyticEmitter->Draw(context, camera);
 }
 
 void Game::RenderSkybox()
 {
-	ID3D11Buffer* skyboxVB = sphere->GetVertexBuffer();
-	ID3D11Buffer* skyboxIB = sphere->GetIndexBuffer();
-
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
-	context->IASetVertexBuffers(0, 1, &skyboxVB, &stride, &offset);
-	context->IASetIndexBuffer(skyboxIB, DXGI_FORMAT_R32_UINT, 0);
+	// Each corner is also the direction to sample the cube map in
+	skyCube->Bind(context);
 
 	skyboxVS->SetMatrix4x4("view", camera->viewMat);
 	skyboxVS->SetMatrix4x4("projection", camera->projMat);
 	skyboxVS->CopyAllBufferData();
 	skyboxVS->SetShader();
 
-	skyboxPS->SetShaderResourceView("SkyTexture", skybox);
+	skyboxPS->SetShaderResourceView("SkyTexture", skybox->View);
 	skyboxPS->SetSamplerState("BasicSampler", sampleState);
 	skyboxPS->CopyAllBufferData();
 	skyboxPS->SetShader();
@@ -525,7 +591,7 @@ void Game::RenderSkybox()
 	context->RSSetState(skyboxRasterState);
 	context->OMSetDepthStencilState(skyboxDepthState, 0);
 
-	context->DrawIndexed(sphere->GetIndexCount(), 0, 0);
+	context->DrawIndexed(skyCube->GetIndexCount(), 0, 0);
 }
 
 void Game::RenderLights()
@@ -574,7 +640,8 @@ void Game::Combine()
 	combinePS->CopyAllBufferData();
 	combinePS->SetShader();
 
-	context->DrawIndexed(3, 0, 0);
+	// Fullscreen triangle made from SV_VertexID, no buffers needed
+	context->Draw(3, 0);
 }
 
 void Game::ClearStates()
@@ -589,6 +656,20 @@ void Game::ClearStates()
 }
 
 
+// --------------------------------------------------------
+// Closest entity along the ray, with where it was hit
+// --------------------------------------------------------
+Entity* Game::Pick(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit & hit)
+{
+	return Entity::Pick(entities.data(), (int)entities.size(), origin, direction, maxDistance, hit);
+}
+
+bool Game::HasLineOfSight(XMFLOAT3 from, XMFLOAT3 to)
+{
+	return Entity::HasLineOfSight(entities.data(), (int)entities.size(), from, to);
+}
+
+
 #pragma region Mouse Input
 
 // --------------------------------------------------------
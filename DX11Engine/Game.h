@@ -1,15 +1,15 @@
 #pragma once
 
 #include "DXCore.h"
-#include "DDSTextureLoader.h"
 #include "Mesh.h"
+#include "ProxyMesh.h"
 #include "Entity.h"
 #include "Emitter.h"
 #include "SimpleShader.h"
 #include "Camera.h"
 #include "PointLight.h"
 #include "DirectionalLight.h"
-#include "WICTextureLoader.h"
+#include "AssetLoader.h"
 #include <DirectXMath.h>
 
 class Game 
@@ -37,27 +37,34 @@ public:
 	void OnMouseUp	 (WPARAM buttonState, int x, int y);
 	void OnMouseMove (WPARAM buttonState, int x, int y);
 	void OnMouseWheel(float wheelDelta,   int x, int y);
+
+	// Ray casts against every entity, directions normalized
+	Entity* Pick(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit& hit);
+	bool HasLineOfSight(XMFLOAT3 from, XMFLOAT3 to);
 private:
 
 	// Camera
 	Camera* camera;
 
+	// Loads the meshes and textures below in the background
+	AssetLoader* assetLoader;
+
 	// Texture
-	ID3D11ShaderResourceView* stoneTexture;
-	ID3D11ShaderResourceView* stoneNormal;
-	ID3D11ShaderResourceView* stoneRoughness;
-	ID3D11ShaderResourceView* stoneMetal;
-	ID3D11ShaderResourceView* floorTexture;
-	ID3D11ShaderResourceView* floorNormal;
-	ID3D11ShaderResourceView* floorRoughness;
-	ID3D11ShaderResourceView* floorMetal;
-	ID3D11ShaderResourceView* scratchedTexture;
-	ID3D11ShaderResourceView* scratchedNormal;
-	ID3D11ShaderResourceView* scratchedRoughness;
-	ID3D11ShaderResourceView* scratchedMetal;
+	TextureHandle* stoneTexture;
+	TextureHandle* stoneNormal;
+	TextureHandle* stoneRoughness;
+	TextureHandle* stoneMetal;
+	TextureHandle* floorTexture;
+	TextureHandle* floorNormal;
+	TextureHandle* floorRoughness;
+	TextureHandle* floorMetal;
+	TextureHandle* scratchedTexture;
+	TextureHandle* scratchedNormal;
+	TextureHandle* scratchedRoughness;
+	TextureHandle* scratchedMetal;
 
 	// Skybox
-	ID3D11ShaderResourceView* skybox;
+	TextureHandle* skybox;
 	SimpleVertexShader* skyboxVS;
 	SimplePixelShader* skyboxPS;
 
@@ -65,13 +72,16 @@ private:
 	ID3D11DepthStencilState* skyboxDepthState;
 
 	// Particle stuff
-	ID3D11ShaderResourceView* particleTexture;
+	TextureHandle* particleTexture;
 	SimpleVertexShader* particleVS;
+	SimpleVertexShader* analyticParticleVS;
 	SimplePixelShader* particlePS;
 	ID3D11DepthStencilState* particleDepthState;
 	ID3D11BlendState* particleBlendState;
 	ID3D11BlendState* noBlendState;
 	Emitter* emitter;
+	Emitter* analyticEmitter;
+	WorkerPool* particlePool;
 
 	// Sampler State
 	ID3D11SamplerState* sampleState;
@@ -89,6 +99,11 @@ private:
 	Mesh* helix;
 	Mesh* sphere;
 	Mesh* torus;
+	GeometryPool* geometryPool;
+
+	// Position-only shapes for light volumes and the sky
+	ProxyMesh* lightVolume;
+	ProxyMesh* skyCube;
 
 	// Lights
 	SimplePixelShader* pointLightPS;
@@ -116,7 +131,7 @@ private:
 	void CreateLights();
 
 	// Wrappers for DirectX shaders to provide simplified functionality
-	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* vertexShaders[VERTEX_FORMAT_COUNT];
 	SimplePixelShader* pixelShader;
 	SimplePixelShader* lightShader;
 
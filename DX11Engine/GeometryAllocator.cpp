@@ -0,0 +1,116 @@
+#include "GeometryAllocator.h"
+
+GeometryAllocator::GeometryAllocator(unsigned int capacity)
+{
+	this->capacity = capacity;
+	used = 0;
+	allocations = 0;
+
+	Block all = { 0, capacity };
+	if (capacity > 0)
+		freeBlocks.push_back(all);
+}
+
+GeometryAllocator::~GeometryAllocator()
+{
+}
+
+unsigned int GeometryAllocator::Allocate(unsigned int count)
+{
+	if (count == 0)
+		return GEOMETRY_ALLOCATION_FAILED;
+
+	// Best fit
+	int best = -1;
+	for (int i = 0; i < (int)freeBlocks.size(); i++)
+	{
+		if (freeBlocks[i].Count >= count && (best < 0 || freeBlocks[i].Count < freeBlocks[best].Count))
+		{
+			best = i;
+			if (freeBlocks[i].Count == count)
+				break;
+		}
+	}
+
+	if (best < 0)
+		return GEOMETRY_ALLOCATION_FAILED;
+
+	// Take it from the front of the block
+	unsigned int offset = freeBlocks[best].Offset;
+	freeBlocks[best].Offset += count;
+	freeBlocks[best].Count -= count;
+	if (freeBlocks[best].Count == 0)
+		freeBlocks.erase(freeBlocks.begin() + best);
+
+	used += count;
+	allocations++;
+	return offset;
+}
+
+void GeometryAllocator::Free(unsigned int offset, unsigned int count)
+{
+	if (count == 0 || offset == GEOMETRY_ALLOCATION_FAILED)
+		return;
+
+	// First block after the freed range
+	size_t next = 0;
+	while (next < freeBlocks.size() && freeBlocks[next].Offset < offset)
+		next++;
+
+	bool mergePrevious = next > 0 && freeBlocks[next - 1].Offset + freeBlocks[next - 1].Count == offset;
+	bool mergeNext = next < freeBlocks.size() && offset + count == freeBlocks[next].Offset;
+
+	if (mergePrevious && mergeNext)
+	{
+		freeBlocks[next - 1].Count += count + freeBlocks[next].Count;
+		freeBlocks.erase(freeBlocks.begin() + next);
+	}
+	else if (mergePrevious)
+	{
+		freeBlocks[next - 1].Count += count;
+	}
+	else if (mergeNext)
+	{
+		freeBlocks[next].Offset = offset;
+		freeBlocks[next].Count += count;
+	}
+	else
+	{
+		Block block = { offset, count };
+		freeBlocks.insert(freeBlocks.begin() + next, block);
+	}
+
+	used -= count;
+	allocations--;
+}
+
+unsigned int GeometryAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+GeometryAllocatorStats GeometryAllocator::GetStats()
+{
+	GeometryAllocatorStats stats = {};
+	stats.Capacity = capacity;
+	stats.Used = used;
+	stats.Allocations = allocations;
+	stats.FreeBlocks = (unsigned int)freeBlocks.size();
+
+	for (size_t i = 0; i < freeBlocks.size(); i++)
+	{
+		if (freeBlocks[i].Count > stats.LargestFreeBlock)
+			stats.LargestFreeBlock = freeBlocks[i].Count;
+	}
+
+	return stats;
+}
+
+float GeometryAllocator::GetFragmentation()
+{
+	unsigned int free = capacity - used;
+	if (free == 0)
+		return 0.0f;
+
+	return 1.0f - (float)GetStats().LargestFreeBlock / free;
+}
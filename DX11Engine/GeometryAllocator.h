@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+// Returned by Allocate when nothing is big enough
+#define GEOMETRY_ALLOCATION_FAILED	0xFFFFFFFF
+
+// --------------------------------------------------------
+// Free space in a GeometryAllocator at one point in time
+// --------------------------------------------------------
+struct GeometryAllocatorStats
+{
+	unsigned int Capacity;
+	unsigned int Used;
+	unsigned int Allocations;
+	unsigned int FreeBlocks;
+	unsigned int LargestFreeBlock;
+};
+
+// --------------------------------------------------------
+// Free-list allocator over a range of [0, capacity) elements,
+// with no memory of its own, so it can hand out ranges of a
+// GPU buffer (or of nothing at all).
+//
+// Free blocks are kept sorted by offset.  Allocations take
+// the smallest block that fits (best fit) and freed ranges
+// merge with their neighbours, which keeps fragmentation low
+// for the mostly load-once meshes this is used for.
+// --------------------------------------------------------
+class GeometryAllocator
+{
+public:
+	GeometryAllocator(unsigned int capacity);
+	~GeometryAllocator();
+
+	// Offset of count free elements, or GEOMETRY_ALLOCATION_FAILED
+	unsigned int Allocate(unsigned int count);
+	void Free(unsigned int offset, unsigned int count);
+
+	unsigned int GetCapacity();
+	GeometryAllocatorStats GetStats();
+
+	// 0 when all free space is one block, approaching 1 as it's
+	// scattered into pieces too small to use
+	float GetFragmentation();
+
+private:
+	struct Block
+	{
+		unsigned int Offset;
+		unsigned int Count;
+	};
+
+	unsigned int capacity;
+	unsigned int used;
+	unsigned int allocations;
+	std::vector<Block> freeBlocks;
+};
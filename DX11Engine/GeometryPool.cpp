@@ -0,0 +1,230 @@
+#include "GeometryPool.h"
+
+GeometryPool::GeometryPool(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	this->device = device;
+	this->context = context;
+
+	ResetBindings();
+}
+
+GeometryPool::~GeometryPool()
+{
+	for (int f = 0; f < VERTEX_FORMAT_COUNT + 2; f++)
+	{
+		std::vector<Page>& pages = f < VERTEX_FORMAT_COUNT ? vertexPages[f] : indexPages[f - VERTEX_FORMAT_COUNT];
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			delete pages[i].Allocator;
+			if (pages[i].Buffers[0]) { pages[i].Buffers[0]->Release(); }
+			if (pages[i].Buffers[1]) { pages[i].Buffers[1]->Release(); }
+		}
+	}
+}
+
+bool GeometryPool::AllocateVertices(MeshVertexFormat format, UINT count, const void* const* streams, GeometryRange& range)
+{
+	int streamNum = VertexPacking::GetStreamCount(format);
+	UINT strides[2] = { VertexPacking::GetStride(format, 0), VertexPacking::GetStride(format, 1) };
+
+	if (!Allocate(vertexPages[format], count, GEOMETRY_POOL_PAGE_VERTICES, streamNum, strides, D3D11_BIND_VERTEX_BUFFER, range))
+		return false;
+
+	if (streams)
+		UpdateVertices(format, range, 0, count, streams);
+
+	return true;
+}
+
+bool GeometryPool::AllocateIndices(DXGI_FORMAT format, UINT count, const void* indices, GeometryRange& range)
+{
+	std::vector<Page>& pages = indexPages[GetIndexPool(format)];
+	UINT stride = format == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(UINT);
+
+	if (!Allocate(pages, count, GEOMETRY_POOL_PAGE_INDICES, 1, &stride, D3D11_BIND_INDEX_BUFFER, range))
+		return false;
+
+	UpdateIndices(format, range, 0, count, indices);
+	return true;
+}
+
+void GeometryPool::UpdateVertices(MeshVertexFormat format, const GeometryRange & range, UINT first, UINT count, const void * const * streams)
+{
+	if (range.Page < 0)
+		return;
+
+	for (int s = 0; s < VertexPacking::GetStreamCount(format); s++)
+		Upload(context, vertexPages[format][range.Page].Buffers[s], VertexPacking::GetStride(format, s), range.Offset + first, count, streams[s]);
+}
+
+void GeometryPool::UpdateIndices(DXGI_FORMAT format, const GeometryRange & range, UINT first, UINT count, const void * indices)
+{
+	if (range.Page < 0)
+		return;
+
+	UINT stride = format == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(UINT);
+	Upload(context, indexPages[GetIndexPool(format)][range.Page].Buffers[0], stride, range.Offset + first, count, indices);
+}
+
+void GeometryPool::FreeVertices(MeshVertexFormat format, GeometryRange& range)
+{
+	if (range.Page < 0)
+		return;
+
+	vertexPages[format][range.Page].Allocator->Free(range.Offset, range.Count);
+	range.Page = -1;
+}
+
+void GeometryPool::FreeIndices(DXGI_FORMAT format, GeometryRange& range)
+{
+	if (range.Page < 0)
+		return;
+
+	indexPages[GetIndexPool(format)][range.Page].Allocator->Free(range.Offset, range.Count);
+	range.Page = -1;
+}
+
+ID3D11Buffer * GeometryPool::GetVertexBuffer(MeshVertexFormat format, int page, int slot)
+{
+	if (page < 0)
+		return 0;
+	return vertexPages[format][page].Buffers[slot];
+}
+
+ID3D11Buffer * GeometryPool::GetIndexBuffer(DXGI_FORMAT format, int page)
+{
+	if (page < 0)
+		return 0;
+	return indexPages[GetIndexPool(format)][page].Buffers[0];
+}
+
+void GeometryPool::BindVertexBuffers(ID3D11DeviceContext * context, UINT bufferNum, ID3D11Buffer * const * buffers, const UINT * strides)
+{
+	bool bound = true;
+	for (UINT i = 0; i < bufferNum; i++)
+		bound = bound && boundBuffers[i] == buffers[i] && boundStrides[i] == strides[i];
+
+	if (bound)
+		return;
+
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, bufferNum, buffers, strides, offsets);
+
+	for (UINT i = 0; i < bufferNum; i++)
+	{
+		boundBuffers[i] = buffers[i];
+		boundStrides[i] = strides[i];
+	}
+}
+
+void GeometryPool::BindIndexBuffer(ID3D11DeviceContext * context, ID3D11Buffer * buffer, DXGI_FORMAT format)
+{
+	if (boundIndexBuffer == buffer && boundIndexFormat == format)
+		return;
+
+	context->IASetIndexBuffer(buffer, format, 0);
+	boundIndexBuffer = buffer;
+	boundIndexFormat = format;
+}
+
+void GeometryPool::ResetBindings()
+{
+	boundBuffers[0] = boundBuffers[1] = 0;
+	boundStrides[0] = boundStrides[1] = 0;
+	boundIndexBuffer = 0;
+	boundIndexFormat = DXGI_FORMAT_UNKNOWN;
+}
+
+GeometryAllocatorStats GeometryPool::GetVertexStats(MeshVertexFormat format)
+{
+	return SumStats(vertexPages[format]);
+}
+
+GeometryAllocatorStats GeometryPool::GetIndexStats(DXGI_FORMAT format)
+{
+	return SumStats(indexPages[GetIndexPool(format)]);
+}
+
+bool GeometryPool::Allocate(std::vector<Page>& pages, UINT count, UINT pageSize, int bufferNum, const UINT* strides, UINT bindFlags, GeometryRange& range)
+{
+	range.Page = -1;
+	range.Offset = 0;
+	range.Count = count;
+
+	if (count == 0)
+		return false;
+
+	for (size_t i = 0; i < pages.size(); i++)
+	{
+		UINT offset = pages[i].Allocator->Allocate(count);
+		if (offset != GEOMETRY_ALLOCATION_FAILED)
+		{
+			range.Page = (int)i;
+			range.Offset = offset;
+			return true;
+		}
+	}
+
+	// Nothing has room, so start a new page
+	Page page = {};
+	UINT capacity = max(pageSize, count);
+
+	if (device)
+	{
+		for (int b = 0; b < bufferNum; b++)
+		{
+			D3D11_BUFFER_DESC desc = {};
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			desc.ByteWidth = capacity * strides[b];
+			desc.BindFlags = bindFlags;
+
+			if (FAILED(device->CreateBuffer(&desc, 0, &page.Buffers[b])))
+			{
+				if (page.Buffers[0]) { page.Buffers[0]->Release(); }
+				return false;
+			}
+		}
+	}
+
+	page.Allocator = new GeometryAllocator(capacity);
+	pages.push_back(page);
+
+	range.Page = (int)pages.size() - 1;
+	range.Offset = page.Allocator->Allocate(count);
+	return true;
+}
+
+void GeometryPool::Upload(ID3D11DeviceContext * context, ID3D11Buffer * buffer, UINT stride, UINT offset, UINT count, const void * data)
+{
+	if (!buffer || !data || count == 0)
+		return;
+
+	// Buffers are addressed in bytes along x
+	D3D11_BOX box = {};
+	box.left = offset * stride;
+	box.right = (offset + count) * stride;
+	box.bottom = 1;
+	box.back = 1;
+
+	context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+}
+
+GeometryAllocatorStats GeometryPool::SumStats(std::vector<Page>& pages)
+{
+	GeometryAllocatorStats total = {};
+	for (size_t i = 0; i < pages.size(); i++)
+	{
+		GeometryAllocatorStats stats = pages[i].Allocator->GetStats();
+		total.Capacity += stats.Capacity;
+		total.Used += stats.Used;
+		total.Allocations += stats.Allocations;
+		total.FreeBlocks += stats.FreeBlocks;
+		total.LargestFreeBlock = max(total.LargestFreeBlock, stats.LargestFreeBlock);
+	}
+	return total;
+}
+
+int GeometryPool::GetIndexPool(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R16_UINT ? 0 : 1;
+}
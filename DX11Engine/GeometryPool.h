@@ -0,0 +1,101 @@
+#pragma once
+
+#include "GeometryAllocator.h"
+#include "VertexPacking.h"
+#include <vector>
+#include <d3d11.h>
+
+// Verts in each shared vertex buffer, per stream
+#define GEOMETRY_POOL_PAGE_VERTICES		262144
+
+// Indices in each shared index buffer
+#define GEOMETRY_POOL_PAGE_INDICES		1048576
+
+// --------------------------------------------------------
+// Elements [Offset, Offset + Count) of one of a pool's
+// buffers.  Page is -1 when nothing is allocated.
+// --------------------------------------------------------
+struct GeometryRange
+{
+	int Page;
+	UINT Offset;
+	UINT Count;
+};
+
+// --------------------------------------------------------
+// Shared vertex and index buffers that static meshes are
+// sub-allocated from, so drawing one mesh after another only
+// changes the base vertex and start index, not the bindings.
+//
+// Each vertex format gets its own pages, and a split
+// format's position and attribute buffers share one
+// allocator, so a mesh's streams start at the same vertex
+// and one base vertex works for both.  A page is a
+// GEOMETRY_POOL_PAGE_VERTICES sized buffer (or bigger, for
+// a mesh that wouldn't fit) and new ones are made as needed.
+//
+// Given a null device the pool only runs its allocators,
+// which is enough to check its behaviour without a GPU.
+// --------------------------------------------------------
+class GeometryPool
+{
+public:
+	GeometryPool(ID3D11Device* device, ID3D11DeviceContext* context);
+	~GeometryPool();
+
+	// streams has one pointer per stream of the format, in slot
+	// order, or is 0 to leave the range to be filled by Update
+	bool AllocateVertices(MeshVertexFormat format, UINT count, const void* const* streams, GeometryRange& range);
+	bool AllocateIndices(DXGI_FORMAT format, UINT count, const void* indices, GeometryRange& range);
+	void FreeVertices(MeshVertexFormat format, GeometryRange& range);
+	void FreeIndices(DXGI_FORMAT format, GeometryRange& range);
+
+	// Writes count elements into a range, first elements in, for
+	// meshes that arrive a piece at a time
+	void UpdateVertices(MeshVertexFormat format, const GeometryRange& range, UINT first, UINT count, const void* const* streams);
+	void UpdateIndices(DXGI_FORMAT format, const GeometryRange& range, UINT first, UINT count, const void* indices);
+
+	// Writes count elements of stride bytes at offset into a
+	// D3D11_USAGE_DEFAULT buffer, pooled or not
+	static void Upload(ID3D11DeviceContext* context, ID3D11Buffer* buffer, UINT stride, UINT offset, UINT count, const void* data);
+
+	ID3D11Buffer* GetVertexBuffer(MeshVertexFormat format, int page, int slot);
+	ID3D11Buffer* GetIndexBuffer(DXGI_FORMAT format, int page);
+
+	// Bind the way IASetVertexBuffers and IASetIndexBuffer would,
+	// skipping the call when those buffers are already bound
+	void BindVertexBuffers(ID3D11DeviceContext* context, UINT bufferNum, ID3D11Buffer* const* buffers, const UINT* strides);
+	void BindIndexBuffer(ID3D11DeviceContext* context, ID3D11Buffer* buffer, DXGI_FORMAT format);
+
+	// Call whenever anything else may have bound input assembler
+	// buffers, so the next Bind really binds
+	void ResetBindings();
+
+	// Totals over every page of a format
+	GeometryAllocatorStats GetVertexStats(MeshVertexFormat format);
+	GeometryAllocatorStats GetIndexStats(DXGI_FORMAT format);
+
+private:
+	struct Page
+	{
+		GeometryAllocator* Allocator;
+		ID3D11Buffer* Buffers[2];
+	};
+
+	bool Allocate(std::vector<Page>& pages, UINT count, UINT pageSize, int bufferNum, const UINT* strides, UINT bindFlags, GeometryRange& range);
+	static GeometryAllocatorStats SumStats(std::vector<Page>& pages);
+
+	static int GetIndexPool(DXGI_FORMAT format);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+
+	std::vector<Page> vertexPages[VERTEX_FORMAT_COUNT];
+	std::vector<Page> indexPages[2];	// 16 and 32-bit
+
+	// What Bind last bound
+	ID3D11Buffer* boundBuffers[2];
+	UINT boundStrides[2];
+	ID3D11Buffer* boundIndexBuffer;
+	DXGI_FORMAT boundIndexFormat;
+};
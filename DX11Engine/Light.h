@@ -4,7 +4,8 @@
 #include "GameObject.h"
 #include "Camera.h"
 #include "SimpleShader.h"
-#include "Mesh.h"
+#include "ProxyMesh.h"
+#include "TextureHandle.h"
 #include "Vertex.h"
 
 struct LightShaderInfo
@@ -18,7 +19,7 @@ struct LightShaderInfo
 class Light : public GameObject
 {
 public:
-	Light(XMFLOAT4X4 iWorld, Mesh* iMesh, ID3D11ShaderResourceView* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot, XMFLOAT3 scale);
+	Light(XMFLOAT4X4 iWorld, ProxyMesh* iMesh, TextureHandle* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot, XMFLOAT3 scale);
 	~Light();
 
 	virtual void PrepareShader(Camera* camera, ID3D11ShaderResourceView* albedo, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* pbr, ID3D11ShaderResourceView* depth) {};
@@ -27,10 +28,10 @@ public:
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
 	ID3D11SamplerState* sampler;
-	Mesh* mesh;
+	ProxyMesh* mesh;				// The light's volume, when it has one
 	XMFLOAT4 ambientColor;
 	XMFLOAT4 diffuseColor;
-	ID3D11ShaderResourceView* skybox;
+	TextureHandle* skybox;
 	LightShaderInfo info;
 	ID3D11RasterizerState* lightRasterState;
 };
@@ -0,0 +1,56 @@
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const char * path)
+{
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	data = 0;
+	size = 0;
+
+	file = CreateFile(
+		path,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	// Empty files can't be mapped, so there's nothing more to do
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	mapping = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+		return;
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data)
+		size = (size_t)fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) { UnmapViewOfFile(data); }
+	if (mapping) { CloseHandle(mapping); }
+	if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+}
+
+bool MappedFile::IsOpen()
+{
+	return data != 0;
+}
+
+const char * MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
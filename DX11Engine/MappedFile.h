@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// Read-only memory mapped view of an entire file.
+//
+// The file stays mapped (and locked for writing) for as
+// long as this object lives, so anything holding on to
+// GetData() must not outlive it.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const char* path);
+	~MappedFile();
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
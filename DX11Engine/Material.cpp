@@ -2,10 +2,11 @@
 
 
 
-Material::Material(SimpleVertexShader* vs, SimplePixelShader* ps, XMFLOAT2 scale, ID3D11ShaderResourceView* tex, ID3D11ShaderResourceView* norm, ID3D11ShaderResourceView* rough, ID3D11ShaderResourceView* met, ID3D11ShaderResourceView* sky, ID3D11SamplerState* ss)
+Material::Material(SimpleVertexShader** vs, SimplePixelShader* ps, XMFLOAT2 scale, TextureHandle* tex, TextureHandle* norm, TextureHandle* rough, TextureHandle* met, TextureHandle* sky, ID3D11SamplerState* ss)
 {
 	pixelShader = ps;
-	vertexShader = vs;
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+		vertexShaders[i] = vs[i];
 	texture = tex;
 	normals = norm;
 	metal = met;
@@ -19,36 +20,45 @@ Material::~Material()
 {
 }
 
-void Material::PrepareMaterial(XMFLOAT4X4 proj, XMFLOAT4X4 view, XMFLOAT4X4 world)
+void Material::PrepareMaterial(XMFLOAT4X4 proj, XMFLOAT4X4 view, XMFLOAT4X4 world, Mesh* mesh)
 {
+	// Each vertex format needs a shader with a matching input
+	// layout, and packed ones need to know how to decode positions
+	SimpleVertexShader* vs = vertexShaders[mesh->GetVertexFormat()];
+	if (mesh->GetVertexFormat() & VERTEX_FORMAT_PACKED)
+	{
+		vs->SetFloat3("positionOffset", mesh->GetPositionOffset());
+		vs->SetFloat3("positionScale", mesh->GetPositionScale());
+	}
+
 	// Send data to shader variables
 	//  - Do this ONCE PER OBJECT you're drawing
 	//  - This is actually a complex process of copying data to a local buffer
 	//    and then copying that entire buffer to the GPU.  
 	//  - The "SimpleShader" class handles all of that for you.
-	vertexShader->SetMatrix4x4("view", view);
-	vertexShader->SetMatrix4x4("projection", proj);
-	vertexShader->SetMatrix4x4("world", world);
-	vertexShader->SetFloat2("uvScale", uvScale);
+	vs->SetMatrix4x4("view", view);
+	vs->SetMatrix4x4("projection", proj);
+	vs->SetMatrix4x4("world", world);
+	vs->SetFloat2("uvScale", uvScale);
 
 	// Texture Stuff
 	pixelShader->SetSamplerState("basicSampler", sampleState);
-	pixelShader->SetShaderResourceView("diffuseTexture", texture);
-	pixelShader->SetShaderResourceView("normalTexture", normals);
-	pixelShader->SetShaderResourceView("roughnessTexture", roughness);
-	pixelShader->SetShaderResourceView("metalTexture", metal);
-	pixelShader->SetShaderResourceView("skyTexture", skybox);
+	pixelShader->SetShaderResourceView("diffuseTexture", texture->View);
+	pixelShader->SetShaderResourceView("normalTexture", normals->View);
+	pixelShader->SetShaderResourceView("roughnessTexture", roughness->View);
+	pixelShader->SetShaderResourceView("metalTexture", metal->View);
+	pixelShader->SetShaderResourceView("skyTexture", skybox->View);
 
 	// Set the vertex and pixel shaders to use for the next Draw() command
 	//  - These don't technically need to be set every frame...YET
 	//  - Once you start applying different shaders to different objects,
 	//    you'll need to swap the current shaders before each draw
-	vertexShader->SetShader();
+	vs->SetShader();
 	pixelShader->SetShader();
 
 	// Once you've set all of the data you care to change for
 	// the next draw call, you need to actually send it to the GPU
 	//  - If you skip this, the "SetMatrix" calls above won't make it to the GPU!
-	vertexShader->CopyAllBufferData();
+	vs->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
 }
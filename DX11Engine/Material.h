@@ -1,6 +1,8 @@
 #pragma once
 
 #include "SimpleShader.h"
+#include "Mesh.h"
+#include "TextureHandle.h"
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -8,25 +10,26 @@ using namespace DirectX;
 class Material
 {
 public:
-	Material(SimpleVertexShader* vs, SimplePixelShader* ps, XMFLOAT2 scale, ID3D11ShaderResourceView* tex, ID3D11ShaderResourceView* norm, ID3D11ShaderResourceView* rough, ID3D11ShaderResourceView* met, ID3D11ShaderResourceView* sky, ID3D11SamplerState* ss);
+	Material(SimpleVertexShader** vs, SimplePixelShader* ps, XMFLOAT2 scale, TextureHandle* tex, TextureHandle* norm, TextureHandle* rough, TextureHandle* met, TextureHandle* sky, ID3D11SamplerState* ss);
 	~Material();
 
-	void PrepareMaterial(XMFLOAT4X4 proj, XMFLOAT4X4 view, XMFLOAT4X4 world);
+	void PrepareMaterial(XMFLOAT4X4 proj, XMFLOAT4X4 view, XMFLOAT4X4 world, Mesh* mesh);
 
 private:
 	// Basic Info
 	XMFLOAT2 uvScale;
 
-	// Texture Info
-	ID3D11ShaderResourceView* texture;
-	ID3D11ShaderResourceView* normals;
-	ID3D11ShaderResourceView* roughness;
-	ID3D11ShaderResourceView* metal;
-	ID3D11ShaderResourceView* skybox;
+	// Texture Info, as handles so textures still loading
+	// are picked up once they're ready
+	TextureHandle* texture;
+	TextureHandle* normals;
+	TextureHandle* roughness;
+	TextureHandle* metal;
+	TextureHandle* skybox;
 	ID3D11SamplerState* sampleState;
 
 	// Wrappers for DirectX shaders to provide simplified functionality
-	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* vertexShaders[VERTEX_FORMAT_COUNT];		// One per MeshVertexFormat
 	SimplePixelShader* pixelShader;
 };
 
@@ -1,206 +1,468 @@
 #include "Mesh.h"
+#include "ObjLoader.h"
+#include "MeshCache.h"
+#include "MeshStream.h"
+#include "MeshOptimizer.h"
+#include "TangentGenerator.h"
 
-Mesh::Mesh(Vertex * vertices, int vertNum, UINT * indices, int indexNum, ID3D11Device* device)
+Mesh::Mesh(Vertex * vertices, int vertNum, UINT * indices, int indexNum, ID3D11Device* device, MeshVertexFormat format, GeometryPool* pool)
 {
-	SetBuffers(vertices, indices, vertNum, indexNum, device);
+	Init(format, pool);
+
+	// Nothing to draw, so don't make buffers for it
+	if (vertNum <= 0 || indexNum <= 0)
+		return;
+
+	MeshData data;
+	data.Vertices.assign(vertices, vertices + vertNum);
+	data.Indices.assign(indices, indices + indexNum);
+
+	// Create tangents
+	CalculateTangents(&data.Vertices[0], vertNum, &data.Indices[0], indexNum);
+
+	// The whole index buffer is the only LOD and submesh
+	MeshLOD full = { 0, (UINT)indexNum, 0.0f };
+	data.LODs.assign(1, full);
+
+	MeshSubmesh whole = {};
+	whole.IndexCount[0] = indexNum;
+	data.Submeshes.assign(1, whole);
+
+	CalculateBounds(data);
+	BuildClusters(data);
+	BuildBVH(data);
+
+	SetData(data, device);
+}
+
+Mesh::Mesh(const MeshData & data, ID3D11Device * device, MeshVertexFormat format, GeometryPool * pool)
+{
+	Init(format, pool);
+	SetData(data, device);
 }
 
-Mesh::Mesh(char * file, ID3D11Device * device)
+Mesh::Mesh(char * file, ID3D11Device * device, MeshVertexFormat format, GeometryPool* pool)
+{
+	Init(format, pool);
+
+	MeshData data;
+	if (Load(file, data))
+		SetData(data, device);
+}
+
+Mesh::~Mesh()
+{
+	ReleaseBuffers();
+}
+
+// --------------------------------------------------------
+// Reads an OBJ from Assets/Models into data, through the
+// binary cache when it's up to date.  Touches nothing but
+// the files and data, so it's safe to call on any thread.
+// --------------------------------------------------------
+bool Mesh::Load(const char * file, MeshData & data, int threadCount)
 {
 	// File input object
 	std::string path = "Assets/Models/";
 	path += file;
 
-	std::ifstream obj(path);
+	MappedFile source(path.c_str());
 
 	// Check for successful open
-	if (!obj.is_open())
-		return;
+	if (!source.IsOpen())
+		return false;
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-										 // Still have data left?
-	while (obj.good())
+	// Use the binary cache next to the OBJ if it was built from this
+	// exact file, skipping everything but the clusters
+	unsigned long long sourceHash = MeshCache::Hash(source.GetData(), source.GetSize());
+	std::string cachePath = path + ".meshbin";
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
+		MeshCache cache(cachePath.c_str());
+		if (cache.IsValid(sourceHash))
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
+			const MeshCacheHeader* header = cache.GetHeader();
+
+			// Decode straight into the arrays that get uploaded
+			data.Vertices.resize(header->VertexCount);
+			data.Indices.resize(header->IndexCount);
+			if (cache.Decode(header->LODCount, &data.Vertices[0], &data.Indices[0]))
+			{
+				data.LODs.assign(cache.GetLODs(), cache.GetLODs() + header->LODCount);
+				data.Submeshes.assign(cache.GetSubmeshes(), cache.GetSubmeshes() + header->SubmeshCount);
+				data.Box = header->Box;
+				data.Sphere = header->Sphere;
+
+				BuildClusters(data);
+				BuildBVH(data);
+				return true;
+			}
+
+			// Corrupt, so rebuild it from the OBJ
+			data.Vertices.clear();
+			data.Indices.clear();
 		}
-		else if (chars[0] == 'v' && chars[1] == 't')
+	}
+
+	std::vector<Vertex>& verts = data.Vertices;		// Verts we're assembling
+	std::vector<UINT>& indices = data.Indices;		// Indices of these verts
+
+	ObjLoader::Parse(source.GetData(), source.GetSize(), verts, indices, data.Submeshes, threadCount);
+	if (verts.empty() || indices.empty())
+		return false;
+
+	// - At this point, "verts" is a vector of Vertex structs, and can be used
+	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
+	//
+	// - The vector "indices" is similar. It's a vector of unsigned ints and
+	//    can be used directly for the index buffer: &indices[0] is the address of the first int
+	CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size(), threadCount);
+
+	// Reorder for the GPU before the result is cached, so
+	// this only costs anything when the OBJ has changed
+	Optimize(verts, indices, data.Submeshes);
+
+	// Simplified LODs go on the end of the index buffer
+	MeshSimplifier::GenerateLODs(&verts[0], (int)verts.size(), indices, data.LODs, data.Submeshes);
+
+	// Coarsest first, so the cache can be loaded a level at a time
+	MeshStream::Reorder(data);
+
+	CalculateBounds(data);
+	BuildClusters(data);
+	BuildBVH(data);
+
+	MeshCache::Write(cachePath.c_str(), sourceHash, &verts[0], (int)verts.size(), &indices[0], (int)indices.size(), &data.LODs[0], (int)data.LODs.size(), &data.Submeshes[0], (int)data.Submeshes.size(), data.Box, data.Sphere);
+	return true;
+}
+
+// --------------------------------------------------------
+// The box is a min/max reduction over every position, kept
+// four ways so each vert's min and max don't wait on the
+// vert before.  The sphere is DirectXMath's, which is
+// Ritter's: it starts from the farthest apart pair of
+// extreme points and grows to take in any left outside.
+// A mesh without verts keeps the default bounds.
+// --------------------------------------------------------
+void Mesh::CalculateBounds(MeshData & data)
+{
+	data.Box = BoundingBox();
+	data.Sphere = BoundingSphere();
+
+	size_t vertNum = data.Vertices.size();
+	if (vertNum == 0)
+		return;
+
+	const Vertex* verts = &data.Vertices[0];
+	XMVECTOR lowest[4];
+	XMVECTOR highest[4];
+	for (int i = 0; i < 4; i++)
+		lowest[i] = highest[i] = XMLoadFloat3(&verts[0].Position);
+
+	size_t v = 0;
+	for (; v + 4 <= vertNum; v += 4)
+	{
+		for (int i = 0; i < 4; i++)
 		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
+			XMVECTOR position = XMLoadFloat3(&verts[v + i].Position);
+			lowest[i] = XMVectorMin(lowest[i], position);
+			highest[i] = XMVectorMax(highest[i], position);
 		}
-		else if (chars[0] == 'v')
+	}
+	for (; v < vertNum; v++)
+	{
+		XMVECTOR position = XMLoadFloat3(&verts[v].Position);
+		lowest[0] = XMVectorMin(lowest[0], position);
+		highest[0] = XMVectorMax(highest[0], position);
+	}
+
+	XMVECTOR boxMin = XMVectorMin(XMVectorMin(lowest[0], lowest[1]), XMVectorMin(lowest[2], lowest[3]));
+	XMVECTOR boxMax = XMVectorMax(XMVectorMax(highest[0], highest[1]), XMVectorMax(highest[2], highest[3]));
+	BoundingBox::CreateFromPoints(data.Box, boxMin, boxMax);
+	BoundingSphere::CreateFromPoints(data.Sphere, vertNum, &verts[0].Position, sizeof(Vertex));
+}
+
+// --------------------------------------------------------
+// Clusters each submesh's LOD 0 range separately, so every
+// cluster is drawn with a single material
+// --------------------------------------------------------
+void Mesh::BuildClusters(MeshData & data)
+{
+	data.Clusters.clear();
+
+	std::vector<MeshCluster> clusters;
+	for (size_t i = 0; i < data.Submeshes.size(); i++)
+	{
+		MeshSubmesh& submesh = data.Submeshes[i];
+		MeshClusterizer::BuildClusters(&data.Vertices[0], (int)data.Vertices.size(), &data.Indices[0], submesh.StartIndex[0], submesh.IndexCount[0], clusters);
+
+		submesh.FirstCluster = (UINT)data.Clusters.size();
+		submesh.ClusterCount = (UINT)clusters.size();
+		data.Clusters.insert(data.Clusters.end(), clusters.begin(), clusters.end());
+	}
+}
+
+// --------------------------------------------------------
+// Rebuilt on every load instead of cached, so the cache stays
+// small; like the rest of Load it runs on the loading thread
+// --------------------------------------------------------
+void Mesh::BuildBVH(MeshData & data)
+{
+	const MeshLOD& full = data.LODs[0];
+	data.BVH.Build(&data.Vertices[0], &data.Indices[full.StartIndex], full.IndexCount);
+}
+
+// --------------------------------------------------------
+// Verts and indices the way a mesh's buffers take them
+// --------------------------------------------------------
+struct MeshUpload
+{
+	std::vector<PackedVertex> Packed;
+	std::vector<XMFLOAT3> Positions;
+	std::vector<VertexAttributes> Attributes;
+	std::vector<PackedVertexAttributes> PackedAttributes;
+	std::vector<unsigned short> ShortIndices;
+
+	const void* Streams[2];		// In slot order
+	const void* Indices;
+};
+
+// --------------------------------------------------------
+// Packed meshes keep the float verts on the CPU only and hand
+// the GPU the quantized copy.  Split meshes move the positions
+// out into their own stream.
+// --------------------------------------------------------
+static void ConvertForUpload(const Vertex* vertices, int vertNum, const UINT* indices, int indexNum, MeshVertexFormat format, XMFLOAT3 positionOffset, XMFLOAT3 positionScale, DXGI_FORMAT indexFormat, MeshUpload& upload)
+{
+	upload.Streams[0] = vertices;
+	upload.Streams[1] = 0;
+	upload.Indices = indices;
+
+	if (format == VERTEX_FORMAT_PACKED)
+	{
+		upload.Packed.resize(vertNum);
+		VertexPacking::Pack(vertices, vertNum, positionOffset, positionScale, upload.Packed.data());
+		upload.Streams[0] = upload.Packed.data();
+	}
+
+	if (format & VERTEX_FORMAT_SPLIT)
+	{
+		upload.Positions.resize(vertNum);
+		for (int i = 0; i < vertNum; i++)
+			upload.Positions[i] = vertices[i].Position;
+		upload.Streams[0] = upload.Positions.data();
+
+		if (format & VERTEX_FORMAT_PACKED)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			// Positions stay as floats, so only the attributes get packed
+			upload.Packed.resize(vertNum);
+			VertexPacking::Pack(vertices, vertNum, positionOffset, positionScale, upload.Packed.data());
+
+			upload.PackedAttributes.resize(vertNum);
+			for (int i = 0; i < vertNum; i++)
+			{
+				upload.PackedAttributes[i].Normal = upload.Packed[i].Normal;
+				upload.PackedAttributes[i].Tangent = upload.Packed[i].Tangent;
+				upload.PackedAttributes[i].UV = upload.Packed[i].UV;
+			}
+			upload.Streams[1] = upload.PackedAttributes.data();
 		}
-		else if (chars[0] == 'f')
+		else
 		{
-			// Read the face indices into an array
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
+			upload.Attributes.resize(vertNum);
+			for (int i = 0; i < vertNum; i++)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
+				upload.Attributes[i].Normal = vertices[i].Normal;
+				upload.Attributes[i].Tangent = vertices[i].Tangent;
+				upload.Attributes[i].UV = vertices[i].UV;
 			}
+			upload.Streams[1] = upload.Attributes.data();
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	if (indexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		upload.ShortIndices.resize(indexNum);
+		for (int i = 0; i < indexNum; i++)
+			upload.ShortIndices[i] = (unsigned short)indices[i];
+		upload.Indices = upload.ShortIndices.data();
+	}
+}
+
+// --------------------------------------------------------
+// Replaces whatever the mesh was drawing (nothing, or a
+// placeholder) with data, or adds a streamed level to the
+// levels before it.  Empty data, or a level that doesn't
+// follow what the mesh has, leaves it as it was.
+// Must be called on the thread that owns the device and
+// the pool.
+// --------------------------------------------------------
+void Mesh::SetData(const MeshData & data, ID3D11Device * device)
+{
+	if (data.Indices.empty() || data.LODs.empty())
+		return;
 
+	bool appending = data.FirstVertex > 0 || data.FirstIndex > 0;
+	if (appending)
+	{
+		if (data.FirstVertex != vertexCount || data.FirstIndex != indexCount ||
+			vertexCount + data.Vertices.size() > vertexCapacity || indexCount + data.Indices.size() > indexCapacity)
+			return;
+	}
+	else
+	{
+		if (data.Vertices.empty())
+			return;
+		ReleaseBuffers();
+	}
 
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
-	SetBuffers(&verts[0], &indices[0], vertCounter, vertCounter, device);
+	lods = data.LODs;
+	submeshes = data.Submeshes;
+	clusters = data.Clusters;
+	bvh = data.BVH;
+	boundingBox = data.Box;
+	boundingSphere = data.Sphere;
+	numIndices = lods[0].IndexCount;
+
+	int vertNum = (int)data.Vertices.size();
+	int indexNum = (int)data.Indices.size();
+	if (appending)
+		AppendBuffers(data.Vertices.data(), data.Indices.data(), vertNum, indexNum, device);
+	else
+		CreateBuffers(data.Vertices.data(), data.Indices.data(), vertNum, indexNum, max(data.TotalVertices, (UINT)vertNum), max(data.TotalIndices, (UINT)indexNum), device);
 }
 
-Mesh::~Mesh()
+void Mesh::Init(MeshVertexFormat format, GeometryPool * pool)
 {
-	if (vertexBuffer) { vertexBuffer->Release(); }
-	if (indexBuffer) { indexBuffer->Release(); }
+	vertexBuffer = 0;
+	positionBuffer = 0;
+	indexBuffer = 0;
+	this->pool = pool;
+	vertexRange.Page = -1;
+	indexRange.Page = -1;
+	vertexCount = 0;
+	indexCount = 0;
+	vertexCapacity = 0;
+	indexCapacity = 0;
+	numIndices = 0;
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	vertexFormat = format;
+	positionOffset = XMFLOAT3(0, 0, 0);
+	positionScale = XMFLOAT3(0, 0, 0);
+	refinementWanted = false;
 }
 
-void Mesh::SetBuffers(Vertex * vertices, UINT * indices, int vertNum, int indexNum, ID3D11Device* device)
+void Mesh::ReleaseBuffers()
 {
-	// Create tangents
-	CalculateTangents(vertices, vertNum, indices, indexNum);
+	// Pooled buffers aren't ours, just the ranges in them
+	if (pool)
+	{
+		pool->FreeVertices(vertexFormat, vertexRange);
+		pool->FreeIndices(indexFormat, indexRange);
+	}
+	else
+	{
+		if (vertexBuffer) { vertexBuffer->Release(); }
+		if (positionBuffer) { positionBuffer->Release(); }
+		if (indexBuffer) { indexBuffer->Release(); }
+	}
 
 	vertexBuffer = 0;
+	positionBuffer = 0;
 	indexBuffer = 0;
-	numIndices = indexNum;
+	vertexCount = 0;
+	indexCount = 0;
+	vertexCapacity = 0;
+	indexCapacity = 0;
+}
+
+// --------------------------------------------------------
+// Makes buffers with room for vertexCapacity verts and
+// indexCapacity indices and fills the start of them.  With
+// room to spare they stay writable, for AppendBuffers.
+// --------------------------------------------------------
+void Mesh::CreateBuffers(const Vertex * vertices, const UINT * indices, int vertNum, int indexNum, UINT vertexCapacity, UINT indexCapacity, ID3D11Device* device)
+{
+	bool growing = vertexCapacity > (UINT)vertNum || indexCapacity > (UINT)indexNum;
+
+	// Packed positions are stored relative to a range.  A mesh
+	// that's still growing uses its final bounds, so the levels
+	// to come fit the same range.
+	positionOffset = XMFLOAT3(0, 0, 0);
+	positionScale = XMFLOAT3(1, 1, 1);
+	if (vertexFormat == VERTEX_FORMAT_PACKED)
+	{
+		if (growing)
+		{
+			XMStoreFloat3(&positionOffset, XMLoadFloat3(&boundingBox.Center) - XMLoadFloat3(&boundingBox.Extents));
+			XMStoreFloat3(&positionScale, XMLoadFloat3(&boundingBox.Extents) * 2.0f);
+		}
+		else
+		{
+			VertexPacking::CalculatePositionRange(vertices, vertNum, positionOffset, positionScale);
+		}
+	}
+
+	// Anything with few enough verts can use half size indices
+	indexFormat = ChooseIndexFormat((int)vertexCapacity);
+
+	MeshUpload upload;
+	ConvertForUpload(vertices, vertNum, indices, indexNum, vertexFormat, positionOffset, positionScale, indexFormat, upload);
+
+	vertexCount = vertNum;
+	indexCount = indexNum;
+	this->vertexCapacity = vertexCapacity;
+	this->indexCapacity = indexCapacity;
+
+	// Pooled meshes go into the pool's shared buffers and
+	// remember where, instead of making buffers of their own
+	if (pool)
+	{
+		if (pool->AllocateVertices(vertexFormat, vertexCapacity, 0, vertexRange) &&
+			pool->AllocateIndices(indexFormat, indexCapacity, 0, indexRange))
+		{
+			int slot = VertexPacking::GetStreamCount(vertexFormat) - 1;
+			vertexBuffer = pool->GetVertexBuffer(vertexFormat, vertexRange.Page, slot);
+			positionBuffer = slot > 0 ? pool->GetVertexBuffer(vertexFormat, vertexRange.Page, 0) : 0;
+			indexBuffer = pool->GetIndexBuffer(indexFormat, indexRange.Page);
+
+			pool->UpdateVertices(vertexFormat, vertexRange, 0, vertNum, upload.Streams);
+			pool->UpdateIndices(indexFormat, indexRange, 0, indexNum, upload.Indices);
+			return;
+		}
+
+		// The pool couldn't make room, so give back whatever it did
+		// hand out and let this mesh have buffers of its own
+		pool->FreeVertices(vertexFormat, vertexRange);
+		pool->FreeIndices(indexFormat, indexRange);
+		pool = 0;
+	}
+
+	// Finished meshes never change, so the buffers start out
+	// with their data.  Growing ones are filled after.
+	D3D11_USAGE usage = growing ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE;
+	int slot = VertexPacking::GetStreamCount(vertexFormat) - 1;
+
+	// Positions are the only stream depth-only passes need, so
+	// they get a buffer of their own with nothing in between
+	if (vertexFormat & VERTEX_FORMAT_SPLIT)
+	{
+		D3D11_BUFFER_DESC pbd = {};
+		pbd.Usage = usage;
+		pbd.ByteWidth = sizeof(XMFLOAT3) * vertexCapacity;
+		pbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+		D3D11_SUBRESOURCE_DATA initialPositionData = {};
+		initialPositionData.pSysMem = upload.Streams[0];
+
+		device->CreateBuffer(&pbd, growing ? 0 : &initialPositionData, &positionBuffer);
+	}
 
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * vertNum;       // 3 = number of vertices in the buffer
+	vbd.Usage = usage;
+	vbd.ByteWidth = GetVertexStride() * vertexCapacity;
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -209,20 +471,17 @@ void Mesh::SetBuffers(Vertex * vertices, UINT * indices, int vertNum, int indexN
 	// Create the proper struct to hold the initial vertex data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertices;
+	initialVertexData.pSysMem = upload.Streams[slot];
 
 	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&vbd, &initialVertexData, &vertexBuffer);
-
-
+	device->CreateBuffer(&vbd, growing ? 0 : &initialVertexData, &vertexBuffer);
 
 	// Create the INDEX BUFFER description ------------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * indexNum;
+	ibd.Usage = usage;
+	ibd.ByteWidth = GetIndexSize(indexFormat) * indexCapacity;
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -231,86 +490,311 @@ void Mesh::SetBuffers(Vertex * vertices, UINT * indices, int vertNum, int indexN
 	// Create the proper struct to hold the initial index data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
+	initialIndexData.pSysMem = upload.Indices;
 
 	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
+	device->CreateBuffer(&ibd, growing ? 0 : &initialIndexData, &indexBuffer);
+
+	if (growing)
+		WriteBuffers(upload.Streams, upload.Indices, 0, 0, vertNum, indexNum, device);
 }
 
-void Mesh::CalculateTangents(Vertex * vertices, int vertNum, UINT * indices, int indexNum)
+// --------------------------------------------------------
+// Adds verts and indices after the ones already in the
+// buffers, in the room CreateBuffers left.  Indices count
+// from the mesh's first vert, like the ones before them.
+// --------------------------------------------------------
+void Mesh::AppendBuffers(const Vertex * vertices, const UINT * indices, int vertNum, int indexNum, ID3D11Device * device)
 {
-	// Clear tangents
-	for (int i = 0; i < vertNum; i++)
+	MeshUpload upload;
+	ConvertForUpload(vertices, vertNum, indices, indexNum, vertexFormat, positionOffset, positionScale, indexFormat, upload);
+
+	WriteBuffers(upload.Streams, upload.Indices, vertexCount, indexCount, vertNum, indexNum, device);
+	vertexCount += vertNum;
+	indexCount += indexNum;
+}
+
+void Mesh::WriteBuffers(const void * const * streams, const void * indices, UINT firstVertex, UINT firstIndex, int vertNum, int indexNum, ID3D11Device * device)
+{
+	if (pool)
 	{
-		vertices[i].Tangent = XMFLOAT3(0, 0, 0);
+		pool->UpdateVertices(vertexFormat, vertexRange, firstVertex, vertNum, streams);
+		pool->UpdateIndices(indexFormat, indexRange, firstIndex, indexNum, indices);
+		return;
 	}
 
-	// Calculate one triangle at a time
-	for (int i = 0; i < vertNum;)
+	ID3D11DeviceContext* context = 0;
+	device->GetImmediateContext(&context);
+
+	int slot = VertexPacking::GetStreamCount(vertexFormat) - 1;
+	if (slot > 0)
+		GeometryPool::Upload(context, positionBuffer, sizeof(XMFLOAT3), firstVertex, vertNum, streams[0]);
+	GeometryPool::Upload(context, vertexBuffer, GetVertexStride(), firstVertex, vertNum, streams[slot]);
+	GeometryPool::Upload(context, indexBuffer, GetIndexSize(indexFormat), firstIndex, indexNum, indices);
+
+	context->Release();
+}
+
+void Mesh::CalculateTangents(Vertex * vertices, int vertNum, UINT * indices, int indexNum, int threadCount)
+{
+	TangentGenerator::Generate(vertices, vertNum, indices, indexNum, threadCount);
+}
+
+// --------------------------------------------------------
+// Reorders each submesh's triangles for the post-transform
+// cache and for overdraw, then the vertex buffer for fetch
+// locality
+// --------------------------------------------------------
+void Mesh::Optimize(std::vector<Vertex>& verts, std::vector<UINT>& indices, const std::vector<MeshSubmesh>& submeshes)
+{
+	int vertNum = (int)verts.size();
+	int indexNum = (int)indices.size();
+
+	// Triangles never move between submeshes
+	for (size_t i = 0; i < submeshes.size(); i++)
 	{
-		UINT i1 = indices[i++];
-		UINT i2 = indices[i++];
-		UINT i3 = indices[i++];
-		Vertex* v1 = &vertices[i1];
-		Vertex* v2 = &vertices[i2];
-		Vertex* v3 = &vertices[i3];
+		UINT* range = &indices[0] + submeshes[i].StartIndex[0];
+		int rangeNum = (int)submeshes[i].IndexCount[0];
+		if (rangeNum == 0)
+			continue;
+
+		MeshOptimizer::OptimizeVertexCache(range, rangeNum, vertNum);
+		MeshOptimizer::OptimizeOverdraw(&verts[0], range, rangeNum, vertNum);
+	}
+
+	vertNum = MeshOptimizer::OptimizeVertexFetch(&verts[0], &indices[0], indexNum, vertNum);
+	verts.resize(vertNum);
+}
+
+ID3D11Buffer * Mesh::GetVertexBuffer()
+{
+	return vertexBuffer;
+}
+
+ID3D11Buffer * Mesh::GetIndexBuffer()
+{
+	return indexBuffer;
+}
 
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
+int Mesh::GetIndexCount()
+{
+	return numIndices;
+}
 
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
+DXGI_FORMAT Mesh::GetIndexFormat()
+{
+	return indexFormat;
+}
 
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
+// --------------------------------------------------------
+// 16-bit indices can address 65536 verts (0 - 65535), which
+// covers every mesh that isn't unusually dense
+// --------------------------------------------------------
+DXGI_FORMAT Mesh::ChooseIndexFormat(int vertNum)
+{
+	return vertNum <= 65536 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
 
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
+UINT Mesh::GetIndexSize(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(UINT);
+}
 
-		float r = 1.0f / (s1 * t2 - s2 * t1);
+MeshVertexFormat Mesh::GetVertexFormat()
+{
+	return vertexFormat;
+}
 
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
+UINT Mesh::GetVertexStride()
+{
+	// The stride of vertexBuffer, which holds the attributes when split
+	return VertexPacking::GetStride(vertexFormat, VertexPacking::GetStreamCount(vertexFormat) - 1);
+}
 
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
+ID3D11Buffer * Mesh::GetPositionBuffer()
+{
+	return positionBuffer;
+}
 
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
+// --------------------------------------------------------
+// Binds every vertex stream the mesh has, for the passes
+// that use the full vertex (the G-buffer pass)
+// --------------------------------------------------------
+void Mesh::BindVertexStreams(ID3D11DeviceContext * context)
+{
+	if (vertexFormat & VERTEX_FORMAT_SPLIT)
+	{
+		ID3D11Buffer* buffers[2] = { positionBuffer, vertexBuffer };
+		UINT strides[2] = { sizeof(XMFLOAT3), GetVertexStride() };
+		BindBuffers(context, 2, buffers, strides);
+	}
+	else
+	{
+		UINT stride = GetVertexStride();
+		BindBuffers(context, 1, &vertexBuffer, &stride);
+	}
+}
 
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tx;
+// --------------------------------------------------------
+// Binds just the float positions to slot 0 for shaders that
+// only read POSITION.  Unsplit full meshes can do this too,
+// at their full stride, but packed positions can't.
+// --------------------------------------------------------
+bool Mesh::BindPositionStream(ID3D11DeviceContext * context)
+{
+	if (vertexFormat & VERTEX_FORMAT_SPLIT)
+	{
+		UINT stride = sizeof(XMFLOAT3);
+		BindBuffers(context, 1, &positionBuffer, &stride);
+		return true;
 	}
 
-	for (int i = 0; i < vertNum; i++)
+	if (vertexFormat == VERTEX_FORMAT_FULL)
 	{
-		XMVECTOR normal = XMLoadFloat3(&vertices[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&vertices[i].Tangent);
+		UINT stride = sizeof(Vertex);
+		BindBuffers(context, 1, &vertexBuffer, &stride);
+		return true;
+	}
+
+	return false;
+}
 
-		tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent));
+void Mesh::BindIndexBuffer(ID3D11DeviceContext * context)
+{
+	if (pool)
+		pool->BindIndexBuffer(context, indexBuffer, indexFormat);
+	else
+		context->IASetIndexBuffer(indexBuffer, indexFormat, 0);
+}
 
-		XMStoreFloat3(&vertices[i].Tangent, tangent);
+// Pooled meshes let the pool skip binds that change nothing
+void Mesh::BindBuffers(ID3D11DeviceContext * context, UINT bufferNum, ID3D11Buffer * const * buffers, const UINT * strides)
+{
+	if (pool)
+	{
+		pool->BindVertexBuffers(context, bufferNum, buffers, strides);
+		return;
 	}
+
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, bufferNum, buffers, strides, offsets);
 }
 
-ID3D11Buffer * Mesh::GetVertexBuffer()
+UINT Mesh::GetStartIndex()
 {
-	return vertexBuffer;
+	return indexRange.Page < 0 ? 0 : indexRange.Offset;
 }
 
-ID3D11Buffer * Mesh::GetIndexBuffer()
+int Mesh::GetBaseVertex()
 {
-	return indexBuffer;
+	return vertexRange.Page < 0 ? 0 : (int)vertexRange.Offset;
 }
 
-int Mesh::GetIndexCount()
+XMFLOAT3 Mesh::GetPositionOffset()
 {
-	return numIndices;
+	return positionOffset;
+}
+
+XMFLOAT3 Mesh::GetPositionScale()
+{
+	return positionScale;
+}
+
+int Mesh::GetLODCount()
+{
+	return (int)lods.size();
+}
+
+const MeshLOD & Mesh::GetLOD(int lod)
+{
+	return lods[lod];
+}
+
+const BoundingBox & Mesh::GetBoundingBox()
+{
+	return boundingBox;
+}
+
+const BoundingSphere & Mesh::GetBoundingSphere()
+{
+	return boundingSphere;
+}
+
+void Mesh::GetWorldBounds(XMFLOAT4X4 world, BoundingBox & box, BoundingSphere & sphere)
+{
+	XMMATRIX W = XMMatrixTranspose(XMLoadFloat4x4(&world));
+	boundingBox.Transform(box, W);
+	boundingSphere.Transform(sphere, W);
+}
+
+int Mesh::GetSubmeshCount()
+{
+	return (int)submeshes.size();
+}
+
+const MeshSubmesh & Mesh::GetSubmesh(int submesh)
+{
+	return submeshes[submesh];
+}
+
+int Mesh::GetClusterCount()
+{
+	return (int)clusters.size();
+}
+
+const MeshCluster * Mesh::GetClusters()
+{
+	return clusters.data();
+}
+
+MeshBVH * Mesh::GetBVH()
+{
+	return &bvh;
+}
+
+bool Mesh::TakeRefinementRequest()
+{
+	bool wanted = refinementWanted;
+	refinementWanted = false;
+	return wanted;
+}
+
+// --------------------------------------------------------
+// A LOD's error is a distance in model units.  Scaled into
+// the world and projected at the mesh's distance from the
+// camera, it becomes
+//    pixels = error * scale * proj._22 * (height / 2) / distance
+// --------------------------------------------------------
+int Mesh::SelectLOD(Camera * camera, XMFLOAT4X4 world, float maxPixelError)
+{
+	// Only a partly streamed mesh has an error at LOD 0
+	if (lods.size() < 2 && (lods.empty() || lods[0].Error == 0.0f))
+		return 0;
+
+	XMMATRIX W = XMMatrixTranspose(XMLoadFloat4x4(&world));
+
+	// Errors grow with the largest axis scale
+	float scale = max(XMVectorGetX(XMVector3Length(W.r[0])),
+		max(XMVectorGetX(XMVector3Length(W.r[1])), XMVectorGetX(XMVector3Length(W.r[2]))));
+
+	// Measured to the middle of the mesh, and never closer than the near plane
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&boundingSphere.Center), W);
+	float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&camera->position)));
+	distance = max(distance, 0.1f);
+
+	float pixelsPerUnit = scale * camera->projMat._22 * camera->screenHeight * 0.5f / distance;
+
+	// Even the finest LOD there is isn't enough
+	if (lods[0].Error * pixelsPerUnit > maxPixelError)
+		refinementWanted = true;
+
+	int selected = 0;
+	for (int i = 1; i < (int)lods.size(); i++)
+	{
+		if (lods[i].Error * pixelsPerUnit > maxPixelError)
+			break;
+		selected = i;
+	}
+
+	return selected;
 }
@@ -1,30 +1,174 @@
 #pragma once
 
 #include "Vertex.h"
-#include <fstream>
+#include "VertexPacking.h"
+#include "MeshSimplifier.h"
+#include "MeshClusterizer.h"
+#include "MeshBVH.h"
+#include "GeometryPool.h"
+#include "Camera.h"
+#include <string>
 #include <vector>
 #include <d3d11.h>
+#include <DirectXCollision.h>
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// --------------------------------------------------------
+// Everything about a mesh that's worked out on the CPU,
+// ready for Mesh::SetData to turn into buffers.
+//
+// A streamed mesh arrives a level at a time, each adding to
+// the end of the verts and indices before it.  Its data then
+// holds only the level's verts and indices, to go after the
+// FirstVertex and FirstIndex already in the mesh, and the
+// totals once every level is in say how much room to keep.
+// Everything else describes the mesh as it is with the
+// level added.  A whole mesh leaves all four at 0.
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<UINT> Indices;		// Every LOD, one after another
+	std::vector<MeshLOD> LODs;
+	std::vector<MeshSubmesh> Submeshes;	// At least one, covering every LOD
+	std::vector<MeshCluster> Clusters;	// Of LOD 0, submesh by submesh
+	MeshBVH BVH;						// Of LOD 0, for ray casts
+	BoundingBox Box;
+	BoundingSphere Sphere;
+
+	UINT FirstVertex;
+	UINT FirstIndex;
+	UINT TotalVertices;
+	UINT TotalIndices;
+
+	MeshData() : FirstVertex(0), FirstIndex(0), TotalVertices(0), TotalIndices(0) {}
+};
+
 class Mesh
 {
 public:
-	Mesh(Vertex* vertices, int vertNum, UINT* indices, int indexNum, ID3D11Device* device);
-	Mesh(char* file, ID3D11Device* device);
+	// With a pool, the mesh's data goes into the pool's shared
+	// buffers instead of buffers of its own
+	Mesh(Vertex* vertices, int vertNum, UINT* indices, int indexNum, ID3D11Device* device, MeshVertexFormat format = VERTEX_FORMAT_FULL, GeometryPool* pool = 0);
+	Mesh(const MeshData& data, ID3D11Device* device, MeshVertexFormat format = VERTEX_FORMAT_FULL, GeometryPool* pool = 0);
+	Mesh(char* file, ID3D11Device* device, MeshVertexFormat format = VERTEX_FORMAT_FULL, GeometryPool* pool = 0);
 	~Mesh();
 
-	void SetBuffers(Vertex* vertices, UINT* indices, int vertNum, int indexNum, ID3D11Device* device);
+	// Load is the slow part of the file constructor and can run on
+	// any thread; SetData makes the buffers on the device's thread.
+	// threadCount = 0 parses and builds tangents on every hardware
+	// thread, and 1 keeps it all on the caller's.
+	static bool Load(const char* file, MeshData& data, int threadCount = 0);
+	static void CalculateBounds(MeshData& data);
+	static void BuildClusters(MeshData& data);
+	static void BuildBVH(MeshData& data);
+	void SetData(const MeshData& data, ID3D11Device* device);
+
+	static DXGI_FORMAT ChooseIndexFormat(int vertNum);
+	static UINT GetIndexSize(DXGI_FORMAT format);
 
-	void CalculateTangents(Vertex* vertices, int vertNum, UINT* indices, int indexNum);
+	static void CalculateTangents(Vertex* vertices, int vertNum, UINT* indices, int indexNum, int threadCount = 0);
+	static void Optimize(std::vector<Vertex>& verts, std::vector<UINT>& indices, const std::vector<MeshSubmesh>& submeshes);
 
 	ID3D11Buffer* GetVertexBuffer();
+	ID3D11Buffer* GetPositionBuffer();
 	ID3D11Buffer* GetIndexBuffer();
 	int GetIndexCount();
+	DXGI_FORMAT GetIndexFormat();
+	MeshVertexFormat GetVertexFormat();
+	UINT GetVertexStride();
+
+	void BindVertexStreams(ID3D11DeviceContext* context);
+	bool BindPositionStream(ID3D11DeviceContext* context);
+	void BindIndexBuffer(ID3D11DeviceContext* context);
+	void BindBuffers(ID3D11DeviceContext* context, UINT bufferNum, ID3D11Buffer* const* buffers, const UINT* strides);
+
+	// Where the mesh starts in its (possibly shared) buffers.  Add
+	// these to every DrawIndexed's start index and base vertex.
+	UINT GetStartIndex();
+	int GetBaseVertex();
+
+	// Decodes packed positions: offset + position * scale
+	XMFLOAT3 GetPositionOffset();
+	XMFLOAT3 GetPositionScale();
+
+	// LOD 0 is the full mesh, each one after is coarser.  All of
+	// them share the vertex buffer and index into one index buffer.
+	int GetLODCount();
+	const MeshLOD& GetLOD(int lod);
+
+	// Coarsest LOD whose error, projected by the camera, covers at
+	// most maxPixelError pixels on screen when drawn with world
+	// (a transposed world matrix, as stored by GameObject).
+	// Notes when even LOD 0 is too coarse, which only happens
+	// while a mesh is still being streamed in.
+	int SelectLOD(Camera* camera, XMFLOAT4X4 world, float maxPixelError = 1.0f);
+
+	// Whether a SelectLOD since the last call wanted more detail
+	// than the mesh has
+	bool TakeRefinementRequest();
+
+	// Model space bounds of every vert
+	const BoundingBox& GetBoundingBox();
+	const BoundingSphere& GetBoundingSphere();
 
-	ID3D11Buffer* vertexBuffer;
+	// The same bounds moved by world (transposed, as stored by GameObject)
+	void GetWorldBounds(XMFLOAT4X4 world, BoundingBox& box, BoundingSphere& sphere);
+
+	// Ranges of each LOD drawn with each material slot.  They
+	// share the mesh's buffers, so drawing several only costs
+	// a DrawIndexed each.
+	int GetSubmeshCount();
+	const MeshSubmesh& GetSubmesh(int submesh);
+
+	// LOD 0 split into clusters for culling, none spanning two
+	// submeshes.  Null when the mesh has none.
+	int GetClusterCount();
+	const MeshCluster* GetClusters();
+
+	// LOD 0's triangles for ray casts in model space.  Triangle
+	// ids count from the start of LOD 0.
+	MeshBVH* GetBVH();
+
+	ID3D11Buffer* vertexBuffer;		// Whole verts, or just the attributes when split
+	ID3D11Buffer* positionBuffer;	// Only for VERTEX_FORMAT_SPLIT
 	ID3D11Buffer* indexBuffer;
-	int numIndices;
+
+	GeometryPool* pool;				// Owns the buffers above when set
+	GeometryRange vertexRange;
+	GeometryRange indexRange;
+
+	// What's in the buffers so far, of the room they have; only
+	// streamed meshes have room to spare
+	UINT vertexCount;
+	UINT indexCount;
+	UINT vertexCapacity;
+	UINT indexCapacity;
+
+	int numIndices;					// Indices in LOD 0
+	DXGI_FORMAT indexFormat;		// R16_UINT when every index fits
+
+	MeshVertexFormat vertexFormat;
+	XMFLOAT3 positionOffset;
+	XMFLOAT3 positionScale;
+
+	std::vector<MeshLOD> lods;
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<MeshCluster> clusters;
+	MeshBVH bvh;
+
+	BoundingBox boundingBox;
+	BoundingSphere boundingSphere;
+
+	bool refinementWanted;
+
+private:
+	void Init(MeshVertexFormat format, GeometryPool* pool);
+	void ReleaseBuffers();
+	void CreateBuffers(const Vertex* vertices, const UINT* indices, int vertNum, int indexNum, UINT vertexCapacity, UINT indexCapacity, ID3D11Device* device);
+	void AppendBuffers(const Vertex* vertices, const UINT* indices, int vertNum, int indexNum, ID3D11Device* device);
+	void WriteBuffers(const void* const* streams, const void* indices, UINT firstVertex, UINT firstIndex, int vertNum, int indexNum, ID3D11Device* device);
 };
 
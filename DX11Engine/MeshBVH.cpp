@@ -0,0 +1,538 @@
+#include "MeshBVH.h"
+#include <algorithm>
+#include <cfloat>
+
+// Cost of visiting a node's children, relative to testing
+// a block of four triangles
+#define BVH_TRAVERSAL_COST	1.0f
+
+// Bounds and count of the triangles whose centroids fall in
+// one bin, or of a run of bins.  Only ever lives on the
+// stack, where XMVECTOR's alignment is taken care of.
+struct BVHBin
+{
+	XMVECTOR Min;
+	XMVECTOR Max;
+	UINT Count;
+};
+
+// A triangle's bounds while building, moved around with it
+// so each node's triangles stay together in memory
+struct BVHBuildTriangle
+{
+	XMFLOAT3 Min;
+	UINT Triangle;
+	XMFLOAT3 Max;
+	float Padding;
+};
+
+// A node still waiting to be split: its triangles, their
+// bounds and the bounds of their centroids
+struct BVHBuildItem
+{
+	UINT Node;
+	UINT First;
+	UINT Count;
+	UINT Depth;
+	XMFLOAT3 BoundsMin;
+	XMFLOAT3 BoundsMax;
+	XMFLOAT3 CentroidMin;
+	XMFLOAT3 CentroidMax;
+};
+
+// A node to come back to, and where the ray enters it
+struct BVHStackEntry
+{
+	UINT Node;
+	float Distance;
+};
+
+static void ResetBin(BVHBin& bin)
+{
+	bin.Min = XMVectorReplicate(FLT_MAX);
+	bin.Max = XMVectorReplicate(-FLT_MAX);
+	bin.Count = 0;
+}
+
+static void GrowBin(BVHBin& bin, FXMVECTOR boundsMin, FXMVECTOR boundsMax, UINT count)
+{
+	bin.Min = XMVectorMin(bin.Min, boundsMin);
+	bin.Max = XMVectorMax(bin.Max, boundsMax);
+	bin.Count += count;
+}
+
+// Half the surface area, which is all SAH needs
+static float HalfArea(const BVHBin& bin)
+{
+	if (bin.Count == 0)
+		return 0.0f;
+
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, bin.Max - bin.Min);
+	return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+// Triangles are tested four at a time, so that's what they cost
+static float BlockCost(UINT count)
+{
+	return (float)((count + 3) / 4);
+}
+
+MeshBVH::MeshBVH()
+{
+	triangleNum = 0;
+}
+
+// --------------------------------------------------------
+// Top down: each node's triangles are binned by centroid
+// along all three axes, and split at the bin boundary with
+// the lowest surface area cost.  Small nodes become leaves
+// when splitting wouldn't pay for itself.
+//
+// The bins on either side of the split already hold both
+// children's bounds, so each node only reads its triangles
+// once before partitioning them.
+// --------------------------------------------------------
+void MeshBVH::Build(const Vertex * vertices, const UINT * indices, int indexNum)
+{
+	Clear();
+
+	triangleNum = indexNum / 3;
+	if (triangleNum == 0)
+		return;
+
+	XMVECTOR half = XMVectorReplicate(0.5f);
+
+	BVHBin bounds;
+	BVHBin centroidBounds;
+	ResetBin(bounds);
+	ResetBin(centroidBounds);
+
+	std::vector<BVHBuildTriangle> triangles(triangleNum);
+	for (int i = 0; i < triangleNum; i++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i * 3 + 2]].Position);
+		XMVECTOR triangleMin = XMVectorMin(p0, XMVectorMin(p1, p2));
+		XMVECTOR triangleMax = XMVectorMax(p0, XMVectorMax(p1, p2));
+		XMVECTOR centroid = (triangleMin + triangleMax) * half;
+
+		XMStoreFloat3(&triangles[i].Min, triangleMin);
+		XMStoreFloat3(&triangles[i].Max, triangleMax);
+		triangles[i].Triangle = i;
+
+		GrowBin(bounds, triangleMin, triangleMax, 1);
+		GrowBin(centroidBounds, centroid, centroid, 1);
+	}
+
+	BVHBuildItem root = { 0, 0, (UINT)triangleNum, 0 };
+	XMStoreFloat3(&root.BoundsMin, bounds.Min);
+	XMStoreFloat3(&root.BoundsMax, bounds.Max);
+	XMStoreFloat3(&root.CentroidMin, centroidBounds.Min);
+	XMStoreFloat3(&root.CentroidMax, centroidBounds.Max);
+
+	// The root goes at 0 and 1 is left empty, so every pair of
+	// siblings starts on an even node and shares a cache line
+	nodes.reserve(triangleNum * 2 / 3 + 2);
+	nodes.resize(2);
+	blocks.reserve(triangleNum / 4 + 1);
+
+	std::vector<BVHBuildItem> work;
+	work.push_back(root);
+
+	BVHBin bins[3][BVH_BIN_COUNT];
+	BVHBin centroidBins[3][BVH_BIN_COUNT];
+	float rightCost[BVH_BIN_COUNT];
+
+	while (!work.empty())
+	{
+		BVHBuildItem item = work.back();
+		work.pop_back();
+
+		BVHNode& node = nodes[item.Node];
+		node.BoundsMin = item.BoundsMin;
+		node.BoundsMax = item.BoundsMax;
+
+		BVHBuildTriangle* first = &triangles[item.First];
+		BVHBuildTriangle* last = first + item.Count;
+
+		// Bin every triangle along every axis in one pass
+		XMVECTOR centroidMin = XMLoadFloat3(&item.CentroidMin);
+		XMVECTOR extent = XMLoadFloat3(&item.CentroidMax) - centroidMin;
+		float binScale[3] =
+		{
+			XMVectorGetX(extent) > 0.0f ? BVH_BIN_COUNT / XMVectorGetX(extent) : 0.0f,
+			XMVectorGetY(extent) > 0.0f ? BVH_BIN_COUNT / XMVectorGetY(extent) : 0.0f,
+			XMVectorGetZ(extent) > 0.0f ? BVH_BIN_COUNT / XMVectorGetZ(extent) : 0.0f
+		};
+		XMFLOAT3 scaleFloats(binScale[0], binScale[1], binScale[2]);
+		XMVECTOR scale = XMLoadFloat3(&scaleFloats);
+
+		for (int a = 0; a < 3; a++)
+		{
+			for (int b = 0; b < BVH_BIN_COUNT; b++)
+			{
+				ResetBin(bins[a][b]);
+				ResetBin(centroidBins[a][b]);
+			}
+		}
+
+		if (item.Count > 1)
+		{
+			for (BVHBuildTriangle* triangle = first; triangle != last; triangle++)
+			{
+				XMVECTOR triangleMin = XMLoadFloat3(&triangle->Min);
+				XMVECTOR triangleMax = XMLoadFloat3(&triangle->Max);
+				XMVECTOR centroid = (triangleMin + triangleMax) * half;
+
+				XMFLOAT3 position;
+				XMStoreFloat3(&position, (centroid - centroidMin) * scale);
+				const float* axisPosition = &position.x;
+
+				for (int a = 0; a < 3; a++)
+				{
+					int b = min(BVH_BIN_COUNT - 1, (int)axisPosition[a]);
+					GrowBin(bins[a][b], triangleMin, triangleMax, 1);
+					GrowBin(centroidBins[a][b], centroid, centroid, 1);
+				}
+			}
+		}
+
+		// Sweep from the right for the cost of everything past
+		// each boundary, then from the left to find the best one
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		int bestBin = 0;
+		for (int a = 0; a < 3 && item.Count > 1; a++)
+		{
+			if (binScale[a] == 0.0f)
+				continue;
+
+			BVHBin side;
+			ResetBin(side);
+			for (int b = BVH_BIN_COUNT - 1; b > 0; b--)
+			{
+				GrowBin(side, bins[a][b].Min, bins[a][b].Max, bins[a][b].Count);
+				rightCost[b] = HalfArea(side) * BlockCost(side.Count);
+			}
+
+			ResetBin(side);
+			for (int b = 1; b < BVH_BIN_COUNT; b++)
+			{
+				GrowBin(side, bins[a][b - 1].Min, bins[a][b - 1].Max, bins[a][b - 1].Count);
+				if (side.Count == 0 || side.Count == item.Count)
+					continue;
+
+				float cost = HalfArea(side) * BlockCost(side.Count) + rightCost[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = a;
+					bestBin = b;
+				}
+			}
+		}
+
+		BVHBin nodeBounds = { XMLoadFloat3(&item.BoundsMin), XMLoadFloat3(&item.BoundsMax), item.Count };
+		float area = HalfArea(nodeBounds);
+		float splitCost = BVH_TRAVERSAL_COST + (area > 0.0f ? bestCost / area : 0.0f);
+		bool tooDeep = item.Depth + 1 >= BVH_STACK_SIZE;
+		bool worthSplitting = item.Count > BVH_MAX_LEAF_TRIANGLES || splitCost < BlockCost(item.Count);
+
+		if (item.Count <= 1 || tooDeep || !worthSplitting)
+		{
+			// Copy the leaf's triangles into blocks of four
+			node.LeftOrFirst = (UINT)blocks.size();
+			node.Count = (item.Count + 3) / 4;
+
+			for (UINT i = 0; i < item.Count; i += 4)
+			{
+				BVHTriangleBlock block = {};
+				for (UINT lane = 0; lane < 4 && i + lane < item.Count; lane++)
+				{
+					UINT triangle = first[i + lane].Triangle;
+					XMFLOAT3 p0 = vertices[indices[triangle * 3 + 0]].Position;
+					XMFLOAT3 p1 = vertices[indices[triangle * 3 + 1]].Position;
+					XMFLOAT3 p2 = vertices[indices[triangle * 3 + 2]].Position;
+
+					block.V0[0][lane] = p0.x;
+					block.V0[1][lane] = p0.y;
+					block.V0[2][lane] = p0.z;
+					block.Edge1[0][lane] = p1.x - p0.x;
+					block.Edge1[1][lane] = p1.y - p0.y;
+					block.Edge1[2][lane] = p1.z - p0.z;
+					block.Edge2[0][lane] = p2.x - p0.x;
+					block.Edge2[1][lane] = p2.y - p0.y;
+					block.Edge2[2][lane] = p2.z - p0.z;
+					block.Triangle[lane] = triangle;
+				}
+				blocks.push_back(block);
+			}
+			continue;
+		}
+
+		BVHBin leftBounds;
+		BVHBin leftCentroids;
+		BVHBin rightBounds;
+		BVHBin rightCentroids;
+		ResetBin(leftBounds);
+		ResetBin(leftCentroids);
+		ResetBin(rightBounds);
+		ResetBin(rightCentroids);
+
+		if (bestAxis >= 0)
+		{
+			// Split at the best boundary, taking each side's bounds
+			// from its bins
+			float axisMin = (&item.CentroidMin.x)[bestAxis];
+			float axisScale = binScale[bestAxis];
+			std::partition(first, last, [&](const BVHBuildTriangle& triangle)
+			{
+				float centroid = ((&triangle.Min.x)[bestAxis] + (&triangle.Max.x)[bestAxis]) * 0.5f;
+				return min(BVH_BIN_COUNT - 1, (int)((centroid - axisMin) * axisScale)) < bestBin;
+			});
+
+			for (int b = 0; b < BVH_BIN_COUNT; b++)
+			{
+				const BVHBin& bin = bins[bestAxis][b];
+				const BVHBin& centroidBin = centroidBins[bestAxis][b];
+				GrowBin(b < bestBin ? leftBounds : rightBounds, bin.Min, bin.Max, bin.Count);
+				GrowBin(b < bestBin ? leftCentroids : rightCentroids, centroidBin.Min, centroidBin.Max, centroidBin.Count);
+			}
+		}
+		else
+		{
+			// Every centroid is in the same spot, so any split is
+			// as good as another
+			BVHBuildTriangle* middle = first + item.Count / 2;
+			for (BVHBuildTriangle* triangle = first; triangle != last; triangle++)
+			{
+				XMVECTOR triangleMin = XMLoadFloat3(&triangle->Min);
+				XMVECTOR triangleMax = XMLoadFloat3(&triangle->Max);
+				XMVECTOR centroid = (triangleMin + triangleMax) * half;
+				GrowBin(triangle < middle ? leftBounds : rightBounds, triangleMin, triangleMax, 1);
+				GrowBin(triangle < middle ? leftCentroids : rightCentroids, centroid, centroid, 1);
+			}
+		}
+
+		UINT children = (UINT)nodes.size();
+		node.LeftOrFirst = children;
+		node.Count = 0;
+
+		// node is no longer safe to use once this grows
+		nodes.resize(children + 2);
+
+		BVHBuildItem left = { children, item.First, leftBounds.Count, item.Depth + 1 };
+		XMStoreFloat3(&left.BoundsMin, leftBounds.Min);
+		XMStoreFloat3(&left.BoundsMax, leftBounds.Max);
+		XMStoreFloat3(&left.CentroidMin, leftCentroids.Min);
+		XMStoreFloat3(&left.CentroidMax, leftCentroids.Max);
+
+		BVHBuildItem right = { children + 1, item.First + leftBounds.Count, rightBounds.Count, item.Depth + 1 };
+		XMStoreFloat3(&right.BoundsMin, rightBounds.Min);
+		XMStoreFloat3(&right.BoundsMax, rightBounds.Max);
+		XMStoreFloat3(&right.CentroidMin, rightCentroids.Min);
+		XMStoreFloat3(&right.CentroidMax, rightCentroids.Max);
+
+		work.push_back(right);
+		work.push_back(left);
+	}
+}
+
+void MeshBVH::Clear()
+{
+	nodes.clear();
+	blocks.clear();
+	triangleNum = 0;
+}
+
+bool MeshBVH::IsEmpty()
+{
+	return nodes.empty();
+}
+
+int MeshBVH::GetNodeCount()
+{
+	// Less the empty one after the root
+	return nodes.empty() ? 0 : (int)nodes.size() - 1;
+}
+
+int MeshBVH::GetTriangleCount()
+{
+	return triangleNum;
+}
+
+bool MeshBVH::Intersect(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit & hit)
+{
+	return Traverse<false>(origin, direction, maxDistance, hit);
+}
+
+bool MeshBVH::IsOccluded(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance)
+{
+	BVHHit hit;
+	return Traverse<true>(origin, direction, maxDistance, hit);
+}
+
+// Huge instead of infinite for a zero component, so the slab
+// test never multiplies zero by infinity
+static float SafeReciprocal(float value)
+{
+	if (fabsf(value) < 1e-30f)
+		return value < 0.0f ? -1e30f : 1e30f;
+	return 1.0f / value;
+}
+
+// Where the ray enters the node's box, or FLT_MAX when it
+// misses or only gets there past maxDistance
+static float IntersectBounds(const BVHNode& node, FXMVECTOR origin, FXMVECTOR invDirection, float maxDistance)
+{
+	XMVECTOR t0 = (XMLoadFloat3(&node.BoundsMin) - origin) * invDirection;
+	XMVECTOR t1 = (XMLoadFloat3(&node.BoundsMax) - origin) * invDirection;
+	XMVECTOR tNear = XMVectorMin(t0, t1);
+	XMVECTOR tFar = XMVectorMax(t0, t1);
+
+	float enter = max(max(XMVectorGetX(tNear), XMVectorGetY(tNear)), max(XMVectorGetZ(tNear), 0.0f));
+	float exit = min(min(XMVectorGetX(tFar), XMVectorGetY(tFar)), min(XMVectorGetZ(tFar), maxDistance));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+// --------------------------------------------------------
+// Nearer child first, the other pushed with its entry
+// distance so it's skipped once something closer is hit.
+// Leaves run Moller-Trumbore on four triangles at a time.
+// --------------------------------------------------------
+template<bool AnyHit>
+bool MeshBVH::Traverse(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit & hit)
+{
+	if (nodes.empty())
+		return false;
+
+	XMFLOAT3 inverse(SafeReciprocal(direction.x), SafeReciprocal(direction.y), SafeReciprocal(direction.z));
+	XMVECTOR rayOrigin = XMLoadFloat3(&origin);
+	XMVECTOR invDirection = XMLoadFloat3(&inverse);
+
+	// The ray in every lane, for the triangle tests
+	XMVECTOR ox = XMVectorReplicate(origin.x);
+	XMVECTOR oy = XMVectorReplicate(origin.y);
+	XMVECTOR oz = XMVectorReplicate(origin.z);
+	XMVECTOR dx = XMVectorReplicate(direction.x);
+	XMVECTOR dy = XMVectorReplicate(direction.y);
+	XMVECTOR dz = XMVectorReplicate(direction.z);
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR miss = XMVectorReplicate(FLT_MAX);
+
+	float closest = maxDistance;
+	bool found = false;
+
+	if (IntersectBounds(nodes[0], rayOrigin, invDirection, closest) == FLT_MAX)
+		return false;
+
+	BVHStackEntry stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	UINT current = 0;
+
+	while (true)
+	{
+		const BVHNode& node = nodes[current];
+		if (node.Count == 0)
+		{
+			UINT leftIndex = node.LeftOrFirst;
+			float left = IntersectBounds(nodes[leftIndex], rayOrigin, invDirection, closest);
+			float right = IntersectBounds(nodes[leftIndex + 1], rayOrigin, invDirection, closest);
+
+			if (left != FLT_MAX && right != FLT_MAX)
+			{
+				BVHStackEntry farther = { left <= right ? leftIndex + 1 : leftIndex, max(left, right) };
+				stack[stackSize++] = farther;
+				current = left <= right ? leftIndex : leftIndex + 1;
+				continue;
+			}
+			if (left != FLT_MAX || right != FLT_MAX)
+			{
+				current = left != FLT_MAX ? leftIndex : leftIndex + 1;
+				continue;
+			}
+		}
+		else
+		{
+			for (UINT b = node.LeftOrFirst; b < node.LeftOrFirst + node.Count; b++)
+			{
+				const BVHTriangleBlock& block = blocks[b];
+				XMVECTOR v0x = XMLoadFloat4((const XMFLOAT4*)block.V0[0]);
+				XMVECTOR v0y = XMLoadFloat4((const XMFLOAT4*)block.V0[1]);
+				XMVECTOR v0z = XMLoadFloat4((const XMFLOAT4*)block.V0[2]);
+				XMVECTOR e1x = XMLoadFloat4((const XMFLOAT4*)block.Edge1[0]);
+				XMVECTOR e1y = XMLoadFloat4((const XMFLOAT4*)block.Edge1[1]);
+				XMVECTOR e1z = XMLoadFloat4((const XMFLOAT4*)block.Edge1[2]);
+				XMVECTOR e2x = XMLoadFloat4((const XMFLOAT4*)block.Edge2[0]);
+				XMVECTOR e2y = XMLoadFloat4((const XMFLOAT4*)block.Edge2[1]);
+				XMVECTOR e2z = XMLoadFloat4((const XMFLOAT4*)block.Edge2[2]);
+
+				// p = direction x edge2
+				XMVECTOR px = dy * e2z - dz * e2y;
+				XMVECTOR py = dz * e2x - dx * e2z;
+				XMVECTOR pz = dx * e2y - dy * e2x;
+				XMVECTOR det = e1x * px + e1y * py + e1z * pz;
+				XMVECTOR invDet = one / det;
+
+				XMVECTOR sx = ox - v0x;
+				XMVECTOR sy = oy - v0y;
+				XMVECTOR sz = oz - v0z;
+				XMVECTOR u = (sx * px + sy * py + sz * pz) * invDet;
+
+				// q = s x edge1
+				XMVECTOR qx = sy * e1z - sz * e1y;
+				XMVECTOR qy = sz * e1x - sx * e1z;
+				XMVECTOR qz = sx * e1y - sy * e1x;
+				XMVECTOR v = (dx * qx + dy * qy + dz * qz) * invDet;
+				XMVECTOR t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+				// Degenerate lanes have det 0, and NaNs fail every compare
+				XMVECTOR hits = XMVectorNotEqual(det, zero);
+				hits = XMVectorAndInt(hits, XMVectorGreaterOrEqual(u, zero));
+				hits = XMVectorAndInt(hits, XMVectorGreaterOrEqual(v, zero));
+				hits = XMVectorAndInt(hits, XMVectorLessOrEqual(u + v, one));
+				hits = XMVectorAndInt(hits, XMVectorGreaterOrEqual(t, zero));
+				hits = XMVectorAndInt(hits, XMVectorLess(t, XMVectorReplicate(closest)));
+
+				if (XMVector4EqualInt(hits, zero))
+					continue;
+
+				if (AnyHit)
+					return true;
+
+				XMFLOAT4 distances;
+				XMFLOAT4 us;
+				XMFLOAT4 vs;
+				XMStoreFloat4(&distances, XMVectorSelect(miss, t, hits));
+				XMStoreFloat4(&us, u);
+				XMStoreFloat4(&vs, v);
+
+				const float* laneDistances = &distances.x;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if (laneDistances[lane] >= closest)
+						continue;
+
+					closest = laneDistances[lane];
+					hit.Distance = closest;
+					hit.Triangle = block.Triangle[lane];
+					hit.U = (&us.x)[lane];
+					hit.V = (&vs.x)[lane];
+					found = true;
+				}
+			}
+		}
+
+		// Back up to the nearest node still in front of the hit
+		while (stackSize > 0 && stack[stackSize - 1].Distance >= closest)
+			stackSize--;
+		if (stackSize == 0)
+			break;
+		current = stack[--stackSize].Node;
+	}
+
+	return found;
+}
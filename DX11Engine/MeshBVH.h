@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+#include <d3d11.h>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Split candidates tried along each axis when building
+#define BVH_BIN_COUNT			16
+
+// Most triangles a leaf may hold, two blocks' worth
+#define BVH_MAX_LEAF_TRIANGLES	8
+
+// Deepest the traversal stack can go
+#define BVH_STACK_SIZE			64
+
+// --------------------------------------------------------
+// A node of the flattened tree, 32 bytes so a pair of
+// siblings shares a cache line.  Interior nodes have a
+// Count of 0 and children at LeftOrFirst and LeftOrFirst + 1,
+// leaves have Count triangle blocks starting at LeftOrFirst.
+// --------------------------------------------------------
+struct BVHNode
+{
+	XMFLOAT3 BoundsMin;
+	UINT LeftOrFirst;
+	XMFLOAT3 BoundsMax;
+	UINT Count;
+};
+
+// --------------------------------------------------------
+// Four triangles laid out component by component, so one
+// ray is tested against all four at once.  Lanes past the
+// end of a leaf are degenerate and never hit.
+// --------------------------------------------------------
+struct BVHTriangleBlock
+{
+	float V0[3][4];
+	float Edge1[3][4];
+	float Edge2[3][4];
+	UINT Triangle[4];
+};
+
+// --------------------------------------------------------
+// Where a ray hit: origin + direction * Distance, on
+// triangle Triangle at barycentrics U and V
+// --------------------------------------------------------
+struct BVHHit
+{
+	float Distance;
+	UINT Triangle;
+	float U;
+	float V;
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over a mesh's triangles for ray
+// casts on the CPU, built with binned SAH.  Only positions
+// are kept, copied into the leaves, so it needs nothing
+// else of the mesh once built.
+//
+// Triangles are hit from either side.  Directions don't
+// need to be normalized; Distance is in units of direction.
+// --------------------------------------------------------
+class MeshBVH
+{
+public:
+	MeshBVH();
+
+	// Triangle ids are i / 3 for the triangle at indices[i]
+	void Build(const Vertex* vertices, const UINT* indices, int indexNum);
+	void Clear();
+
+	bool IsEmpty();
+	int GetNodeCount();
+	int GetTriangleCount();
+
+	// Closest hit nearer than maxDistance
+	bool Intersect(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit& hit);
+
+	// Any hit nearer than maxDistance, for line of sight
+	bool IsOccluded(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance);
+
+private:
+	std::vector<BVHNode> nodes;
+	std::vector<BVHTriangleBlock> blocks;
+	int triangleNum;
+
+	template<bool AnyHit>
+	bool Traverse(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, BVHHit& hit);
+};
@@ -0,0 +1,260 @@
+#include "MeshCache.h"
+#include "MeshCodec.h"
+#include <vector>
+#include <fstream>
+#include <cstring>
+
+using namespace DirectX;
+
+MeshCache::MeshCache(const char * path)
+	: file(path)
+{
+	header = 0;
+
+	if (file.IsOpen() && file.GetSize() >= sizeof(MeshCacheHeader))
+		header = (const MeshCacheHeader*)file.GetData();
+}
+
+MeshCache::~MeshCache()
+{
+}
+
+bool MeshCache::IsValid(unsigned long long sourceHash)
+{
+	if (!header)
+		return false;
+
+	if (header->Magic != MESH_CACHE_MAGIC ||
+		header->Version != MESH_CACHE_VERSION ||
+		header->VertexStride != sizeof(Vertex) ||
+		header->SourceHash != sourceHash)
+		return false;
+
+	// Make sure every table is actually inside the file
+	unsigned long long lodEnd = header->LODOffset + (unsigned long long)header->LODCount * sizeof(MeshLOD);
+	unsigned long long submeshEnd = header->SubmeshOffset + (unsigned long long)header->SubmeshCount * sizeof(MeshSubmesh);
+	unsigned long long levelEnd = header->LevelOffset + (unsigned long long)header->LODCount * sizeof(MeshCacheLevel);
+
+	if (header->VertexCount == 0 ||
+		header->IndexCount == 0 ||
+		header->IndexCount % 3 != 0 ||
+		header->LODCount == 0 ||
+		header->LODCount > MESH_MAX_LODS ||
+		header->SubmeshCount == 0 ||
+		lodEnd > file.GetSize() ||
+		submeshEnd > file.GetSize() ||
+		levelEnd > file.GetSize())
+		return false;
+
+	// Every level's blobs too, and the levels have to line up
+	// with the LODs, coarsest first
+	const MeshLOD* lods = GetLODs();
+	const MeshCacheLevel* levels = GetLevels();
+	unsigned long long vertNum = 0;
+	unsigned long long indexNum = 0;
+	for (unsigned int i = 0; i < header->LODCount; i++)
+	{
+		const MeshCacheLevel& level = levels[i];
+		const MeshLOD& lod = lods[header->LODCount - 1 - i];
+
+		if ((unsigned long long)level.VertexOffset + level.VertexSize > file.GetSize() ||
+			(unsigned long long)level.IndexOffset + level.IndexSize > file.GetSize() ||
+			level.IndexCount != lod.IndexCount ||
+			lod.StartIndex != indexNum)
+			return false;
+
+		vertNum += level.VertexCount;
+		indexNum += level.IndexCount;
+	}
+
+	if (vertNum != header->VertexCount || indexNum != header->IndexCount)
+		return false;
+
+	// Every submesh too, in every LOD
+	const MeshSubmesh* submeshes = GetSubmeshes();
+	for (unsigned int i = 0; i < header->SubmeshCount; i++)
+	{
+		for (unsigned int lod = 0; lod < header->LODCount; lod++)
+		{
+			if ((unsigned long long)submeshes[i].StartIndex[lod] + submeshes[i].IndexCount[lod] > header->IndexCount)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+const MeshCacheHeader * MeshCache::GetHeader()
+{
+	return header;
+}
+
+const MeshLOD * MeshCache::GetLODs()
+{
+	return (const MeshLOD*)(file.GetData() + header->LODOffset);
+}
+
+const MeshSubmesh * MeshCache::GetSubmeshes()
+{
+	return (const MeshSubmesh*)(file.GetData() + header->SubmeshOffset);
+}
+
+const MeshCacheLevel * MeshCache::GetLevels()
+{
+	return (const MeshCacheLevel*)(file.GetData() + header->LevelOffset);
+}
+
+bool MeshCache::Decode(int levelNum, Vertex * vertices, UINT * indices)
+{
+	const MeshCacheLevel* levels = GetLevels();
+	UINT vertNum = 0;
+	UINT indexNum = 0;
+
+	for (int i = 0; i < levelNum; i++)
+	{
+		if (!DecodeLevel(i, vertNum, vertices + vertNum, indices + indexNum))
+			return false;
+
+		vertNum += levels[i].VertexCount;
+		indexNum += levels[i].IndexCount;
+	}
+
+	return true;
+}
+
+bool MeshCache::DecodeLevel(int level, UINT firstVertex, Vertex * vertices, UINT * indices)
+{
+	const MeshCacheLevel& data = GetLevels()[level];
+	const unsigned char* vertexData = (const unsigned char*)file.GetData() + data.VertexOffset;
+	const unsigned char* indexData = (const unsigned char*)file.GetData() + data.IndexOffset;
+
+	if (data.VertexCount > 0 && !MeshCodec::DecodeVertices(vertices, data.VertexCount, sizeof(Vertex), vertexData, data.VertexSize))
+		return false;
+	if (!MeshCodec::DecodeIndices(indices, data.IndexCount, indexData, data.IndexSize))
+		return false;
+
+	// A level can't be drawn without the levels after it
+	// if it uses their verts
+	UINT vertNum = firstVertex + data.VertexCount;
+	for (UINT i = 0; i < data.IndexCount; i++)
+	{
+		if (indices[i] >= vertNum)
+			return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Each level's verts are everything past the previous level's
+// up to the highest one its LOD uses, so verts a LOD doesn't
+// need only cost anything if they're in the way.  The last
+// level takes whatever is left.
+// --------------------------------------------------------
+bool MeshCache::Write(const char * path, unsigned long long sourceHash, const Vertex * vertices, int vertNum, const UINT * indices, int indexNum, const MeshLOD * lods, int lodNum, const MeshSubmesh * submeshes, int submeshNum, const BoundingBox & box, const BoundingSphere & sphere)
+{
+	MeshCacheHeader h = {};
+	h.Magic = MESH_CACHE_MAGIC;
+	h.Version = MESH_CACHE_VERSION;
+	h.SourceHash = sourceHash;
+	h.VertexStride = sizeof(Vertex);
+	h.VertexCount = vertNum;
+	h.IndexCount = indexNum;
+	h.LODCount = lodNum;
+	h.SubmeshCount = submeshNum;
+
+	h.LODOffset = sizeof(MeshCacheHeader);
+	h.SubmeshOffset = h.LODOffset + sizeof(MeshLOD) * lodNum;
+	h.LevelOffset = h.SubmeshOffset + sizeof(MeshSubmesh) * submeshNum;
+
+	std::vector<MeshCacheLevel> levels(lodNum);
+	std::vector<unsigned char> encoded;
+	std::vector<unsigned char> blob;
+	UINT dataOffset = h.LevelOffset + sizeof(MeshCacheLevel) * lodNum;
+	UINT vertexEnd = 0;
+	UINT indexEnd = 0;
+
+	for (int i = 0; i < lodNum; i++)
+	{
+		const MeshLOD& lod = lods[lodNum - 1 - i];
+		if (lod.StartIndex != indexEnd)
+			return false;
+
+		UINT firstVertex = vertexEnd;
+		for (UINT j = lod.StartIndex; j < lod.StartIndex + lod.IndexCount; j++)
+			vertexEnd = max(vertexEnd, indices[j] + 1);
+		if (i == lodNum - 1)
+			vertexEnd = vertNum;
+
+		MeshCacheLevel& level = levels[i];
+		level.VertexCount = vertexEnd - firstVertex;
+		level.IndexCount = lod.IndexCount;
+
+		encoded.clear();
+		if (level.VertexCount > 0)
+			MeshCodec::EncodeVertices(vertices + firstVertex, level.VertexCount, sizeof(Vertex), encoded);
+		level.VertexOffset = dataOffset + (UINT)blob.size();
+		level.VertexSize = (UINT)encoded.size();
+		blob.insert(blob.end(), encoded.begin(), encoded.end());
+
+		encoded.clear();
+		MeshCodec::EncodeIndices(indices + lod.StartIndex, lod.IndexCount, encoded);
+		level.IndexOffset = dataOffset + (UINT)blob.size();
+		level.IndexSize = (UINT)encoded.size();
+		blob.insert(blob.end(), encoded.begin(), encoded.end());
+
+		h.VertexSize += level.VertexSize;
+		h.IndexSize += level.IndexSize;
+		indexEnd += lod.IndexCount;
+	}
+
+	if (indexEnd != (UINT)indexNum)
+		return false;
+
+	h.Box = box;
+	h.Sphere = sphere;
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	// Write a blank header first and the real one last, so a
+	// half-written file never looks like a valid cache
+	MeshCacheHeader blank = {};
+	out.write((const char*)&blank, sizeof(MeshCacheHeader));
+	out.write((const char*)lods, sizeof(MeshLOD) * lodNum);
+	out.write((const char*)submeshes, sizeof(MeshSubmesh) * submeshNum);
+	out.write((const char*)&levels[0], sizeof(MeshCacheLevel) * lodNum);
+	out.write((const char*)&blob[0], blob.size());
+	out.seekp(0);
+	out.write((const char*)&h, sizeof(MeshCacheHeader));
+
+	return out.good();
+}
+
+// --------------------------------------------------------
+// 64-bit hash of the source file, eight bytes at a time.
+// Only used to notice when a source asset has changed, so
+// it just needs to be fast and well mixed.
+// --------------------------------------------------------
+unsigned long long MeshCache::Hash(const char * data, size_t size)
+{
+	const unsigned long long prime = 0x9E3779B97F4A7C15ull;
+	unsigned long long h = size * prime;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, data + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+
+	unsigned long long tail = 0;
+	memcpy(&tail, data + i, size - i);
+	h = (h ^ tail) * prime;
+	h ^= h >> 32;
+
+	return h;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "MeshSimplifier.h"
+#include <d3d11.h>
+#include <DirectXCollision.h>
+
+// "MBIN" in little endian
+#define MESH_CACHE_MAGIC	0x4E49424D
+
+// Bump whenever the header, the Vertex layout or anything
+// baked into the cached data (tangents etc.) changes
+#define MESH_CACHE_VERSION	8
+
+// --------------------------------------------------------
+// On-disk layout of a .meshbin file:
+//  - this header
+//  - LODCount MeshLOD ranges into the indices
+//  - SubmeshCount MeshSubmesh ranges into the indices
+//  - LODCount MeshCacheLevels
+//  - each level's verts and then its indices, coarsest level
+//    first, every one compressed with MeshCodec on its own
+//
+// The indices are stored coarsest LOD first, and the verts
+// in the order the LODs first use them, so the start of the
+// data is a complete coarse mesh.  Verts have their tangents
+// already computed.
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned long long SourceHash;	// Hash of the source file this was built from
+	unsigned int VertexStride;		// sizeof(Vertex) when written
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int LODOffset;			// Byte offsets from the start of the file
+	unsigned int LevelOffset;
+	unsigned int VertexSize;		// Compressed sizes in bytes, over every level
+	unsigned int IndexSize;
+	DirectX::BoundingBox Box;		// Bounds of every vert
+	DirectX::BoundingSphere Sphere;
+	unsigned int LODCount;
+	unsigned int SubmeshOffset;
+	unsigned int SubmeshCount;
+};
+
+// --------------------------------------------------------
+// One step of loading the mesh coarsest first.  Level i adds
+// the verts that LOD LODCount - 1 - i uses and no coarser
+// LOD does, then that LOD's indices.
+// --------------------------------------------------------
+struct MeshCacheLevel
+{
+	unsigned int VertexCount;
+	unsigned int VertexOffset;		// Byte offsets from the start of the file
+	unsigned int VertexSize;		// Compressed sizes in bytes
+	unsigned int IndexCount;
+	unsigned int IndexOffset;
+	unsigned int IndexSize;
+};
+
+// --------------------------------------------------------
+// Binary mesh cache, memory mapped so the vertex and index
+// data can be decoded straight into a MeshData.
+//
+// A cache is only used when its SourceHash matches the hash
+// of the current source file, so editing the OBJ rebuilds it.
+// --------------------------------------------------------
+class MeshCache
+{
+public:
+	MeshCache(const char* path);
+	~MeshCache();
+
+	bool IsValid(unsigned long long sourceHash);
+
+	const MeshCacheHeader* GetHeader();
+	const MeshLOD* GetLODs();
+	const MeshSubmesh* GetSubmeshes();
+	const MeshCacheLevel* GetLevels();
+
+	// Decodes the first levelNum levels into the verts and
+	// indices they add up to, failing if any index points past
+	// the verts decoded so far
+	bool Decode(int levelNum, Vertex* vertices, UINT* indices);
+
+	// Decodes one level on its own, for when the levels before
+	// it are already somewhere else.  firstVertex is how many
+	// verts those levels have, which the indices count from.
+	bool DecodeLevel(int level, UINT firstVertex, Vertex* vertices, UINT* indices);
+
+	// The indices must be laid out coarsest LOD first, as
+	// MeshStream::Reorder leaves them
+	static bool Write(const char* path, unsigned long long sourceHash, const Vertex* vertices, int vertNum, const UINT* indices, int indexNum, const MeshLOD* lods, int lodNum, const MeshSubmesh* submeshes, int submeshNum, const DirectX::BoundingBox& box, const DirectX::BoundingSphere& sphere);
+	static unsigned long long Hash(const char* data, size_t size);
+
+private:
+	MappedFile file;
+	const MeshCacheHeader* header;
+};
@@ -0,0 +1,251 @@
+#include "MeshClusterizer.h"
+#include <cmath>
+
+// How far apart axis scales can be for the backface test to still hold
+#define CLUSTER_UNIFORM_SCALE_TOLERANCE	0.01f
+
+// Fills in a cluster's bounding sphere and normal cone from its
+// unique verts and its triangles
+static void CalculateClusterBounds(const Vertex* vertices, const UINT* indices, const std::vector<UINT>& clusterVerts, MeshCluster& cluster)
+{
+	MeshClusterizer::CalculateBoundingSphere(vertices, &clusterVerts[0], (int)clusterVerts.size(), cluster.Center, cluster.Radius);
+
+	// Average the triangle normals for the cone's axis...
+	std::vector<XMVECTOR> normals;
+	normals.reserve(cluster.IndexCount / 3);
+	XMVECTOR axis = XMVectorZero();
+	for (UINT i = cluster.StartIndex; i < cluster.StartIndex + cluster.IndexCount; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+		XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+		float length = XMVectorGetX(XMVector3Length(n));
+		if (length == 0.0f)
+			continue;
+
+		normals.push_back(n / length);
+		axis = axis + n / length;
+	}
+
+	cluster.ConeAxis = XMFLOAT3(0, 0, 0);
+	cluster.ConeCutoff = 1.0f;
+
+	float axisLength = XMVectorGetX(XMVector3Length(axis));
+	if (normals.empty() || axisLength < 1e-6f)
+		return;
+	axis = axis / axisLength;
+
+	// ...and the widest normal for its angle
+	float minDot = 1.0f;
+	for (size_t i = 0; i < normals.size(); i++)
+		minDot = min(minDot, XMVectorGetX(XMVector3Dot(axis, normals[i])));
+
+	XMStoreFloat3(&cluster.ConeAxis, axis);
+
+	// Normals more than 90 degrees apart face every direction somewhere
+	if (minDot <= 0.0f)
+		return;
+
+	cluster.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+// --------------------------------------------------------
+// Greedy scan: triangles are added in index order until the
+// next one would push the cluster over either limit
+// --------------------------------------------------------
+void MeshClusterizer::BuildClusters(const Vertex * vertices, int vertNum, const UINT * indices, UINT startIndex, int indexNum, std::vector<MeshCluster>& clusters)
+{
+	clusters.clear();
+
+	// Which cluster each vert was last added to
+	std::vector<UINT> owner(vertNum, UINT_MAX);
+	std::vector<UINT> clusterVerts;
+	clusterVerts.reserve(CLUSTER_MAX_VERTICES);
+
+	MeshCluster cluster = {};
+	cluster.StartIndex = startIndex;
+
+	for (UINT i = startIndex; i < startIndex + indexNum; i += 3)
+	{
+		UINT id = (UINT)clusters.size();
+
+		int newVerts = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (owner[indices[i + c]] != id)
+				newVerts++;
+		}
+
+		// A repeated vert in a degenerate triangle is counted twice
+		// here, which only ever ends a cluster a little early
+		if (clusterVerts.size() + newVerts > CLUSTER_MAX_VERTICES ||
+			cluster.IndexCount / 3 + 1 > CLUSTER_MAX_TRIANGLES)
+		{
+			CalculateClusterBounds(vertices, indices, clusterVerts, cluster);
+			clusters.push_back(cluster);
+
+			id++;
+			clusterVerts.clear();
+			cluster.StartIndex = i;
+			cluster.IndexCount = 0;
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			UINT v = indices[i + c];
+			if (owner[v] != id)
+			{
+				owner[v] = id;
+				clusterVerts.push_back(v);
+			}
+		}
+		cluster.IndexCount += 3;
+	}
+
+	if (cluster.IndexCount > 0)
+	{
+		CalculateClusterBounds(vertices, indices, clusterVerts, cluster);
+		clusters.push_back(cluster);
+	}
+}
+
+// --------------------------------------------------------
+// Starts from the two verts furthest apart along one pass,
+// then grows the sphere just enough to take in each vert
+// left outside.  Within a few percent of the smallest sphere.
+// --------------------------------------------------------
+void MeshClusterizer::CalculateBoundingSphere(const Vertex * vertices, const UINT * subset, int num, XMFLOAT3 & center, float & radius)
+{
+	center = XMFLOAT3(0, 0, 0);
+	radius = 0.0f;
+	if (num <= 0)
+		return;
+
+	auto point = [vertices, subset](int i)
+	{
+		return XMLoadFloat3(&vertices[subset ? subset[i] : i].Position);
+	};
+
+	// Furthest vert from the first, then the furthest from that
+	XMVECTOR first = point(0);
+	XMVECTOR a = first;
+	float best = -1.0f;
+	for (int i = 0; i < num; i++)
+	{
+		float d = XMVectorGetX(XMVector3LengthSq(point(i) - first));
+		if (d > best) { best = d; a = point(i); }
+	}
+
+	XMVECTOR b = a;
+	best = -1.0f;
+	for (int i = 0; i < num; i++)
+	{
+		float d = XMVectorGetX(XMVector3LengthSq(point(i) - a));
+		if (d > best) { best = d; b = point(i); }
+	}
+
+	XMVECTOR c = (a + b) * 0.5f;
+	float r = XMVectorGetX(XMVector3Length(b - a)) * 0.5f;
+
+	for (int i = 0; i < num; i++)
+	{
+		XMVECTOR p = point(i);
+		float d = XMVectorGetX(XMVector3Length(p - c));
+		if (d > r)
+		{
+			// Move the center toward p by half the overshoot
+			float grown = (r + d) * 0.5f;
+			c = c + (p - c) * ((grown - r) / d);
+			r = grown;
+		}
+	}
+
+	XMStoreFloat3(&center, c);
+	radius = r;
+}
+
+int MeshClusterizer::CullClusters(const MeshCluster * clusters, int clusterNum, XMFLOAT4X4 world, Camera * camera, UINT * visible, ClusterCullStats * stats)
+{
+	XMMATRIX W = XMMatrixTranspose(XMLoadFloat4x4(&world));
+
+	// The stored matrices are transposed, so the rows of proj * view
+	// are the columns of the usual view * projection, which give
+	// the frustum planes directly (Gribb & Hartmann)
+	XMMATRIX clip = XMMatrixMultiply(XMLoadFloat4x4(&camera->projMat), XMLoadFloat4x4(&camera->viewMat));
+	XMVECTOR planes[6] =
+	{
+		clip.r[3] + clip.r[0],		// Left
+		clip.r[3] - clip.r[0],		// Right
+		clip.r[3] + clip.r[1],		// Bottom
+		clip.r[3] - clip.r[1],		// Top
+		clip.r[2],					// Near (D3D depth starts at 0)
+		clip.r[3] - clip.r[2],		// Far
+	};
+	for (int p = 0; p < 6; p++)
+		planes[p] = XMPlaneNormalize(planes[p]);
+
+	float scaleX = XMVectorGetX(XMVector3Length(W.r[0]));
+	float scaleY = XMVectorGetX(XMVector3Length(W.r[1]));
+	float scaleZ = XMVectorGetX(XMVector3Length(W.r[2]));
+	float scale = max(scaleX, max(scaleY, scaleZ));
+	bool uniform = scale - min(scaleX, min(scaleY, scaleZ)) <= scale * CLUSTER_UNIFORM_SCALE_TOLERANCE;
+
+	XMVECTOR eye = XMLoadFloat3(&camera->position);
+
+	int visibleNum = 0;
+	for (int i = 0; i < clusterNum; i++)
+	{
+		const MeshCluster& cluster = clusters[i];
+		UINT triangles = cluster.IndexCount / 3;
+
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&cluster.Center), W);
+		float radius = cluster.Radius * scale;
+
+		if (stats)
+		{
+			stats->Clusters++;
+			stats->Triangles += triangles;
+		}
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = XMVectorGetX(XMPlaneDotCoord(planes[p], center)) < -radius;
+
+		if (outside)
+		{
+			if (stats)
+			{
+				stats->FrustumClusters++;
+				stats->FrustumTriangles += triangles;
+			}
+			continue;
+		}
+
+		// Backfacing when every point of the sphere sees the whole
+		// cone from behind:
+		//    dot(center - eye, axis) >= cutoff * |center - eye| + radius
+		if (uniform && cluster.ConeCutoff < 1.0f)
+		{
+			XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&cluster.ConeAxis), W));
+			XMVECTOR toCluster = center - eye;
+			float along = XMVectorGetX(XMVector3Dot(toCluster, axis));
+			float distance = XMVectorGetX(XMVector3Length(toCluster));
+
+			if (along >= cluster.ConeCutoff * distance + radius)
+			{
+				if (stats)
+				{
+					stats->BackfaceClusters++;
+					stats->BackfaceTriangles += triangles;
+				}
+				continue;
+			}
+		}
+
+		visible[visibleNum++] = i;
+	}
+
+	return visibleNum;
+}
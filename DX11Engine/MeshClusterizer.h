@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Vertex.h"
+#include "Camera.h"
+#include <vector>
+#include <d3d11.h>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Cluster size limits, the usual meshlet sizes
+#define CLUSTER_MAX_VERTICES	64
+#define CLUSTER_MAX_TRIANGLES	124
+
+// --------------------------------------------------------
+// A run of triangles in a mesh's index buffer, with bounds
+// for culling it as a whole.  Every triangle's normal lies
+// within the cone around ConeAxis; ConeCutoff is the sine of
+// the cone's half angle, or 1 when it can't be backface culled.
+// --------------------------------------------------------
+struct MeshCluster
+{
+	UINT StartIndex;
+	UINT IndexCount;
+	XMFLOAT3 Center;
+	float Radius;
+	XMFLOAT3 ConeAxis;
+	float ConeCutoff;
+};
+
+// --------------------------------------------------------
+// What CullClusters rejected, added up over every call
+// --------------------------------------------------------
+struct ClusterCullStats
+{
+	UINT Clusters;
+	UINT Triangles;
+	UINT FrustumClusters;		// Outside the view frustum
+	UINT FrustumTriangles;
+	UINT BackfaceClusters;		// Entirely facing away from the camera
+	UINT BackfaceTriangles;
+};
+
+// --------------------------------------------------------
+// Splits a mesh into clusters of at most CLUSTER_MAX_VERTICES
+// verts and CLUSTER_MAX_TRIANGLES triangles, and culls them
+// on the CPU so only the visible ranges get drawn.
+//
+// Clusters are consecutive runs of the existing index order,
+// so the cache and overdraw ordering is kept as is.
+// --------------------------------------------------------
+class MeshClusterizer
+{
+public:
+	static void BuildClusters(const Vertex* vertices, int vertNum, const UINT* indices, UINT startIndex, int indexNum, std::vector<MeshCluster>& clusters);
+
+	// Ritter's bounding sphere of the given verts, or of all of
+	// them when subset is null
+	static void CalculateBoundingSphere(const Vertex* vertices, const UINT* subset, int num, XMFLOAT3& center, float& radius);
+
+	// Writes the index of each cluster that may be visible when
+	// drawn with world (transposed, as stored by GameObject) to
+	// visible, in order, and returns how many there are.  The
+	// backface test is skipped when world doesn't scale uniformly.
+	static int CullClusters(const MeshCluster* clusters, int clusterNum, XMFLOAT4X4 world, Camera* camera, UINT* visible, ClusterCullStats* stats);
+};
@@ -0,0 +1,367 @@
+#include "MeshCodec.h"
+#include <intrin.h>
+#include <emmintrin.h>
+#include <cstring>
+
+// Group modes, two bits each in a plane's header
+#define GROUP_ZERO		0
+#define GROUP_2BIT		1
+#define GROUP_4BIT		2
+#define GROUP_8BIT		3
+
+// How a word is predicted from the previous vertex's, one
+// byte per word per block.  Rotating a float left by one
+// moves its sign bit to the bottom, so the top byte is just
+// exponent and stays small across a sign change.
+#define PREDICT_DELTA			0
+#define PREDICT_ROTATED_DELTA	1
+#define PREDICT_ROTATED_XOR		2
+#define PREDICT_COUNT			3
+
+// Packed bytes for each mode, before escapes
+static const int GroupSizes[4] = { 0, 4, 8, 16 };
+
+// Small differences either side of zero become small unsigned numbers
+static inline UINT Zigzag(UINT value)
+{
+	return (value << 1) ^ (UINT)((int)value >> 31);
+}
+
+static inline UINT Rotate(UINT value)
+{
+	return (value << 1) | (value >> 31);
+}
+
+// --------------------------------------------------------
+// Each (block, word) is:
+//  - a predictor byte
+//  - four planes' headers, 2 bits per group of 16 verts
+//  - every group's data, plane 0 to 3
+// The last group of a block is padded with zero differences.
+// --------------------------------------------------------
+void MeshCodec::EncodeVertices(const void * vertices, int vertNum, int stride, std::vector<unsigned char>& out)
+{
+	const unsigned char* source = (const unsigned char*)vertices;
+	int wordNum = stride / 4;
+
+	UINT last[MESH_CODEC_MAX_STRIDE / 4] = {};
+	UINT deltas[MESH_CODEC_BLOCK_VERTICES];
+	std::vector<unsigned char> best;
+	std::vector<unsigned char> trial;
+
+	for (int start = 0; start < vertNum; start += MESH_CODEC_BLOCK_VERTICES)
+	{
+		int count = min(MESH_CODEC_BLOCK_VERTICES, vertNum - start);
+		int groupNum = (count + 15) / 16;
+		int headerSize = (groupNum + 3) / 4;
+
+		for (int w = 0; w < wordNum; w++)
+		{
+			// Try every predictor and keep the smallest
+			for (int predict = 0; predict < PREDICT_COUNT; predict++)
+			{
+				UINT previous = predict == PREDICT_DELTA ? last[w] : Rotate(last[w]);
+
+				memset(deltas, 0, sizeof(deltas));
+				for (int i = 0; i < count; i++)
+				{
+					UINT value;
+					memcpy(&value, source + (size_t)(start + i) * stride + w * 4, sizeof(UINT));
+					if (predict != PREDICT_DELTA)
+						value = Rotate(value);
+
+					deltas[i] = predict == PREDICT_ROTATED_XOR ? value ^ previous : Zigzag(value - previous);
+					previous = value;
+				}
+
+				trial.assign(1 + 4 * headerSize, 0);
+				trial[0] = (unsigned char)predict;
+
+				for (int g = 0; g < groupNum; g++)
+				{
+					for (int plane = 0; plane < 4; plane++)
+					{
+						unsigned char bytes[16];
+						for (int i = 0; i < 16; i++)
+							bytes[i] = (unsigned char)(deltas[g * 16 + i] >> (plane * 8));
+
+						int mode = EncodeGroup(bytes, trial);
+						trial[1 + plane * headerSize + g / 4] |= (unsigned char)(mode << (g % 4 * 2));
+					}
+				}
+
+				if (predict == 0 || trial.size() < best.size())
+					best.swap(trial);
+			}
+
+			out.insert(out.end(), best.begin(), best.end());
+
+			UINT value;
+			memcpy(&value, source + (size_t)(start + count - 1) * stride + w * 4, sizeof(UINT));
+			last[w] = value;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Packs 16 bytes in whichever mode is smallest.  2 and 4-bit
+// groups keep value i in byte i % 4 at bit 2 * (i / 4), or in
+// byte i % 8 at bit 4 * (i / 8), which the decoder unpacks with
+// whole-register shifts.  The all-ones value is an escape: the
+// real byte follows the packed ones, so an outlier or two
+// doesn't push the whole group up to 8 bits.
+// --------------------------------------------------------
+int MeshCodec::EncodeGroup(const unsigned char * bytes, std::vector<unsigned char>& out)
+{
+	int largest = 0;
+	int escapes2 = 0;
+	int escapes4 = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		largest = max(largest, (int)bytes[i]);
+		escapes2 += bytes[i] >= 3;
+		escapes4 += bytes[i] >= 15;
+	}
+
+	int mode = GROUP_8BIT;
+	int size = 16;
+	if (largest == 0)
+	{
+		mode = GROUP_ZERO;
+		size = 0;
+	}
+	if (4 + escapes2 < size)
+	{
+		mode = GROUP_2BIT;
+		size = 4 + escapes2;
+	}
+	if (8 + escapes4 < size)
+	{
+		mode = GROUP_4BIT;
+		size = 8 + escapes4;
+	}
+
+	unsigned char packed[16] = {};
+	unsigned char escaped[16];
+	int escapeNum = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		if (mode == GROUP_2BIT)
+		{
+			int value = min((int)bytes[i], 3);
+			packed[i % 4] |= value << (i / 4 * 2);
+			if (value == 3)
+				escaped[escapeNum++] = bytes[i];
+		}
+		else if (mode == GROUP_4BIT)
+		{
+			int value = min((int)bytes[i], 15);
+			packed[i % 8] |= value << (i / 8 * 4);
+			if (value == 15)
+				escaped[escapeNum++] = bytes[i];
+		}
+		else
+		{
+			packed[i] = bytes[i];
+		}
+	}
+
+	out.insert(out.end(), packed, packed + GroupSizes[mode]);
+	out.insert(out.end(), escaped, escaped + escapeNum);
+	return mode;
+}
+
+// --------------------------------------------------------
+// Sixteen bytes of one plane, back to one byte per lane.
+// Returns false if the group runs past end.
+// --------------------------------------------------------
+static inline bool DecodeGroup(int mode, const unsigned char*& data, const unsigned char* end, __m128i& result)
+{
+	if (end - data < GroupSizes[mode])
+		return false;
+
+	__m128i escape;
+	switch (mode)
+	{
+	case GROUP_ZERO:
+		result = _mm_setzero_si128();
+		return true;
+
+	case GROUP_8BIT:
+		result = _mm_loadu_si128((const __m128i*)data);
+		data += 16;
+		return true;
+
+	case GROUP_2BIT:
+	{
+		int word;
+		memcpy(&word, data, sizeof(int));
+		__m128i packed = _mm_cvtsi32_si128(word);
+		__m128i low = _mm_unpacklo_epi32(packed, _mm_srli_epi32(packed, 2));
+		__m128i high = _mm_unpacklo_epi32(_mm_srli_epi32(packed, 4), _mm_srli_epi32(packed, 6));
+		escape = _mm_set1_epi8(0x03);
+		result = _mm_and_si128(_mm_unpacklo_epi64(low, high), escape);
+		break;
+	}
+
+	default:
+	{
+		__m128i packed = _mm_loadl_epi64((const __m128i*)data);
+		escape = _mm_set1_epi8(0x0F);
+		result = _mm_and_si128(_mm_unpacklo_epi64(packed, _mm_srli_epi16(packed, 4)), escape);
+		break;
+	}
+	}
+
+	data += GroupSizes[mode];
+
+	// Rare enough that patching them one by one is fine
+	int escapes = _mm_movemask_epi8(_mm_cmpeq_epi8(result, escape));
+	if (escapes)
+	{
+		unsigned char bytes[16];
+		_mm_storeu_si128((__m128i*)bytes, result);
+
+		while (escapes)
+		{
+			if (data == end)
+				return false;
+
+			unsigned long bit;
+			_BitScanForward(&bit, (unsigned long)escapes);
+			bytes[bit] = *data++;
+			escapes &= escapes - 1;
+		}
+
+		result = _mm_loadu_si128((const __m128i*)bytes);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Undoes a predictor across four lanes, carrying on from
+// the last lane of previous
+// --------------------------------------------------------
+static inline __m128i PrefixSum(__m128i value, __m128i previous)
+{
+	// Unzigzag first
+	__m128i sign = _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(value, _mm_set1_epi32(1)));
+	value = _mm_xor_si128(_mm_srli_epi32(value, 1), sign);
+
+	value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+	value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+	return _mm_add_epi32(value, _mm_shuffle_epi32(previous, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+static inline __m128i PrefixXor(__m128i value, __m128i previous)
+{
+	value = _mm_xor_si128(value, _mm_slli_si128(value, 4));
+	value = _mm_xor_si128(value, _mm_slli_si128(value, 8));
+	return _mm_xor_si128(value, _mm_shuffle_epi32(previous, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+static inline __m128i Unpredict(int predict, __m128i value, __m128i previous)
+{
+	return predict == PREDICT_ROTATED_XOR ? PrefixXor(value, previous) : PrefixSum(value, previous);
+}
+
+// --------------------------------------------------------
+// Returns false, with vertices partly written, if data
+// isn't exactly vertNum verts of stride bytes
+// --------------------------------------------------------
+bool MeshCodec::DecodeVertices(void * vertices, int vertNum, int stride, const unsigned char * data, size_t size)
+{
+	if (stride <= 0 || stride % 4 != 0 || stride > MESH_CODEC_MAX_STRIDE)
+		return false;
+
+	unsigned char* target = (unsigned char*)vertices;
+	const unsigned char* end = data + size;
+	int wordNum = stride / 4;
+
+	for (int start = 0; start < vertNum; start += MESH_CODEC_BLOCK_VERTICES)
+	{
+		int count = min(MESH_CODEC_BLOCK_VERTICES, vertNum - start);
+		int groupNum = (count + 15) / 16;
+		int headerSize = (groupNum + 3) / 4;
+
+		for (int w = 0; w < wordNum; w++)
+		{
+			if (end - data < 1 + 4 * headerSize)
+				return false;
+
+			int predict = *data++;
+			if (predict >= PREDICT_COUNT)
+				return false;
+
+			const unsigned char* headers = data;
+			data += 4 * headerSize;
+
+			// The vertex before the block, already written out
+			UINT last = 0;
+			if (start > 0)
+				memcpy(&last, target + (size_t)(start - 1) * stride + w * 4, sizeof(UINT));
+			if (predict != PREDICT_DELTA)
+				last = Rotate(last);
+			__m128i previous = _mm_set1_epi32((int)last);
+
+			for (int g = 0; g < groupNum; g++)
+			{
+				int shift = g % 4 * 2;
+				__m128i b0, b1, b2, b3;
+				if (!DecodeGroup((headers[g / 4] >> shift) & 3, data, end, b0) ||
+					!DecodeGroup((headers[headerSize + g / 4] >> shift) & 3, data, end, b1) ||
+					!DecodeGroup((headers[2 * headerSize + g / 4] >> shift) & 3, data, end, b2) ||
+					!DecodeGroup((headers[3 * headerSize + g / 4] >> shift) & 3, data, end, b3))
+					return false;
+
+				// Bytes back into words, four verts per register
+				__m128i low01 = _mm_unpacklo_epi8(b0, b1);
+				__m128i high01 = _mm_unpackhi_epi8(b0, b1);
+				__m128i low23 = _mm_unpacklo_epi8(b2, b3);
+				__m128i high23 = _mm_unpackhi_epi8(b2, b3);
+
+				__m128i words[4];
+				words[0] = previous = Unpredict(predict, _mm_unpacklo_epi16(low01, low23), previous);
+				words[1] = previous = Unpredict(predict, _mm_unpackhi_epi16(low01, low23), previous);
+				words[2] = previous = Unpredict(predict, _mm_unpacklo_epi16(high01, high23), previous);
+				words[3] = previous = Unpredict(predict, _mm_unpackhi_epi16(high01, high23), previous);
+
+				// Rotate back
+				if (predict != PREDICT_DELTA)
+				{
+					for (int i = 0; i < 4; i++)
+						words[i] = _mm_or_si128(_mm_srli_epi32(words[i], 1), _mm_slli_epi32(words[i], 31));
+				}
+
+				int first = start + g * 16;
+				int groupCount = min(16, vertNum - first);
+				const UINT* values = (const UINT*)words;
+				unsigned char* output = target + (size_t)first * stride + w * 4;
+				for (int i = 0; i < groupCount; i++)
+					memcpy(output + (size_t)i * stride, values + i, sizeof(UINT));
+			}
+		}
+	}
+
+	return data == end;
+}
+
+// --------------------------------------------------------
+// A triangle is coded like a 12-byte vertex, so each corner
+// is a difference from the same corner of the triangle
+// before, which after cache ordering is usually small
+// --------------------------------------------------------
+void MeshCodec::EncodeIndices(const UINT * indices, int indexNum, std::vector<unsigned char>& out)
+{
+	EncodeVertices(indices, indexNum / 3, 3 * sizeof(UINT), out);
+}
+
+bool MeshCodec::DecodeIndices(UINT * indices, int indexNum, const unsigned char * data, size_t size)
+{
+	if (indexNum % 3 != 0)
+		return false;
+
+	return DecodeVertices(indices, indexNum / 3, 3 * sizeof(UINT), data, size);
+}
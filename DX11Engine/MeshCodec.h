@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <d3d11.h>
+
+// Verts encoded together; the decoder's working set
+#define MESH_CODEC_BLOCK_VERTICES	256
+
+// Largest vertex the codec takes, in bytes
+#define MESH_CODEC_MAX_STRIDE		256
+
+// --------------------------------------------------------
+// Lossless compression for vertex and index buffers,
+// built to be decoded quickly with SSE2.
+//
+// A vertex is read as 32-bit words.  Each word is predicted
+// from the same word of the vertex before it, by difference
+// or by XOR, whichever the block likes best, so values that
+// barely change become small.  The results are split into
+// four byte planes, and every 16 bytes of a plane are packed
+// at 0, 2, 4 or 8 bits each with a 2-bit header per group;
+// a byte too big for its group is escaped and stored whole.
+// High bytes of positions, normals and UVs, and most of every
+// index byte, end up tiny or gone.
+//
+// Decoding unpacks the planes, puts the words back together,
+// and undoes the prediction with a running sum or XOR,
+// sixteen verts at a time, a block of verts at a time.
+// --------------------------------------------------------
+class MeshCodec
+{
+public:
+	// stride must be a multiple of 4, up to MESH_CODEC_MAX_STRIDE
+	static void EncodeVertices(const void* vertices, int vertNum, int stride, std::vector<unsigned char>& out);
+	static bool DecodeVertices(void* vertices, int vertNum, int stride, const unsigned char* data, size_t size);
+
+	// Triangle list indices, each triangle coded against the one before
+	static void EncodeIndices(const UINT* indices, int indexNum, std::vector<unsigned char>& out);
+	static bool DecodeIndices(UINT* indices, int indexNum, const unsigned char* data, size_t size);
+
+private:
+	static int EncodeGroup(const unsigned char* bytes, std::vector<unsigned char>& out);
+};
@@ -0,0 +1,577 @@
+#include "MeshOptimizer.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace DirectX;
+
+// Tuning values from Forsyth's original write-up
+#define FORSYTH_CACHE_DECAY_POWER	1.5f
+#define FORSYTH_LAST_TRI_SCORE		0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE	2.0f
+#define FORSYTH_VALENCE_BOOST_POWER	0.5f
+
+// Valences above this all score the same
+#define FORSYTH_MAX_VALENCE			32
+
+// --------------------------------------------------------
+// Precomputed vertex scores by cache position and by number
+// of triangles still waiting to use the vertex
+// --------------------------------------------------------
+struct ForsythScores
+{
+	float Cache[VERTEX_CACHE_SIZE];
+	float Valence[FORSYTH_MAX_VALENCE + 1];
+
+	ForsythScores()
+	{
+		for (int i = 0; i < VERTEX_CACHE_SIZE; i++)
+		{
+			// The last triangle's verts get a fixed score so the
+			// next triangle doesn't just reuse the same edge
+			if (i < 3)
+			{
+				Cache[i] = FORSYTH_LAST_TRI_SCORE;
+			}
+			else
+			{
+				float scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+				Cache[i] = powf(1.0f - (i - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+
+		// Boost verts with few triangles left, so lone triangles
+		// get picked up instead of being left until the end
+		Valence[0] = 0;
+		for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+			Valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	float Score(int cachePosition, int remainingTris)
+	{
+		if (remainingTris == 0)
+			return -1.0f;
+
+		float score = Valence[remainingTris < FORSYTH_MAX_VALENCE ? remainingTris : FORSYTH_MAX_VALENCE];
+		if (cachePosition >= 0)
+			score += Cache[cachePosition];
+
+		return score;
+	}
+};
+
+void MeshOptimizer::OptimizeVertexCache(UINT * indices, int indexNum, int vertNum)
+{
+	static ForsythScores scores;
+
+	int triNum = indexNum / 3;
+	if (triNum == 0 || vertNum == 0)
+		return;
+
+	// Build vertex -> triangle adjacency
+	std::vector<int> remaining(vertNum, 0);
+	for (int i = 0; i < triNum * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<int> adjacencyStart(vertNum + 1, 0);
+	for (int v = 0; v < vertNum; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+
+	std::vector<int> adjacency(triNum * 3);
+	std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (int t = 0; t < triNum; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			UINT v = indices[t * 3 + c];
+			adjacency[fill[v]++] = t;
+		}
+	}
+
+	// Initial scores
+	std::vector<int> cachePosition(vertNum, -1);
+	std::vector<float> vertScore(vertNum);
+	for (int v = 0; v < vertNum; v++)
+		vertScore[v] = scores.Score(-1, remaining[v]);
+
+	std::vector<float> triScore(triNum);
+	std::vector<bool> emitted(triNum, false);
+	int bestTri = 0;
+	for (int t = 0; t < triNum; t++)
+	{
+		triScore[t] =
+			vertScore[indices[t * 3 + 0]] +
+			vertScore[indices[t * 3 + 1]] +
+			vertScore[indices[t * 3 + 2]];
+
+		if (triScore[t] > triScore[bestTri])
+			bestTri = t;
+	}
+
+	// The cache holds a few extra slots so verts pushed out by the
+	// newest triangle can still be rescored on their way out
+	int cache[VERTEX_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int newCache[VERTEX_CACHE_SIZE + 3];
+
+	std::vector<UINT> output(triNum * 3);
+	int scanCursor = 0;
+
+	for (int outTri = 0; outTri < triNum; outTri++)
+	{
+		// No cached vertex had anything left to draw, so fall back
+		// to the next unemitted triangle in the original order
+		if (bestTri < 0)
+		{
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTri = scanCursor;
+		}
+
+		UINT tri[3] =
+		{
+			indices[bestTri * 3 + 0],
+			indices[bestTri * 3 + 1],
+			indices[bestTri * 3 + 2]
+		};
+
+		output[outTri * 3 + 0] = tri[0];
+		output[outTri * 3 + 1] = tri[1];
+		output[outTri * 3 + 2] = tri[2];
+		emitted[bestTri] = true;
+
+		// Remove the triangle from its verts' adjacency lists
+		for (int c = 0; c < 3; c++)
+		{
+			UINT v = tri[c];
+			int start = adjacencyStart[v];
+			int end = start + remaining[v];
+			for (int a = start; a < end; a++)
+			{
+				if (adjacency[a] == bestTri)
+				{
+					adjacency[a] = adjacency[end - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// Move the triangle's verts to the front of the cache
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (c > 0 && tri[c] == tri[0]) continue;
+			if (c > 1 && tri[c] == tri[1]) continue;
+			newCache[newCount++] = tri[c];
+		}
+
+		for (int i = 0; i < cacheCount; i++)
+		{
+			int v = cache[i];
+			if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was or still is in the cache, and
+		// pick the best triangle touching it for the next step
+		bestTri = -1;
+		float bestScore = -1.0f;
+
+		for (int i = 0; i < newCount; i++)
+		{
+			int v = newCache[i];
+			int position = i < VERTEX_CACHE_SIZE ? i : -1;
+			cachePosition[v] = position;
+
+			float score = scores.Score(position, remaining[v]);
+			float delta = score - vertScore[v];
+			vertScore[v] = score;
+
+			int start = adjacencyStart[v];
+			int end = start + remaining[v];
+			for (int a = start; a < end; a++)
+			{
+				int t = adjacency[a];
+				triScore[t] += delta;
+			}
+		}
+
+		for (int i = 0; i < newCount && i < VERTEX_CACHE_SIZE; i++)
+		{
+			int v = newCache[i];
+			int start = adjacencyStart[v];
+			int end = start + remaining[v];
+			for (int a = start; a < end; a++)
+			{
+				int t = adjacency[a];
+				if (triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					bestTri = t;
+				}
+			}
+		}
+
+		cacheCount = newCount < VERTEX_CACHE_SIZE ? newCount : VERTEX_CACHE_SIZE;
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+	}
+
+	for (int i = 0; i < triNum * 3; i++)
+		indices[i] = output[i];
+}
+
+float MeshOptimizer::CalculateACMR(const UINT * indices, int indexNum, int vertNum, int cacheSize)
+{
+	int triNum = indexNum / 3;
+	if (triNum == 0)
+		return 0.0f;
+
+	// A vertex is in the FIFO if fewer than cacheSize misses have
+	// happened since it was last loaded
+	std::vector<int> loadedAt(vertNum, -cacheSize - 1);
+	int misses = 0;
+
+	for (int i = 0; i < triNum * 3; i++)
+	{
+		UINT v = indices[i];
+		if ((int)v >= vertNum)
+			continue;
+
+		if (misses - loadedAt[v] > cacheSize)
+		{
+			loadedAt[v] = misses;
+			misses++;
+		}
+	}
+
+	return (float)misses / triNum;
+}
+
+// --------------------------------------------------------
+// Overdraw ordering, after Sander, Nehab and Barczak's
+// "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw".  The cache optimized order is cut into clusters
+// wherever the cache starts cold anyway (hard boundaries) and
+// wherever a cluster's own ACMR is already close to the mesh's
+// (soft boundaries), then clusters are sorted so the ones
+// facing away from the middle of the mesh draw first.
+// --------------------------------------------------------
+void MeshOptimizer::OptimizeOverdraw(const Vertex * vertices, UINT * indices, int indexNum, int vertNum, float threshold)
+{
+	int triNum = indexNum / 3;
+	if (triNum == 0 || vertNum == 0)
+		return;
+
+	// Hard boundaries: triangles where every vertex misses the cache
+	std::vector<int> hardBounds;
+	{
+		std::vector<int> loadedAt(vertNum, -VERTEX_CACHE_SIZE - 1);
+		int misses = 0;
+
+		for (int t = 0; t < triNum; t++)
+		{
+			int triMisses = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				UINT v = indices[t * 3 + c];
+				if (misses - loadedAt[v] > VERTEX_CACHE_SIZE)
+				{
+					loadedAt[v] = misses;
+					misses++;
+					triMisses++;
+				}
+			}
+
+			if (t == 0 || triMisses == 3)
+				hardBounds.push_back(t);
+		}
+		hardBounds.push_back(triNum);
+	}
+
+	// Soft boundaries: split each hard cluster as soon as the part
+	// since the last split has an ACMR close to the whole cluster's
+	std::vector<int> clusters;
+	{
+		std::vector<int> loadedAt(vertNum, -VERTEX_CACHE_SIZE - 1);
+		int misses = 0;
+
+		for (size_t h = 0; h + 1 < hardBounds.size(); h++)
+		{
+			int start = hardBounds[h];
+			int end = hardBounds[h + 1];
+
+			// Moving the miss counter past the cache size empties the cache
+			misses += VERTEX_CACHE_SIZE + 1;
+			int clusterMisses = misses;
+			for (int i = start * 3; i < end * 3; i++)
+			{
+				UINT v = indices[i];
+				if (misses - loadedAt[v] > VERTEX_CACHE_SIZE)
+				{
+					loadedAt[v] = misses;
+					misses++;
+				}
+			}
+			float clusterACMR = (float)(misses - clusterMisses) / (end - start);
+
+			misses += VERTEX_CACHE_SIZE + 1;
+			int splitStart = start;
+			int splitMisses = misses;
+			clusters.push_back(start);
+
+			for (int t = start; t < end; t++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					UINT v = indices[t * 3 + c];
+					if (misses - loadedAt[v] > VERTEX_CACHE_SIZE)
+					{
+						loadedAt[v] = misses;
+						misses++;
+					}
+				}
+
+				float splitACMR = (float)(misses - splitMisses) / (t + 1 - splitStart);
+				if (t + 1 < end && splitACMR <= clusterACMR * threshold)
+				{
+					misses += VERTEX_CACHE_SIZE + 1;
+					splitStart = t + 1;
+					splitMisses = misses;
+					clusters.push_back(splitStart);
+				}
+			}
+		}
+		clusters.push_back(triNum);
+	}
+
+	int clusterNum = (int)clusters.size() - 1;
+	if (clusterNum < 2)
+		return;
+
+	// Area weighted centroid and normal of each cluster and of the mesh
+	std::vector<XMFLOAT3> clusterCentroid(clusterNum);
+	std::vector<XMFLOAT3> clusterNormal(clusterNum);
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+
+	for (int i = 0; i < clusterNum; i++)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for (int t = clusters[i]; t < clusters[i + 1]; t++)
+		{
+			XMVECTOR a = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+			XMVECTOR b = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR c = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+
+			XMVECTOR n = XMVector3Cross(b - a, c - a);
+			float triArea = XMVectorGetX(XMVector3Length(n));
+
+			centroid += (a + b + c) * (triArea / 3.0f);
+			normal += n;
+			area += triArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		if (area > 0.0f)
+			centroid /= area;
+
+		XMStoreFloat3(&clusterCentroid[i], centroid);
+		XMStoreFloat3(&clusterNormal[i], XMVector3Normalize(normal));
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters facing away from the centre are the ones most likely
+	// to be in front of the rest, so they go first
+	std::vector<float> sortKey(clusterNum);
+	std::vector<int> order(clusterNum);
+	for (int i = 0; i < clusterNum; i++)
+	{
+		XMVECTOR offset = XMLoadFloat3(&clusterCentroid[i]) - meshCentroid;
+		sortKey[i] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&clusterNormal[i])));
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sortKey](int a, int b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<UINT> output;
+	output.reserve(triNum * 3);
+	for (int i = 0; i < clusterNum; i++)
+	{
+		int cluster = order[i];
+		output.insert(output.end(), indices + clusters[cluster] * 3, indices + clusters[cluster + 1] * 3);
+	}
+
+	for (int i = 0; i < triNum * 3; i++)
+		indices[i] = output[i];
+}
+
+int MeshOptimizer::OptimizeVertexFetch(Vertex * vertices, UINT * indices, int indexNum, int vertNum)
+{
+	// Assign new indices in the order verts are first referenced
+	std::vector<UINT> remap(vertNum, UINT_MAX);
+	UINT next = 0;
+
+	for (int i = 0; i < indexNum; i++)
+	{
+		UINT v = indices[i];
+		if (remap[v] == UINT_MAX)
+			remap[v] = next++;
+
+		indices[i] = remap[v];
+	}
+
+	std::vector<Vertex> reordered(next);
+	for (int v = 0; v < vertNum; v++)
+	{
+		if (remap[v] != UINT_MAX)
+			reordered[remap[v]] = vertices[v];
+	}
+
+	for (UINT v = 0; v < next; v++)
+		vertices[v] = reordered[v];
+
+	return (int)next;
+}
+
+// --------------------------------------------------------
+// Depth complexity from the six axis directions and the
+// eight cube diagonals, using an orthographic projection
+// fitted to the mesh.  Pixel centres are sampled with a
+// top-left fill rule so shared edges aren't counted twice.
+// --------------------------------------------------------
+float MeshOptimizer::EstimateOverdraw(const Vertex * vertices, const UINT * indices, int indexNum, int vertNum)
+{
+	int triNum = indexNum / 3;
+	if (triNum == 0 || vertNum == 0)
+		return 0.0f;
+
+	const float directions[][3] =
+	{
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 },
+		{ -1, 1, 1 }, { -1, 1, -1 }, { -1, -1, 1 }, { -1, -1, -1 }
+	};
+	const int viewNum = sizeof(directions) / sizeof(directions[0]);
+
+	std::vector<float> depth(OVERDRAW_RESOLUTION * OVERDRAW_RESOLUTION);
+	std::vector<XMFLOAT3> projected(vertNum);
+	unsigned long long shaded = 0;
+	unsigned long long covered = 0;
+
+	for (int view = 0; view < viewNum; view++)
+	{
+		XMVECTOR forward = XMVector3Normalize(XMVectorSet(directions[view][0], directions[view][1], directions[view][2], 0));
+		XMVECTOR up = fabsf(directions[view][1]) > 0.0f && directions[view][0] == 0.0f && directions[view][2] == 0.0f ?
+			XMVectorSet(0, 0, 1, 0) :
+			XMVectorSet(0, 1, 0, 0);
+		XMVECTOR right = XMVector3Normalize(XMVector3Cross(up, forward));
+		up = XMVector3Cross(forward, right);
+
+		// Project into (right, up, forward) and fit the grid to the result
+		XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+		XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+		for (int v = 0; v < vertNum; v++)
+		{
+			XMVECTOR pos = XMLoadFloat3(&vertices[v].Position);
+			XMVECTOR p = XMVectorSet(
+				XMVectorGetX(XMVector3Dot(pos, right)),
+				XMVectorGetX(XMVector3Dot(pos, up)),
+				XMVectorGetX(XMVector3Dot(pos, forward)),
+				0);
+			XMStoreFloat3(&projected[v], p);
+			boundsMin = XMVectorMin(boundsMin, p);
+			boundsMax = XMVectorMax(boundsMax, p);
+		}
+
+		XMFLOAT3 low, high;
+		XMStoreFloat3(&low, boundsMin);
+		XMStoreFloat3(&high, boundsMax);
+		float extent = max(high.x - low.x, high.y - low.y);
+		if (extent <= 0.0f)
+			continue;
+		float scale = OVERDRAW_RESOLUTION / extent;
+
+		for (int v = 0; v < vertNum; v++)
+		{
+			projected[v].x = (projected[v].x - low.x) * scale;
+			projected[v].y = (projected[v].y - low.y) * scale;
+		}
+
+		for (size_t i = 0; i < depth.size(); i++)
+			depth[i] = FLT_MAX;
+
+		for (int t = 0; t < triNum; t++)
+		{
+			XMFLOAT3 a = projected[indices[t * 3 + 0]];
+			XMFLOAT3 b = projected[indices[t * 3 + 1]];
+			XMFLOAT3 c = projected[indices[t * 3 + 2]];
+
+			// Front faces are clockwise, which is a negative area here
+			float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+			if (area >= 0.0f)
+				continue;
+
+			// Swap to counter-clockwise so the edge functions are positive inside
+			XMFLOAT3 temp = b; b = c; c = temp;
+			area = -area;
+
+			int minX = max(0, (int)floorf(min(a.x, min(b.x, c.x))));
+			int maxX = min(OVERDRAW_RESOLUTION - 1, (int)ceilf(max(a.x, max(b.x, c.x))));
+			int minY = max(0, (int)floorf(min(a.y, min(b.y, c.y))));
+			int maxY = min(OVERDRAW_RESOLUTION - 1, (int)ceilf(max(a.y, max(b.y, c.y))));
+
+			// Edge v0 -> v1 owns its pixels if it's a top or left edge
+			XMFLOAT3 edgeStart[3] = { b, c, a };
+			XMFLOAT3 edgeEnd[3] = { c, a, b };
+			bool owns[3];
+			for (int e = 0; e < 3; e++)
+			{
+				float dx = edgeEnd[e].x - edgeStart[e].x;
+				float dy = edgeEnd[e].y - edgeStart[e].y;
+				owns[e] = dy < 0.0f || (dy == 0.0f && dx > 0.0f);
+			}
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				float py = y + 0.5f;
+				for (int x = minX; x <= maxX; x++)
+				{
+					float px = x + 0.5f;
+
+					float w[3];
+					bool inside = true;
+					for (int e = 0; e < 3 && inside; e++)
+					{
+						w[e] = (edgeEnd[e].x - edgeStart[e].x) * (py - edgeStart[e].y) - (edgeEnd[e].y - edgeStart[e].y) * (px - edgeStart[e].x);
+						inside = w[e] > 0.0f || (w[e] == 0.0f && owns[e]);
+					}
+					if (!inside)
+						continue;
+
+					// w[0] is the weight of a, w[1] of b, w[2] of c
+					float z = (w[0] * a.z + w[1] * b.z + w[2] * c.z) / area;
+					float& stored = depth[y * OVERDRAW_RESOLUTION + x];
+					if (z < stored)
+					{
+						if (stored == FLT_MAX)
+							covered++;
+						stored = z;
+						shaded++;
+					}
+				}
+			}
+		}
+	}
+
+	return covered > 0 ? (float)shaded / covered : 0.0f;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Vertex.h"
+#include <d3d11.h>
+
+// Size of the simulated post-transform cache used for scoring
+#define VERTEX_CACHE_SIZE	32
+
+// How much worse than the whole mesh a cluster's ACMR may be
+// before OptimizeOverdraw stops splitting it further
+#define OVERDRAW_CACHE_THRESHOLD	1.05f
+
+// Grid size used by EstimateOverdraw for each view
+#define OVERDRAW_RESOLUTION	256
+
+// --------------------------------------------------------
+// Offline passes that reorder mesh data for the GPU.  These
+// only change the order things are drawn in, never what is
+// drawn, and are run once when a mesh's cache is built.
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	// Reorders triangles for the post-transform vertex cache
+	// (Tom Forsyth's linear-speed vertex cache optimization)
+	static void OptimizeVertexCache(UINT* indices, int indexNum, int vertNum);
+
+	// Average cache miss ratio: transformed vertices per triangle
+	// with a FIFO cache of the given size.  1.0 or less is good,
+	// 3.0 means nothing is ever reused.
+	static float CalculateACMR(const UINT* indices, int indexNum, int vertNum, int cacheSize);
+
+	// Splits cache optimized triangles into small clusters and draws
+	// the outward facing ones first, so the depth test rejects more of
+	// the rest.  Run after OptimizeVertexCache; the cluster split keeps
+	// the ACMR within threshold of what it was.
+	static void OptimizeOverdraw(const Vertex* vertices, UINT* indices, int indexNum, int vertNum, float threshold = OVERDRAW_CACHE_THRESHOLD);
+
+	// Reorders the vertex buffer to first use order and remaps the
+	// indices to match, dropping unused verts.  Returns the new vertex
+	// count.  Run last, since it depends on the final index order.
+	static int OptimizeVertexFetch(Vertex* vertices, UINT* indices, int indexNum, int vertNum);
+
+	// Software depth complexity: rasterizes the mesh in index order
+	// from several directions with back face culling and a depth test,
+	// and returns pixels shaded / pixels covered.  1.0 is no overdraw.
+	static float EstimateOverdraw(const Vertex* vertices, const UINT* indices, int indexNum, int vertNum);
+};
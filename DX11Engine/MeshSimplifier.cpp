@@ -0,0 +1,486 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Largest change in a triangle's normal a collapse may cause (cos of ~60 degrees)
+#define SIMPLIFY_MIN_NORMAL_DOT		0.5f
+
+// Stop the chain once a level can't lose at least this much
+#define SIMPLIFY_MIN_REDUCTION		0.9f
+
+// --------------------------------------------------------
+// Symmetric 4x4 quadric, the sum of squared distances to a
+// set of planes, each weighted by its triangle's area
+// --------------------------------------------------------
+struct Quadric
+{
+	double a2, ab, ac, ad;
+	double b2, bc, bd;
+	double c2, cd;
+	double d2;
+	double weight;
+
+	void AddPlane(XMFLOAT3 n, float d, float w)
+	{
+		a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+		b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+		c2 += w * n.z * n.z; cd += w * n.z * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	void Add(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	// Area weighted mean squared distance to the planes
+	double Evaluate(XMFLOAT3 p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e =
+			a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+			b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+			c2 * z * z + 2 * cd * z +
+			d2;
+
+		return weight > 0 ? fabs(e) / weight : 0;
+	}
+};
+
+struct Collapse
+{
+	double Cost;
+	UINT From;
+	UINT To;
+
+	bool operator<(const Collapse& other) const { return Cost < other.Cost; }
+};
+
+// Unnormalized normal, length is twice the triangle's area
+static XMVECTOR TriangleNormal(const Vertex* vertices, UINT a, UINT b, UINT c)
+{
+	XMVECTOR pa = XMLoadFloat3(&vertices[a].Position);
+	XMVECTOR pb = XMLoadFloat3(&vertices[b].Position);
+	XMVECTOR pc = XMLoadFloat3(&vertices[c].Position);
+	return XMVector3Cross(pb - pa, pc - pa);
+}
+
+static bool SamePosition(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+int MeshSimplifier::Simplify(const Vertex * vertices, int vertNum, const UINT * indices, int indexNum, int targetIndexNum, float maxError, UINT * destination, float * error)
+{
+	int triNum = indexNum / 3;
+	*error = 0.0f;
+
+	std::vector<UINT> tris(indices, indices + triNum * 3);
+
+	// Give every distinct position an id, so seam verts (same
+	// position, different normal or UV) are treated as one point
+	std::vector<UINT> positionId(vertNum);
+	std::vector<UINT> sorted(vertNum);
+	for (int v = 0; v < vertNum; v++)
+		sorted[v] = v;
+
+	std::sort(sorted.begin(), sorted.end(), [vertices](UINT a, UINT b)
+	{
+		const XMFLOAT3& pa = vertices[a].Position;
+		const XMFLOAT3& pb = vertices[b].Position;
+		if (pa.x != pb.x) return pa.x < pb.x;
+		if (pa.y != pb.y) return pa.y < pb.y;
+		return pa.z < pb.z;
+	});
+
+	std::vector<bool> locked(vertNum, false);
+	int positionNum = 0;
+	for (int i = 0; i < vertNum; )
+	{
+		int j = i + 1;
+		while (j < vertNum && SamePosition(vertices[sorted[i]].Position, vertices[sorted[j]].Position))
+			j++;
+
+		for (int k = i; k < j; k++)
+		{
+			positionId[sorted[k]] = positionNum;
+			locked[sorted[k]] = j - i > 1;
+		}
+
+		positionNum++;
+		i = j;
+	}
+
+	// Some exporters write every face twice.  Coincident copies add
+	// nothing to the picture and make each edge look non-manifold,
+	// so keep one triangle per winding-ordered position triple
+	{
+		std::vector<std::pair<unsigned long long, UINT>> keys;
+		keys.reserve(triNum);
+		for (int t = 0; t < triNum; t++)
+		{
+			UINT p[3] = { positionId[tris[t * 3 + 0]], positionId[tris[t * 3 + 1]], positionId[tris[t * 3 + 2]] };
+			if (p[0] == p[1] || p[1] == p[2] || p[2] == p[0])
+				continue;
+
+			// Rotate the smallest id first, which keeps the winding
+			while (p[0] > p[1] || p[0] > p[2])
+			{
+				UINT first = p[0];
+				p[0] = p[1]; p[1] = p[2]; p[2] = first;
+			}
+
+			unsigned long long key = ((unsigned long long)p[0] << 42) | ((unsigned long long)p[1] << 21) | p[2];
+			keys.push_back(std::make_pair(key, (UINT)t));
+		}
+		std::sort(keys.begin(), keys.end());
+
+		std::vector<UINT> unique;
+		unique.reserve(keys.size() * 3);
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			if (i > 0 && keys[i].first == keys[i - 1].first)
+				continue;
+
+			UINT t = keys[i].second;
+			unique.insert(unique.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+		}
+
+		tris.swap(unique);
+		triNum = (int)tris.size() / 3;
+	}
+
+	// Edges that don't have exactly two triangles are open borders
+	// or non-manifold, so their ends have to stay put
+	{
+		std::vector<unsigned long long> edges;
+		edges.reserve(triNum * 3);
+		for (int t = 0; t < triNum; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				UINT a = positionId[tris[t * 3 + c]];
+				UINT b = positionId[tris[t * 3 + (c + 1) % 3]];
+				if (a > b) std::swap(a, b);
+				edges.push_back(((unsigned long long)a << 32) | b);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		std::vector<bool> lockedPosition(positionNum, false);
+		for (size_t i = 0; i < edges.size(); )
+		{
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				j++;
+
+			if (j - i != 2)
+			{
+				lockedPosition[(UINT)(edges[i] >> 32)] = true;
+				lockedPosition[(UINT)(edges[i] & 0xFFFFFFFF)] = true;
+			}
+			i = j;
+		}
+
+		for (int v = 0; v < vertNum; v++)
+		{
+			if (lockedPosition[positionId[v]])
+				locked[v] = true;
+		}
+	}
+
+	// Plane quadrics, accumulated per position
+	std::vector<Quadric> quadrics(positionNum, Quadric());
+	for (int t = 0; t < triNum; t++)
+	{
+		XMVECTOR n = TriangleNormal(vertices, tris[t * 3 + 0], tris[t * 3 + 1], tris[t * 3 + 2]);
+		float length = XMVectorGetX(XMVector3Length(n));
+		if (length == 0.0f)
+			continue;
+
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, n / length);
+		float d = -XMVectorGetX(XMVector3Dot(n / length, XMLoadFloat3(&vertices[tris[t * 3]].Position)));
+
+		for (int c = 0; c < 3; c++)
+			quadrics[positionId[tris[t * 3 + c]]].AddPlane(normal, d, length * 0.5f);
+	}
+
+	double maxCost = (double)maxError * maxError;
+	double usedCost = 0;
+	int liveTris = triNum;
+
+	std::vector<UINT> adjacencyStart(positionNum + 1);
+	std::vector<UINT> adjacency;
+	std::vector<bool> removed;
+	std::vector<bool> touched(positionNum);
+	std::vector<UINT> neighbourMark(positionNum, UINT_MAX);
+	std::vector<Collapse> collapses;
+
+	while (liveTris * 3 > targetIndexNum)
+	{
+		// Position -> triangle adjacency for the current triangles
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (int t = 0; t < liveTris * 3; t++)
+			adjacencyStart[positionId[tris[t]] + 1]++;
+		for (int p = 0; p < positionNum; p++)
+			adjacencyStart[p + 1] += adjacencyStart[p];
+
+		adjacency.resize(liveTris * 3);
+		std::vector<UINT> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (int t = 0; t < liveTris; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				adjacency[fill[positionId[tris[t * 3 + c]]]++] = t;
+		}
+
+		// Cheapest valid collapse for each vertex that's free to move
+		collapses.clear();
+		for (int v = 0; v < vertNum; v++)
+		{
+			if (locked[v])
+				continue;
+
+			UINT pv = positionId[v];
+			UINT start = adjacencyStart[pv];
+			UINT end = adjacencyStart[pv + 1];
+			if (start == end)
+				continue;
+
+			// Mark v's neighbouring positions for the link test below
+			for (UINT a = start; a < end; a++)
+			{
+				for (int c = 0; c < 3; c++)
+					neighbourMark[positionId[tris[adjacency[a] * 3 + c]]] = v;
+			}
+
+			Collapse best = { DBL_MAX, (UINT)v, (UINT)v };
+
+			for (UINT a = start; a < end; a++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					UINT u = tris[adjacency[a] * 3 + c];
+					if (u == (UINT)v)
+						continue;
+
+					UINT pu = positionId[u];
+					Quadric q = quadrics[pv];
+					q.Add(quadrics[pu]);
+					double cost = q.Evaluate(vertices[u].Position);
+					if (cost >= best.Cost || cost > maxCost)
+						continue;
+
+					// Link condition: v and u may only share the neighbours
+					// of the two triangles that disappear, or the collapse
+					// would pinch the surface
+					int shared = 0;
+					for (UINT b = adjacencyStart[pu]; b < adjacencyStart[pu + 1]; b++)
+					{
+						for (int k = 0; k < 3; k++)
+						{
+							UINT pw = positionId[tris[adjacency[b] * 3 + k]];
+							if (pw != pu && pw != pv && neighbourMark[pw] == (UINT)v)
+							{
+								neighbourMark[pw] = UINT_MAX - 1;
+								shared++;
+							}
+						}
+					}
+
+					// Restore the marks the count used up
+					for (UINT b = start; b < end; b++)
+					{
+						for (int k = 0; k < 3; k++)
+							neighbourMark[positionId[tris[adjacency[b] * 3 + k]]] = v;
+					}
+
+					if (shared > 2)
+						continue;
+
+					// Moving v onto u must not flip or badly bend what's left
+					bool valid = true;
+					for (UINT b = start; b < end && valid; b++)
+					{
+						UINT t = adjacency[b];
+						UINT corners[3] = { tris[t * 3 + 0], tris[t * 3 + 1], tris[t * 3 + 2] };
+						if (corners[0] == u || corners[1] == u || corners[2] == u)
+							continue;
+
+						XMVECTOR before = TriangleNormal(vertices, corners[0], corners[1], corners[2]);
+						for (int k = 0; k < 3; k++)
+						{
+							if (corners[k] == (UINT)v)
+								corners[k] = u;
+						}
+						XMVECTOR after = TriangleNormal(vertices, corners[0], corners[1], corners[2]);
+
+						float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+						valid = lengths > 0.0f && XMVectorGetX(XMVector3Dot(before, after)) >= SIMPLIFY_MIN_NORMAL_DOT * lengths;
+					}
+
+					if (valid)
+					{
+						best.Cost = cost;
+						best.To = u;
+					}
+				}
+			}
+
+			if (best.To != (UINT)v)
+				collapses.push_back(best);
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end());
+
+		// Apply as many as possible this pass.  A collapse only changes
+		// triangles around its source vertex, so once one is done the
+		// whole neighbourhood waits for the next pass
+		std::fill(touched.begin(), touched.end(), false);
+		std::fill(removed.begin(), removed.end(), false);
+		removed.resize(liveTris, false);
+		int applied = 0;
+
+		for (size_t i = 0; i < collapses.size() && liveTris * 3 > targetIndexNum; i++)
+		{
+			const Collapse& collapse = collapses[i];
+			UINT pv = positionId[collapse.From];
+			if (touched[pv] || touched[positionId[collapse.To]])
+				continue;
+
+			for (UINT a = adjacencyStart[pv]; a < adjacencyStart[pv + 1]; a++)
+			{
+				UINT t = adjacency[a];
+				if (removed[t])
+					continue;
+
+				bool degenerate = false;
+				for (int c = 0; c < 3; c++)
+				{
+					touched[positionId[tris[t * 3 + c]]] = true;
+					if (tris[t * 3 + c] == collapse.To)
+						degenerate = true;
+				}
+
+				if (degenerate)
+				{
+					removed[t] = true;
+					liveTris--;
+				}
+				else
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						if (tris[t * 3 + c] == collapse.From)
+							tris[t * 3 + c] = collapse.To;
+					}
+				}
+			}
+
+			quadrics[positionId[collapse.To]].Add(quadrics[pv]);
+			usedCost = max(usedCost, collapse.Cost);
+			applied++;
+		}
+
+		// Compact the surviving triangles
+		int write = 0;
+		for (int t = 0; t < (int)removed.size(); t++)
+		{
+			if (removed[t])
+				continue;
+
+			tris[write * 3 + 0] = tris[t * 3 + 0];
+			tris[write * 3 + 1] = tris[t * 3 + 1];
+			tris[write * 3 + 2] = tris[t * 3 + 2];
+			write++;
+		}
+		liveTris = write;
+
+		if (applied == 0)
+			break;
+	}
+
+	for (int i = 0; i < liveTris * 3; i++)
+		destination[i] = tris[i];
+
+	*error = (float)sqrt(usedCost);
+	return liveTris * 3;
+}
+
+void MeshSimplifier::GenerateLODs(const Vertex * vertices, int vertNum, std::vector<UINT>& indices, std::vector<MeshLOD>& lods, std::vector<MeshSubmesh>& submeshes)
+{
+	lods.clear();
+
+	MeshLOD full = { 0, (UINT)indices.size(), 0.0f };
+	lods.push_back(full);
+
+	std::vector<UINT> source;
+	std::vector<UINT> simplified;
+	while (lods.size() < MESH_MAX_LODS)
+	{
+		const MeshLOD& previous = lods.back();
+		size_t level = lods.size();
+
+		MeshLOD lod = { (UINT)indices.size(), 0, previous.Error };
+
+		for (size_t s = 0; s < submeshes.size(); s++)
+		{
+			MeshSubmesh& submesh = submeshes[s];
+
+			// Simplify from the previous level, it's already smaller
+			UINT sourceStart = submesh.StartIndex[level - 1];
+			UINT sourceCount = submesh.IndexCount[level - 1];
+			source.assign(indices.begin() + sourceStart, indices.begin() + sourceStart + sourceCount);
+			int target = (int)(sourceCount * MESH_LOD_RATIO) / 3 * 3;
+
+			simplified.resize(source.size());
+			float error = 0.0f;
+			int count = sourceCount ? Simplify(vertices, vertNum, &source[0], (int)source.size(), target, FLT_MAX, &simplified[0], &error) : 0;
+
+			// Submeshes that won't shrink come along as they are
+			if (count == 0 || count > sourceCount * SIMPLIFY_MIN_REDUCTION)
+			{
+				simplified = source;
+				count = (int)sourceCount;
+				error = 0.0f;
+			}
+			else
+			{
+				MeshOptimizer::OptimizeVertexCache(&simplified[0], count, vertNum);
+			}
+
+			submesh.StartIndex[level] = (UINT)indices.size();
+			submesh.IndexCount[level] = (UINT)count;
+			indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+
+			lod.IndexCount += count;
+			lod.Error = max(lod.Error, error);
+		}
+
+		// Not worth a level of its own
+		if (lod.IndexCount > previous.IndexCount * SIMPLIFY_MIN_REDUCTION)
+		{
+			indices.resize(lod.StartIndex);
+			for (size_t s = 0; s < submeshes.size(); s++)
+			{
+				submeshes[s].StartIndex[level] = 0;
+				submeshes[s].IndexCount[level] = 0;
+			}
+			break;
+		}
+
+		lods.push_back(lod);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Vertex.h"
+#include <vector>
+#include <d3d11.h>
+
+// Most LODs generated per mesh, including the full mesh
+#define MESH_MAX_LODS		4
+
+// Each LOD aims for this fraction of the previous one's triangles
+#define MESH_LOD_RATIO		0.5f
+
+// --------------------------------------------------------
+// One level of detail: a range of the mesh's index buffer,
+// and how far (in model units) it strays from the full mesh
+// --------------------------------------------------------
+struct MeshLOD
+{
+	UINT StartIndex;
+	UINT IndexCount;
+	float Error;
+};
+
+// --------------------------------------------------------
+// A run of triangles drawn with one material.  Every LOD
+// holds each submesh's triangles in the same order, so each
+// submesh has its own range of every LOD.
+// --------------------------------------------------------
+struct MeshSubmesh
+{
+	UINT MaterialSlot;
+	UINT StartIndex[MESH_MAX_LODS];
+	UINT IndexCount[MESH_MAX_LODS];
+	UINT FirstCluster;		// LOD 0's clusters
+	UINT ClusterCount;
+};
+
+// --------------------------------------------------------
+// Quadric error metric edge collapse (Garland & Heckbert).
+//
+// Vertices are only ever collapsed onto one of their
+// neighbours, never moved, so every LOD can index the same
+// vertex buffer.  Vertices on UV or normal seams (positions
+// shared by several verts) and on open borders never move,
+// which keeps seams and silhouettes of open meshes intact.
+// Collapses that would flip a triangle or bend its normal
+// too far are rejected.
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+	// Writes a simplified copy of the triangles to destination
+	// (indexNum entries is always enough) and returns its index
+	// count.  Stops at targetIndexNum or when the next collapse
+	// would exceed maxError; error gets the largest error used.
+	static int Simplify(const Vertex* vertices, int vertNum, const UINT* indices, int indexNum, int targetIndexNum, float maxError, UINT* destination, float* error);
+
+	// Appends up to MESH_MAX_LODS - 1 coarser levels after the
+	// full mesh (indices[0, indexNum)) and fills in lods.  Each
+	// submesh is simplified on its own, from its LOD 0 range,
+	// so the edges between materials stay where they are.
+	static void GenerateLODs(const Vertex* vertices, int vertNum, std::vector<UINT>& indices, std::vector<MeshLOD>& lods, std::vector<MeshSubmesh>& submeshes);
+};
@@ -0,0 +1,193 @@
+#include "MeshStream.h"
+#include <string>
+#include <utility>
+
+MeshStream::MeshStream(const char * file)
+{
+	cache = 0;
+	levelNum = 0;
+
+	std::string path = "Assets/Models/";
+	path += file;
+
+	// The cache is only any good if it was built from the
+	// file as it is now
+	unsigned long long sourceHash;
+	{
+		MappedFile source(path.c_str());
+		if (!source.IsOpen())
+			return;
+		sourceHash = MeshCache::Hash(source.GetData(), source.GetSize());
+	}
+
+	path += ".meshbin";
+	Open(path.c_str(), sourceHash);
+}
+
+MeshStream::MeshStream(const char * cachePath, unsigned long long sourceHash)
+{
+	cache = 0;
+	levelNum = 0;
+
+	Open(cachePath, sourceHash);
+}
+
+MeshStream::~MeshStream()
+{
+	delete cache;
+}
+
+void MeshStream::Open(const char * cachePath, unsigned long long sourceHash)
+{
+	cache = new MeshCache(cachePath);
+	if (!cache->IsValid(sourceHash))
+	{
+		delete cache;
+		cache = 0;
+		return;
+	}
+
+	// Room for every level, so adding one never moves the rest
+	decoded.Vertices.reserve(cache->GetHeader()->VertexCount);
+	decoded.Indices.reserve(cache->GetHeader()->IndexCount);
+}
+
+bool MeshStream::IsOpen()
+{
+	return cache != 0;
+}
+
+int MeshStream::GetLevelCount()
+{
+	return cache ? (int)cache->GetHeader()->LODCount : 0;
+}
+
+bool MeshStream::Decode(int level, MeshData & data)
+{
+	if (!cache || level != levelNum || level >= GetLevelCount())
+		return false;
+
+	const MeshCacheHeader* header = cache->GetHeader();
+	const MeshCacheLevel& added = cache->GetLevels()[level];
+
+	// Decode just this level, after the ones already here
+	UINT firstVertex = (UINT)decoded.Vertices.size();
+	UINT firstIndex = (UINT)decoded.Indices.size();
+	decoded.Vertices.resize(firstVertex + added.VertexCount);
+	decoded.Indices.resize(firstIndex + added.IndexCount);
+	if (!cache->DecodeLevel(level, firstVertex, decoded.Vertices.data() + firstVertex, decoded.Indices.data() + firstIndex))
+	{
+		decoded.Vertices.resize(firstVertex);
+		decoded.Indices.resize(firstIndex);
+		return false;
+	}
+	levelNum++;
+
+	// The LODs finer than this level aren't there, so each one
+	// that is moves up by that many.  Coarser LODs come first
+	// in the indices, so their ranges stay where they were.
+	int skipped = header->LODCount - 1 - level;
+	const MeshLOD* lods = cache->GetLODs();
+	decoded.LODs.assign(lods + skipped, lods + header->LODCount);
+
+	const MeshSubmesh* submeshes = cache->GetSubmeshes();
+	decoded.Submeshes.resize(header->SubmeshCount);
+	for (UINT i = 0; i < header->SubmeshCount; i++)
+	{
+		MeshSubmesh& submesh = decoded.Submeshes[i];
+		submesh = submeshes[i];
+		for (int lod = 0; lod < MESH_MAX_LODS; lod++)
+		{
+			bool present = lod <= level;
+			submesh.StartIndex[lod] = present ? submeshes[i].StartIndex[lod + skipped] : 0;
+			submesh.IndexCount[lod] = present ? submeshes[i].IndexCount[lod + skipped] : 0;
+		}
+	}
+
+	// Bounds of the whole mesh, so choosing LODs doesn't jump
+	// around as levels arrive
+	decoded.Box = header->Box;
+	decoded.Sphere = header->Sphere;
+
+	Mesh::BuildClusters(decoded);
+	Mesh::BuildBVH(decoded);
+
+	// Hand over the new level, and the rest as it is now
+	data.Vertices.assign(decoded.Vertices.begin() + firstVertex, decoded.Vertices.end());
+	data.Indices.assign(decoded.Indices.begin() + firstIndex, decoded.Indices.end());
+	data.LODs = decoded.LODs;
+	data.Submeshes = decoded.Submeshes;
+	data.Clusters.swap(decoded.Clusters);
+	std::swap(data.BVH, decoded.BVH);
+	data.Box = decoded.Box;
+	data.Sphere = decoded.Sphere;
+
+	data.FirstVertex = firstVertex;
+	data.FirstIndex = firstIndex;
+	data.TotalVertices = header->VertexCount;
+	data.TotalIndices = header->IndexCount;
+	return true;
+}
+
+// --------------------------------------------------------
+// A stable counting sort of the verts by the first level
+// that uses them.  Within a level they keep the order
+// Mesh::Optimize gave them, so fetches stay mostly in order.
+// --------------------------------------------------------
+void MeshStream::Reorder(MeshData & data)
+{
+	int lodNum = (int)data.LODs.size();
+
+	// Indices, coarsest LOD first.  Submesh ranges move with
+	// their LOD's range.
+	std::vector<UINT> indices;
+	indices.reserve(data.Indices.size());
+	for (int lod = lodNum - 1; lod >= 0; lod--)
+	{
+		MeshLOD& range = data.LODs[lod];
+		UINT start = (UINT)indices.size();
+		indices.insert(indices.end(), data.Indices.begin() + range.StartIndex, data.Indices.begin() + range.StartIndex + range.IndexCount);
+
+		for (size_t i = 0; i < data.Submeshes.size(); i++)
+			data.Submeshes[i].StartIndex[lod] = data.Submeshes[i].StartIndex[lod] - range.StartIndex + start;
+		range.StartIndex = start;
+	}
+
+	// The first level to use each vert, now that the indices
+	// are in level order.  Unused verts go with the full mesh.
+	int vertNum = (int)data.Vertices.size();
+	std::vector<int> firstLevel(vertNum, lodNum - 1);
+	std::vector<bool> used(vertNum, false);
+	for (int level = 0; level < lodNum; level++)
+	{
+		const MeshLOD& range = data.LODs[lodNum - 1 - level];
+		for (UINT i = range.StartIndex; i < range.StartIndex + range.IndexCount; i++)
+		{
+			if (!used[indices[i]])
+			{
+				used[indices[i]] = true;
+				firstLevel[indices[i]] = level;
+			}
+		}
+	}
+
+	std::vector<UINT> levelStart(lodNum + 1, 0);
+	for (int i = 0; i < vertNum; i++)
+		levelStart[firstLevel[i] + 1]++;
+	for (int level = 0; level < lodNum; level++)
+		levelStart[level + 1] += levelStart[level];
+
+	std::vector<UINT> remap(vertNum);
+	std::vector<Vertex> vertices(vertNum);
+	for (int i = 0; i < vertNum; i++)
+	{
+		remap[i] = levelStart[firstLevel[i]]++;
+		vertices[remap[i]] = data.Vertices[i];
+	}
+
+	for (size_t i = 0; i < indices.size(); i++)
+		indices[i] = remap[indices[i]];
+
+	data.Vertices.swap(vertices);
+	data.Indices.swap(indices);
+}
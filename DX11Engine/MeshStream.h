@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Mesh.h"
+#include "MeshCache.h"
+
+// --------------------------------------------------------
+// Loads a mesh from its cache a level at a time, coarsest
+// first, so something that looks like it can be drawn long
+// before all of it has been decoded.
+//
+// A level decodes to the mesh as if its LOD were the finest
+// one: that LOD becomes LOD 0 and the coarser ones follow.
+// Each level only adds verts and indices after the ones
+// before it, so only the new level is decoded and handed
+// to Mesh::SetData, which appends it to the room the first
+// level reserved.  Selecting LODs, culling clusters and ray
+// casts all work on whatever is there.
+//
+// The stream keeps every level decoded so far, which the
+// clusters and BVH of each new LOD 0 are built from.
+//
+// Only works from an up to date cache, which Mesh::Load
+// writes the first time a file is loaded.
+// --------------------------------------------------------
+class MeshStream
+{
+public:
+	// The cache of Assets/Models/file, or of any source with
+	// this hash wherever it is
+	MeshStream(const char* file);
+	MeshStream(const char* cachePath, unsigned long long sourceHash);
+	~MeshStream();
+
+	bool IsOpen();
+	int GetLevelCount();
+
+	// Level 0 is the coarsest LOD, GetLevelCount() - 1 the
+	// full mesh.  Levels must be decoded in order, one call
+	// at a time, but on any thread.
+	bool Decode(int level, MeshData& data);
+
+	// Lays a mesh out the way the cache streams it: indices of
+	// the coarsest LOD first, and verts in the order the LODs
+	// first use them, otherwise keeping their order
+	static void Reorder(MeshData& data);
+
+private:
+	void Open(const char* cachePath, unsigned long long sourceHash);
+
+	MeshCache* cache;
+
+	MeshData decoded;	// Every level so far
+	int levelNum;
+};
@@ -0,0 +1,741 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <intrin.h>
+#include <emmintrin.h>
+
+using namespace DirectX;
+
+// Bits of ObjCorner::Relative
+#define OBJ_RELATIVE_POSITION	1
+#define OBJ_RELATIVE_UV			2
+#define OBJ_RELATIVE_NORMAL		4
+
+// Files smaller than this per worker aren't worth splitting
+#define OBJ_MIN_CHUNK_SIZE		(1 << 20)
+
+// A single face corner, as 0-based indices into the
+// position/uv/normal lists (-1 when not present).
+//
+// Negative (relative) OBJ indices can only be resolved against
+// the chunk's own counts while parsing, so they're flagged in
+// Relative and offset by the chunk's base once all chunks are in.
+struct ObjCorner
+{
+	int Position;
+	int UV;
+	int Normal;
+	int Relative;
+};
+
+// A "usemtl" or "g" record: its name, and the first face
+// corner after it
+struct ObjNameStart
+{
+	std::string Name;
+	size_t FirstCorner;
+};
+
+// Everything parsed out of one line-aligned slice of the file
+struct ObjChunk
+{
+	const char* Start;
+	const char* End;
+
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+	std::vector<DirectX::XMFLOAT2> UVs;
+	std::vector<ObjCorner> Corners;      // Triangulated face corners, in output order
+	std::vector<ObjNameStart> Materials;
+	std::vector<ObjNameStart> Groups;
+
+	// Where this chunk's data starts in the merged arrays
+	size_t PositionBase;
+	size_t NormalBase;
+	size_t UVBase;
+	size_t CornerBase;
+};
+
+// --------------------------------------------------------
+// Finds the next '\n' at or after p, or end if there isn't one.
+// Compares 16 bytes at a time, since most of an OBJ is numbers
+// and the lines are short.
+// --------------------------------------------------------
+static const char* FindNewline(const char* p, const char* end)
+{
+	const __m128i newline = _mm_set1_epi8('\n');
+
+	while (end - p >= 16)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+		if (mask)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, (unsigned long)mask);
+			return p + bit;
+		}
+		p += 16;
+	}
+
+	while (p < end && *p != '\n')
+		p++;
+
+	return p;
+}
+
+static inline bool IsDigit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+static inline void SkipSpaces(const char*& p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+}
+
+static inline void SkipToSpace(const char*& p, const char* end)
+{
+	while (p < end && *p != ' ' && *p != '\t')
+		p++;
+}
+
+// Whether the line at p starts with keyword as a whole word
+static inline bool IsKeyword(const char* p, const char* lineEnd, const char* keyword, size_t length)
+{
+	if ((size_t)(lineEnd - p) < length || memcmp(p, keyword, length) != 0)
+		return false;
+
+	return lineEnd - p == (ptrdiff_t)length || p[length] == ' ' || p[length] == '\t' || p[length] == '\r';
+}
+
+// --------------------------------------------------------
+// The rest of the line, without surrounding whitespace
+// --------------------------------------------------------
+static std::string ParseName(const char* p, const char* lineEnd)
+{
+	SkipSpaces(p, lineEnd);
+
+	const char* last = lineEnd;
+	while (last > p && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+		last--;
+
+	return std::string(p, last);
+}
+
+static double Pow10(int exponent)
+{
+	// Every power up to 22 is exactly representable as a double
+	static const double table[] =
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+		1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+		1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	if (exponent <= 22)
+		return table[exponent];
+
+	return pow(10.0, exponent);
+}
+
+// --------------------------------------------------------
+// Whether rounding d to a float could differ from rounding
+// the decimal it came from: d sits exactly halfway between
+// two floats, or outside the normal ones
+// --------------------------------------------------------
+static bool IsFloatRoundingUnsafe(double d)
+{
+	if (d != 0 && (d < FLT_MIN || d > FLT_MAX))
+		return true;
+
+	// The 29 bits a double has past a float's mantissa
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return (bits & 0x1FFFFFFF) == 0x10000000;
+}
+
+// --------------------------------------------------------
+// Parses the formats exporters actually write:
+// [sign] digits [. digits] [e|E [sign] digits]
+//
+// Accumulates up to 19 significant digits into an integer and
+// applies the decimal exponent once, in double precision.
+// That's exact, and so is the one rounding to double, when
+// the digits fit in 53 bits and the power of ten is exact.
+// Rounding that double to a float then only goes wrong when
+// it's exactly halfway between two floats.  Anything else is
+// rare enough to hand to strtof, so every float comes out as
+// sscanf would have read it.
+// --------------------------------------------------------
+float ObjLoader::ParseFloat(const char*& p, const char* end)
+{
+	SkipSpaces(p, end);
+	const char* start = p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+
+	// Integer part
+	for (; p < end && IsDigit(*p); p++)
+	{
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) significantDigits++;
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+
+	// Fractional part
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && IsDigit(*p); p++)
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) significantDigits++;
+				exponent--;
+			}
+		}
+	}
+
+	// Exponent
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExponent = (*p == '-');
+			p++;
+		}
+
+		int value = 0;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			if (value < 10000)
+				value = value * 10 + (*p - '0');
+		}
+
+		exponent += negativeExponent ? -value : value;
+	}
+
+	if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double result = (double)mantissa;
+		if (exponent < 0)
+			result /= Pow10(-exponent);
+		else if (exponent > 0)
+			result *= Pow10(exponent);
+
+		if (!IsFloatRoundingUnsafe(result))
+			return (float)(negative ? -result : result);
+	}
+
+	return strtof(std::string(start, p).c_str(), 0);
+}
+
+// --------------------------------------------------------
+// Parses a (possibly negative) integer.  Returns 0, which is
+// never a valid OBJ index, if there are no digits.  Too many
+// digits stop at INT_MAX rather than wrapping around, which
+// keeps the index past the end of any list.
+// --------------------------------------------------------
+static int ParseInt(const char*& p, const char* end)
+{
+	bool negative = false;
+	if (p < end && *p == '-')
+	{
+		negative = true;
+		p++;
+	}
+
+	int value = 0;
+	for (; p < end && IsDigit(*p); p++)
+	{
+		int digit = *p - '0';
+		value = value > (INT_MAX - digit) / 10 ? INT_MAX : value * 10 + digit;
+	}
+
+	return negative ? -value : value;
+}
+
+// --------------------------------------------------------
+// Converts a 1-based (or negative, relative) OBJ index into
+// a 0-based one given the number of elements read so far in
+// this chunk.  Sets the relative bit when the chunk's base
+// will have to be added later.
+// --------------------------------------------------------
+static inline int ResolveIndex(int index, size_t count, int relativeBit, int& relative)
+{
+	if (index > 0) return index - 1;
+	if (index == 0) return -1;
+
+	relative |= relativeBit;
+	return (int)count + index;
+}
+
+// --------------------------------------------------------
+// Parses "v", "v/vt", "v//vn" or "v/vt/vn"
+// --------------------------------------------------------
+static ObjCorner ParseCorner(const char*& p, const char* end, ObjChunk& chunk)
+{
+	ObjCorner corner;
+	corner.Relative = 0;
+	corner.Position = ResolveIndex(ParseInt(p, end), chunk.Positions.size(), OBJ_RELATIVE_POSITION, corner.Relative);
+	corner.UV = -1;
+	corner.Normal = -1;
+
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/')
+			corner.UV = ResolveIndex(ParseInt(p, end), chunk.UVs.size(), OBJ_RELATIVE_UV, corner.Relative);
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			corner.Normal = ResolveIndex(ParseInt(p, end), chunk.Normals.size(), OBJ_RELATIVE_NORMAL, corner.Relative);
+		}
+	}
+
+	// Ignore anything else stuck to this corner
+	SkipToSpace(p, end);
+	return corner;
+}
+
+// --------------------------------------------------------
+// Parses every record in [chunk.Start, chunk.End), which must
+// begin at the start of a line
+// --------------------------------------------------------
+static void ParseChunk(ObjChunk& chunk)
+{
+	std::vector<ObjCorner> face;         // Corners of the face being read
+
+	const char* p = chunk.Start;
+	const char* end = chunk.End;
+
+	while (p < end)
+	{
+		const char* lineEnd = FindNewline(p, end);
+
+		SkipSpaces(p, lineEnd);
+
+		// Check the type of line
+		if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == 'n')
+		{
+			p += 2;
+			XMFLOAT3 norm;
+			norm.x = ObjLoader::ParseFloat(p, lineEnd);
+			norm.y = ObjLoader::ParseFloat(p, lineEnd);
+			norm.z = ObjLoader::ParseFloat(p, lineEnd);
+			chunk.Normals.push_back(norm);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'v' && p[1] == 't')
+		{
+			p += 2;
+			XMFLOAT2 uv;
+			uv.x = ObjLoader::ParseFloat(p, lineEnd);
+			uv.y = ObjLoader::ParseFloat(p, lineEnd);
+			chunk.UVs.push_back(uv);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 1;
+			XMFLOAT3 pos;
+			pos.x = ObjLoader::ParseFloat(p, lineEnd);
+			pos.y = ObjLoader::ParseFloat(p, lineEnd);
+			pos.z = ObjLoader::ParseFloat(p, lineEnd);
+			chunk.Positions.push_back(pos);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			p += 1;
+			face.clear();
+
+			for (;;)
+			{
+				SkipSpaces(p, lineEnd);
+				if (p >= lineEnd || !(IsDigit(*p) || *p == '-'))
+					break;
+
+				face.push_back(ParseCorner(p, lineEnd, chunk));
+			}
+
+			// Triangulate as a fan, flipping the winding order
+			// (the original loader's quad split is the n = 4 case)
+			for (size_t i = 1; i + 1 < face.size(); i++)
+			{
+				chunk.Corners.push_back(face[0]);
+				chunk.Corners.push_back(face[i + 1]);
+				chunk.Corners.push_back(face[i]);
+			}
+		}
+		else if (IsKeyword(p, lineEnd, "usemtl", 6))
+		{
+			ObjNameStart material = { ParseName(p + 6, lineEnd), chunk.Corners.size() };
+			chunk.Materials.push_back(material);
+		}
+		else if (IsKeyword(p, lineEnd, "g", 1))
+		{
+			ObjNameStart group = { ParseName(p + 1, lineEnd), chunk.Corners.size() };
+			chunk.Groups.push_back(group);
+		}
+
+		p = lineEnd + 1;
+	}
+}
+
+static inline unsigned int HashCorner(const ObjCorner& c)
+{
+	unsigned int h = (unsigned int)c.Position * 0x9E3779B1u;
+	h ^= (unsigned int)c.UV * 0x85EBCA77u;
+	h ^= (unsigned int)c.Normal * 0xC2B2AE3Du;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 13;
+	return h;
+}
+
+static inline bool SameCorner(const ObjCorner& a, const ObjCorner& b)
+{
+	return a.Position == b.Position && a.UV == b.UV && a.Normal == b.Normal;
+}
+
+// --------------------------------------------------------
+// Builds a remap from every attribute to the first attribute
+// with exactly the same bits.  Many exporters write one normal
+// (or uv) per face corner, so welding on indices alone would
+// find almost nothing to share.
+// --------------------------------------------------------
+template <typename T>
+static void FindDuplicateAttributes(const std::vector<T>& values, std::vector<int>& remap)
+{
+	const int floatCount = sizeof(T) / sizeof(unsigned int);
+
+	size_t capacity = 16;
+	while (capacity < values.size() * 2)
+		capacity *= 2;
+
+	std::vector<int> table(capacity, -1);
+	size_t mask = capacity - 1;
+
+	remap.resize(values.size());
+
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		const unsigned int* bits = (const unsigned int*)&values[i];
+
+		unsigned int h = 0;
+		for (int f = 0; f < floatCount; f++)
+			h = (h ^ bits[f]) * 0x9E3779B1u;
+		h ^= h >> 16;
+
+		size_t slot = h & mask;
+		while (table[slot] != -1 && memcmp(&values[table[slot]], &values[i], sizeof(T)) != 0)
+			slot = (slot + 1) & mask;
+
+		if (table[slot] == -1)
+			table[slot] = (int)i;
+
+		remap[i] = table[slot];
+	}
+}
+
+static inline int Remap(int index, const std::vector<int>& remap)
+{
+	return (size_t)index < remap.size() ? remap[index] : -1;
+}
+
+// --------------------------------------------------------
+// Collapses identical corners into one vertex each, in order
+// of first use.  Open addressing with linear probing over a
+// power-of-two table that's kept at most half full.
+// --------------------------------------------------------
+static void WeldCorners(const std::vector<ObjCorner>& corners, std::vector<ObjCorner>& unique, std::vector<UINT>& indices)
+{
+	size_t capacity = 16;
+	while (capacity < corners.size() * 2)
+		capacity *= 2;
+
+	const UINT empty = 0xFFFFFFFF;
+	std::vector<UINT> table(capacity, empty);
+	size_t mask = capacity - 1;
+
+	unique.clear();
+	unique.reserve(corners.size() / 4 + 16);
+	indices.resize(corners.size());
+
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		const ObjCorner& corner = corners[i];
+		size_t slot = HashCorner(corner) & mask;
+
+		while (table[slot] != empty && !SameCorner(unique[table[slot]], corner))
+			slot = (slot + 1) & mask;
+
+		if (table[slot] == empty)
+		{
+			table[slot] = (UINT)unique.size();
+			unique.push_back(corner);
+		}
+
+		indices[i] = table[slot];
+	}
+}
+
+// --------------------------------------------------------
+// Gives every triangle the slot of the material (or group)
+// it was read under, and sorts the triangles by slot while
+// keeping their order within each.  Fills in each submesh's
+// LOD 0 range.
+// --------------------------------------------------------
+static void SortIntoSubmeshes(const std::vector<ObjChunk>& chunks, std::vector<ObjCorner>& corners, std::vector<MeshSubmesh>& submeshes)
+{
+	// Materials decide the submeshes when there are any
+	bool useMaterials = false;
+	for (size_t i = 0; i < chunks.size(); i++)
+		useMaterials |= !chunks[i].Materials.empty();
+
+	std::vector<ObjNameStart> names;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		const std::vector<ObjNameStart>& starts = useMaterials ? chunks[i].Materials : chunks[i].Groups;
+		for (size_t n = 0; n < starts.size(); n++)
+		{
+			ObjNameStart start = { starts[n].Name, starts[n].FirstCorner + chunks[i].CornerBase };
+			names.push_back(start);
+		}
+	}
+
+	// Slots go in order of first use, and names without
+	// any faces (or faces before any name) don't get one
+	size_t triangleNum = corners.size() / 3;
+	std::unordered_map<std::string, UINT> slotLookup;
+	std::vector<UINT> slotCounts;
+	std::vector<UINT> slots(triangleNum);
+	std::string current;
+	int currentSlot = -1;
+	size_t next = 0;
+
+	for (size_t t = 0; t < triangleNum; t++)
+	{
+		while (next < names.size() && names[next].FirstCorner <= t * 3)
+		{
+			current = names[next++].Name;
+			currentSlot = -1;
+		}
+
+		if (currentSlot < 0)
+		{
+			auto found = slotLookup.insert(std::make_pair(current, (UINT)slotCounts.size()));
+			if (found.second)
+				slotCounts.push_back(0);
+			currentSlot = (int)found.first->second;
+		}
+
+		slots[t] = (UINT)currentSlot;
+		slotCounts[currentSlot]++;
+	}
+
+	MeshSubmesh empty = {};
+	submeshes.assign(slotCounts.size(), empty);
+
+	UINT start = 0;
+	for (size_t i = 0; i < submeshes.size(); i++)
+	{
+		submeshes[i].MaterialSlot = (UINT)i;
+		submeshes[i].StartIndex[0] = start;
+		submeshes[i].IndexCount[0] = slotCounts[i] * 3;
+		start += slotCounts[i] * 3;
+	}
+
+	if (submeshes.size() < 2)
+		return;
+
+	// Stable counting sort into each slot's range
+	std::vector<ObjCorner> sorted(corners.size());
+	std::vector<UINT> cursors(submeshes.size());
+	for (size_t i = 0; i < submeshes.size(); i++)
+		cursors[i] = submeshes[i].StartIndex[0];
+
+	for (size_t t = 0; t < triangleNum; t++)
+	{
+		UINT& cursor = cursors[slots[t]];
+		sorted[cursor] = corners[t * 3];
+		sorted[cursor + 1] = corners[t * 3 + 1];
+		sorted[cursor + 2] = corners[t * 3 + 2];
+		cursor += 3;
+	}
+
+	corners.swap(sorted);
+}
+
+bool ObjLoader::Load(const char * path, std::vector<Vertex>& verts, std::vector<UINT>& indices, std::vector<MeshSubmesh>& submeshes, int threadCount)
+{
+	MappedFile file(path);
+
+	// Check for successful open
+	if (!file.IsOpen())
+		return false;
+
+	Parse(file.GetData(), file.GetSize(), verts, indices, submeshes, threadCount);
+	return true;
+}
+
+void ObjLoader::Parse(const char * data, size_t size, std::vector<Vertex>& verts, std::vector<UINT>& indices, std::vector<MeshSubmesh>& submeshes, int threadCount)
+{
+	// Pick a worker count, keeping every chunk big enough to be
+	// worth a thread.  A single chunk is the serial path, and goes
+	// through exactly the same merge so the results are identical.
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+
+	int maxChunks = (int)(size / OBJ_MIN_CHUNK_SIZE);
+	int chunkCount = max(1, min(threadCount, maxChunks));
+
+	// Split the file into line-aligned chunks
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* start = data;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = end;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = data + size * (i + 1) / chunkCount;
+			if (chunkEnd < start) chunkEnd = start;
+			chunkEnd = FindNewline(chunkEnd, end);
+			if (chunkEnd < end) chunkEnd++;
+		}
+
+		chunks[i].Start = start;
+		chunks[i].End = chunkEnd;
+		start = chunkEnd;
+	}
+
+	// Phase 1: parse every chunk on its own
+	WorkerPool::RunParallel(chunkCount, [&chunks](int i) { ParseChunk(chunks[i]); });
+
+	// Prefix sum of the attribute and corner counts gives every
+	// chunk its place in the merged arrays
+	size_t positionCount = 0;
+	size_t normalCount = 0;
+	size_t uvCount = 0;
+	size_t cornerCount = 0;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		chunks[i].PositionBase = positionCount;
+		chunks[i].NormalBase = normalCount;
+		chunks[i].UVBase = uvCount;
+		chunks[i].CornerBase = cornerCount;
+
+		positionCount += chunks[i].Positions.size();
+		normalCount += chunks[i].Normals.size();
+		uvCount += chunks[i].UVs.size();
+		cornerCount += chunks[i].Corners.size();
+	}
+
+	std::vector<XMFLOAT3> positions(positionCount);
+	std::vector<XMFLOAT3> normals(normalCount);
+	std::vector<XMFLOAT2> uvs(uvCount);
+	std::vector<ObjCorner> corners(cornerCount);
+
+	// Phase 2: gather attributes and resolve relative indices
+	WorkerPool::RunParallel(chunkCount, [&](int i)
+	{
+		ObjChunk& chunk = chunks[i];
+
+		std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + chunk.PositionBase);
+		std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + chunk.NormalBase);
+		std::copy(chunk.UVs.begin(), chunk.UVs.end(), uvs.begin() + chunk.UVBase);
+
+		for (size_t c = 0; c < chunk.Corners.size(); c++)
+		{
+			ObjCorner corner = chunk.Corners[c];
+			if (corner.Relative & OBJ_RELATIVE_POSITION) corner.Position += (int)chunk.PositionBase;
+			if (corner.Relative & OBJ_RELATIVE_UV) corner.UV += (int)chunk.UVBase;
+			if (corner.Relative & OBJ_RELATIVE_NORMAL) corner.Normal += (int)chunk.NormalBase;
+			corners[chunk.CornerBase + c] = corner;
+		}
+	});
+
+	// Phase 3: one run of triangles per material
+	SortIntoSubmeshes(chunks, corners, submeshes);
+
+	// Phase 4: weld identical position/uv/normal triples into
+	// shared verts, so the index buffer actually indexes.
+	// Duplicate attribute values are folded together first so
+	// corners match on value rather than on file index.
+	std::vector<int> positionRemap;
+	std::vector<int> uvRemap;
+	std::vector<int> normalRemap;
+	FindDuplicateAttributes(positions, positionRemap);
+	FindDuplicateAttributes(uvs, uvRemap);
+	FindDuplicateAttributes(normals, normalRemap);
+
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		corners[i].Position = Remap(corners[i].Position, positionRemap);
+		corners[i].UV = Remap(corners[i].UV, uvRemap);
+		corners[i].Normal = Remap(corners[i].Normal, normalRemap);
+	}
+
+	std::vector<ObjCorner> unique;
+	WeldCorners(corners, unique, indices);
+
+	// Phase 5: build the verts
+	// - Create the verts by looking up corresponding data from vectors
+	// - The model is most likely in a right-handed space, especially if
+	//    it came from Maya.  We want to convert to a left-handed space for
+	//    DirectX, so invert the Z position and the normal's Z (the winding
+	//    order was already flipped while parsing)
+	// - We also need to flip the UV coordinate since DirectX defines (0,0)
+	//    as the top left of the texture, and many 3D modeling packages use
+	//    the bottom left as (0,0)
+	verts.resize(unique.size());
+
+	WorkerPool::RunParallel(chunkCount, [&](int chunkIndex)
+	{
+		size_t first = unique.size() * chunkIndex / chunkCount;
+		size_t last = unique.size() * (chunkIndex + 1) / chunkCount;
+
+		for (size_t i = first; i < last; i++)
+		{
+			const ObjCorner& c = unique[i];
+			Vertex& v = verts[i];
+
+			v.Position = (size_t)c.Position < positions.size() ? positions[c.Position] : XMFLOAT3(0, 0, 0);
+			v.UV = (size_t)c.UV < uvs.size() ? uvs[c.UV] : XMFLOAT2(0, 0);
+			v.Normal = (size_t)c.Normal < normals.size() ? normals[c.Normal] : XMFLOAT3(0, 0, 0);
+			v.Tangent = XMFLOAT3(0, 0, 0);
+
+			v.UV.y = 1.0f - v.UV.y;
+			v.Position.z *= -1.0f;
+			v.Normal.z *= -1.0f;
+		}
+	});
+}
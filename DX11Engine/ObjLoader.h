@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Vertex.h"
+#include "MeshSimplifier.h"
+#include <vector>
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// Wavefront OBJ parser
+//
+// Memory maps the file and parses it in place, without
+// going through iostreams or the CRT's scanf, so load
+// time is bound by I/O rather than by text parsing.
+//
+// Produces the same triangles the original getline/sscanf_s
+// loop did: converted to a left-handed space, V flipped and
+// the winding order reversed.  Corners that share the same
+// v/vt/vn triple are welded into a single vertex.
+//
+// Faces are grouped into one submesh per "usemtl" material,
+// or per "g" group in files without materials, in order of
+// each name's first use, which is also its material slot.
+// Triangles are sorted so every submesh is one run of
+// indices; only LOD 0's range of each is filled in.
+//
+// Large files are split into line-aligned chunks that are
+// parsed on separate threads and merged afterwards; the
+// output is identical to the single-threaded path.
+// threadCount = 0 uses every hardware thread.
+// --------------------------------------------------------
+class ObjLoader
+{
+public:
+	static bool Load(const char* path, std::vector<Vertex>& verts, std::vector<UINT>& indices, std::vector<MeshSubmesh>& submeshes, int threadCount = 0);
+	static void Parse(const char* data, size_t size, std::vector<Vertex>& verts, std::vector<UINT>& indices, std::vector<MeshSubmesh>& submeshes, int threadCount = 0);
+
+	// One number as Parse reads it, the same float strtof gives,
+	// moving p past it
+	static float ParseFloat(const char*& p, const char* end);
+};
@@ -0,0 +1,68 @@
+// Constant Buffer
+// - Same as VertexShader.hlsl, plus the mesh's position range
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix view;
+	matrix projection;
+
+	float2 uvScale;
+
+	float3 positionOffset;
+	float3 positionScale;
+};
+
+// Matches PackedVertex in Vertex.h, with the input layout from
+// VertexPacking doing the UNORM/SNORM/half conversions for us
+struct VertexShaderInput
+{
+	float4 position		: POSITION;		// 0-1 across the mesh's bounds
+	float2 normal		: NORMAL;		// Octahedral
+	float2 tangent		: TANGENT;		// Octahedral
+	float2 uv			: TEXCOORD;
+};
+
+// Same output as VertexShader.hlsl, so DeferredPS works with either
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;	// XYZW position (System Value Position)
+	float3 normal		: NORMAL;
+	float3 tangent		: TANGENT;
+	float2 uv			: TEXCOORD0;
+	float depth			: TEXCOORD1;
+};
+
+// --------------------------------------------------------
+// Unfolds an octahedral encoded direction back onto the
+// sphere (must match VertexPacking::DecodeOctahedral)
+// --------------------------------------------------------
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 n = float3(encoded.x, encoded.y, 1.0f - abs(encoded.x) - abs(encoded.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	float3 position = positionOffset + input.position.xyz * positionScale;
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(position, 1.0f), worldViewProj);
+
+	output.normal = normalize(mul(DecodeOctahedral(input.normal), (float3x3)world));
+	output.tangent = mul(DecodeOctahedral(input.tangent), (float3x3)world);
+
+	output.uv = input.uv * uvScale;
+
+	output.depth = output.position.z / output.position.w;
+
+	return output;
+}
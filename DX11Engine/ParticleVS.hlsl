@@ -5,14 +5,16 @@ cbuffer externalData : register(b0)
 	matrix projection;
 };
 
-// Describes individual vertex data
+// A corner of the shared quad, and the particle it's drawn
+// for.  The _PER_INSTANCE inputs come from the second slot,
+// laid out like ParticleInstance.
 struct VertexShaderInput
 {
-	float3 position		: POSITION;
 	float2 uv			: TEXCOORD;
-	float4 color		: COLOR;
-	float size : SIZE;
-	float rotation : ROTATION;
+	float3 position		: POSITION_PER_INSTANCE;
+	float4 color		: COLOR_PER_INSTANCE;
+	float size			: SIZE_PER_INSTANCE;
+	float rotation		: ROTATION_PER_INSTANCE;
 };
 
 // Defines the output data of our vertex shader
@@ -1,6 +1,6 @@
 #include "PointLight.h"
 
-PointLight::PointLight(XMFLOAT4X4 world, Mesh* iMesh, ID3D11ShaderResourceView* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot, float iRange) :
+PointLight::PointLight(XMFLOAT4X4 world, ProxyMesh* iMesh, TextureHandle* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot, float iRange) :
 	Light(world, iMesh, sky, vs, ps, sample, ambient, diffuse, pos, rot, XMFLOAT3(2 * iRange, 2 * iRange, 2 * iRange))
 {
 	range = iRange;
@@ -27,7 +27,7 @@ void PointLight::PrepareShader(Camera* camera, ID3D11ShaderResourceView* albedo,
 	pixelShader->SetShaderResourceView("normalBuffer", normal);
 	pixelShader->SetShaderResourceView("pbrBuffer", pbr);
 	pixelShader->SetShaderResourceView("depthBuffer", depth);
-	pixelShader->SetShaderResourceView("SkyTexture", skybox);
+	pixelShader->SetShaderResourceView("SkyTexture", skybox->View);
 	pixelShader->SetMatrix4x4("inView", camera->inverseViewMat);
 	pixelShader->SetMatrix4x4("inProjection", camera->inverseProjMat);
 
@@ -43,4 +43,9 @@ void PointLight::PrepareShader(Camera* camera, ID3D11ShaderResourceView* albedo,
 	//  - If you skip this, the "SetMatrix" calls above won't make it to the GPU!
 	vertexShader->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
+}
+
+void PointLight::GetWorldBounds(BoundingBox & box, BoundingSphere & sphere)
+{
+	mesh->GetWorldBounds(worldMatrix, box, sphere);
 }
\ No newline at end of file
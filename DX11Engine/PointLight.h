@@ -6,10 +6,13 @@
 class PointLight : public Light
 {
 public:
-	PointLight(XMFLOAT4X4 iWorld, Mesh* iMesh, ID3D11ShaderResourceView* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot, float iRange);
+	PointLight(XMFLOAT4X4 iWorld, ProxyMesh* iMesh, TextureHandle* sky, SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11SamplerState* sample, XMFLOAT4 ambient, XMFLOAT4 diffuse, XMFLOAT3 pos, XMFLOAT3 rot, float iRange);
 	~PointLight();
 
 	void PrepareShader(Camera* camera, ID3D11ShaderResourceView* albedo, ID3D11ShaderResourceView* normal, ID3D11ShaderResourceView* pbr, ID3D11ShaderResourceView* depth);
 
+	// Bounds of the light's volume, which covers everything it lights
+	void GetWorldBounds(BoundingBox& box, BoundingSphere& sphere);
+
 	float range;
 };
\ No newline at end of file
@@ -18,10 +18,7 @@ cbuffer externalData : register(b0)
 // - Each variable must have a semantic, which defines its usage
 struct VertexShaderInput
 {
-	float3 position		: POSITION;
-	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
-	float2 uv			: TEXCOORD;
+	float3 position		: POSITION;		// Light volumes only bind positions
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -54,7 +51,7 @@ VertexToPixel main(VertexShaderInput input)
 
 	output.worldPos = mul(float4(input.position, 1.0f), world).xyz;
 
-	output.uv = input.uv;
+	output.uv = float2(0, 0);
 
 	output.screenPos = output.position;
 
@@ -0,0 +1,207 @@
+#include "ProxyMesh.h"
+#include <map>
+
+ProxyMesh::ProxyMesh(const XMFLOAT3 * positions, int vertNum, const unsigned short * indices, int indexNum, ID3D11Device * device)
+{
+	numIndices = indexNum;
+
+	BoundingBox::CreateFromPoints(boundingBox, vertNum, positions, sizeof(XMFLOAT3));
+	BoundingSphere::CreateFromPoints(boundingSphere, vertNum, positions, sizeof(XMFLOAT3));
+
+	// Never changes, so both buffers are immutable
+	D3D11_BUFFER_DESC vbd = {};
+	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(XMFLOAT3) * vertNum;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA initialVertexData = {};
+	initialVertexData.pSysMem = positions;
+
+	device->CreateBuffer(&vbd, &initialVertexData, &vertexBuffer);
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(unsigned short) * indexNum;
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA initialIndexData = {};
+	initialIndexData.pSysMem = indices;
+
+	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
+}
+
+ProxyMesh::~ProxyMesh()
+{
+	if (vertexBuffer) { vertexBuffer->Release(); }
+	if (indexBuffer) { indexBuffer->Release(); }
+}
+
+ProxyMesh * ProxyMesh::CreateIcosphere(ID3D11Device * device, float radius, float overshoot)
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned short> indices;
+	BuildIcosphere(ChooseSubdivisions(overshoot), radius, positions, indices);
+
+	return new ProxyMesh(&positions[0], (int)positions.size(), &indices[0], (int)indices.size(), device);
+}
+
+ProxyMesh * ProxyMesh::CreateCube(ID3D11Device * device, float halfSize)
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned short> indices;
+	BuildCube(halfSize, positions, indices);
+
+	return new ProxyMesh(&positions[0], (int)positions.size(), &indices[0], (int)indices.size(), device);
+}
+
+// Distance from the origin to the closest triangle's plane
+static float CalculateInradius(const std::vector<XMFLOAT3>& positions, const std::vector<unsigned short>& indices)
+{
+	float inradius = FLT_MAX;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		XMVECTOR a = XMLoadFloat3(&positions[indices[i]]);
+		XMVECTOR b = XMLoadFloat3(&positions[indices[i + 1]]);
+		XMVECTOR c = XMLoadFloat3(&positions[indices[i + 2]]);
+
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(b - a, c - a));
+		inradius = min(inradius, fabsf(XMVectorGetX(XMVector3Dot(normal, a))));
+	}
+
+	return inradius;
+}
+
+// --------------------------------------------------------
+// Splits every triangle of a unit icosahedron into four,
+// subdivisions times, pushing the new verts out onto the
+// unit sphere.  The faces then sit slightly inside it, so
+// the whole thing is scaled up until the closest face is
+// radius away.
+// --------------------------------------------------------
+void ProxyMesh::BuildIcosphere(int subdivisions, float radius, std::vector<XMFLOAT3>& positions, std::vector<unsigned short>& indices)
+{
+	const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+	const XMFLOAT3 corners[12] =
+	{
+		XMFLOAT3(-1, t, 0), XMFLOAT3(1, t, 0), XMFLOAT3(-1, -t, 0), XMFLOAT3(1, -t, 0),
+		XMFLOAT3(0, -1, t), XMFLOAT3(0, 1, t), XMFLOAT3(0, -1, -t), XMFLOAT3(0, 1, -t),
+		XMFLOAT3(t, 0, -1), XMFLOAT3(t, 0, 1), XMFLOAT3(-t, 0, -1), XMFLOAT3(-t, 0, 1)
+	};
+	const unsigned short faces[60] =
+	{
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1
+	};
+
+	positions.clear();
+	for (int i = 0; i < 12; i++)
+	{
+		XMFLOAT3 p;
+		XMStoreFloat3(&p, XMVector3Normalize(XMLoadFloat3(&corners[i])));
+		positions.push_back(p);
+	}
+	indices.assign(faces, faces + 60);
+
+	for (int s = 0; s < subdivisions; s++)
+	{
+		// Each edge's midpoint, shared by the triangles on both sides
+		std::map<std::pair<unsigned short, unsigned short>, unsigned short> midpoints;
+		auto midpoint = [&](unsigned short a, unsigned short b)
+		{
+			std::pair<unsigned short, unsigned short> edge(min(a, b), max(a, b));
+			auto found = midpoints.find(edge);
+			if (found != midpoints.end())
+				return found->second;
+
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3Normalize(XMLoadFloat3(&positions[a]) + XMLoadFloat3(&positions[b])));
+			positions.push_back(p);
+
+			unsigned short index = (unsigned short)(positions.size() - 1);
+			midpoints[edge] = index;
+			return index;
+		};
+
+		std::vector<unsigned short> split;
+		split.reserve(indices.size() * 4);
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			unsigned short a = indices[i];
+			unsigned short b = indices[i + 1];
+			unsigned short c = indices[i + 2];
+			unsigned short ab = midpoint(a, b);
+			unsigned short bc = midpoint(b, c);
+			unsigned short ca = midpoint(c, a);
+
+			unsigned short tris[12] = { a, ab, ca,	b, bc, ab,	c, ca, bc,	ab, bc, ca };
+			split.insert(split.end(), tris, tris + 12);
+		}
+		indices.swap(split);
+	}
+
+	float scale = radius / CalculateInradius(positions, indices);
+	for (size_t i = 0; i < positions.size(); i++)
+		XMStoreFloat3(&positions[i], XMLoadFloat3(&positions[i]) * scale);
+}
+
+void ProxyMesh::BuildCube(float halfSize, std::vector<XMFLOAT3>& positions, std::vector<unsigned short>& indices)
+{
+	positions.clear();
+	for (int i = 0; i < 8; i++)
+		positions.push_back(XMFLOAT3((i & 1) ? halfSize : -halfSize, (i & 2) ? halfSize : -halfSize, (i & 4) ? halfSize : -halfSize));
+
+	// Two triangles a side: -x, +x, -y, +y, -z, +z
+	const unsigned short faces[36] =
+	{
+		0, 4, 6,	0, 6, 2,
+		1, 3, 7,	1, 7, 5,
+		0, 1, 5,	0, 5, 4,
+		2, 6, 7,	2, 7, 3,
+		0, 2, 3,	0, 3, 1,
+		4, 5, 7,	4, 7, 6
+	};
+	indices.assign(faces, faces + 36);
+}
+
+int ProxyMesh::ChooseSubdivisions(float overshoot)
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned short> indices;
+
+	for (int s = 0; s < PROXY_MAX_SUBDIVISIONS; s++)
+	{
+		// Every vert is equally far out, so any one is the farthest
+		BuildIcosphere(s, 1.0f, positions, indices);
+		if (XMVectorGetX(XMVector3Length(XMLoadFloat3(&positions[0]))) <= 1.0f + overshoot)
+			return s;
+	}
+
+	return PROXY_MAX_SUBDIVISIONS;
+}
+
+void ProxyMesh::Bind(ID3D11DeviceContext * context)
+{
+	UINT stride = sizeof(XMFLOAT3);
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R16_UINT, 0);
+}
+
+int ProxyMesh::GetIndexCount()
+{
+	return numIndices;
+}
+
+const BoundingSphere & ProxyMesh::GetBoundingSphere()
+{
+	return boundingSphere;
+}
+
+void ProxyMesh::GetWorldBounds(XMFLOAT4X4 world, BoundingBox & box, BoundingSphere & sphere)
+{
+	XMMATRIX W = XMMatrixTranspose(XMLoadFloat4x4(&world));
+	boundingBox.Transform(box, W);
+	boundingSphere.Transform(sphere, W);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Most subdivisions CreateIcosphere will use (5120 triangles)
+#define PROXY_MAX_SUBDIVISIONS	4
+
+// How far past its radius a light volume may reach, as a
+// fraction of the radius.  Every extra pixel it covers runs
+// the light's pixel shader for nothing.
+#define PROXY_SPHERE_OVERSHOOT	0.1f
+
+// --------------------------------------------------------
+// Position-only geometry with 16-bit indices, for passes
+// that only need a shape: light volumes and the skybox.
+// Built procedurally, so it's ready before any asset loads
+// and fetches 12 bytes a vertex.
+//
+// Triangles are wound like the rest of the engine's meshes,
+// clockwise seen from outside.
+// --------------------------------------------------------
+class ProxyMesh
+{
+public:
+	ProxyMesh(const XMFLOAT3* positions, int vertNum, const unsigned short* indices, int indexNum, ID3D11Device* device);
+	~ProxyMesh();
+
+	// An icosphere with every face at least radius from its
+	// centre, so it covers that sphere completely, subdivided
+	// just enough to reach no further than radius * (1 + overshoot)
+	static ProxyMesh* CreateIcosphere(ID3D11Device* device, float radius, float overshoot = PROXY_SPHERE_OVERSHOOT);
+	static ProxyMesh* CreateCube(ID3D11Device* device, float halfSize);
+
+	static void BuildIcosphere(int subdivisions, float radius, std::vector<XMFLOAT3>& positions, std::vector<unsigned short>& indices);
+	static void BuildCube(float halfSize, std::vector<XMFLOAT3>& positions, std::vector<unsigned short>& indices);
+
+	// Fewest subdivisions whose icosphere, pushed out to cover
+	// the unit sphere, stays within 1 + overshoot of it
+	static int ChooseSubdivisions(float overshoot);
+
+	void Bind(ID3D11DeviceContext* context);
+	int GetIndexCount();
+
+	// Model space bounds of every vert
+	const BoundingSphere& GetBoundingSphere();
+
+	// The same bounds moved by world (transposed, as stored by GameObject)
+	void GetWorldBounds(XMFLOAT4X4 world, BoundingBox& box, BoundingSphere& sphere);
+
+private:
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+	int numIndices;
+
+	BoundingBox boundingBox;
+	BoundingSphere boundingSphere;
+};
@@ -7,10 +7,7 @@ cbuffer externalData : register(b0)
 
 struct VertexShaderInput
 {
-	float3 position		: POSITION;     // XYZ position
-	float3 normal		: NORMAL;
-	float3 tangent		: TANGENT;
-	float2 uv			: TEXCOORD;
+	float3 position		: POSITION;     // XYZ position, the only stream bound
 };
 
 struct VertexToPixel
@@ -0,0 +1,133 @@
+#include "TangentGenerator.h"
+#include "WorkerPool.h"
+#include <vector>
+#include <thread>
+#include <cmath>
+
+// Removes the normal's part of a summed tangent and normalizes
+// what's left.  Verts with no usable UV direction get any
+// tangent perpendicular to the normal instead of garbage.
+static XMFLOAT3 Orthonormalize(XMFLOAT3 normal, XMVECTOR tangent)
+{
+	XMVECTOR n = XMLoadFloat3(&normal);
+	XMVECTOR t = tangent - n * XMVector3Dot(n, tangent);
+
+	if (XMVectorGetX(XMVector3LengthSq(t)) < 1e-12f)
+	{
+		XMVECTOR axis = fabsf(normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+		t = XMVector3Cross(n, axis);
+	}
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3Normalize(t));
+	return result;
+}
+
+// --------------------------------------------------------
+// Works out the tangents of triangles [first, last) four at
+// a time and adds each to its three verts' sums.  Lanes past
+// the end repeat the last triangle and are dropped.
+// --------------------------------------------------------
+static void AccumulateTriangleTangents(const Vertex* vertices, const UINT* indices, int first, int last, XMFLOAT3* sums)
+{
+	for (int t = first; t < last; t += 4)
+	{
+		// Each triangle's edges and UV deltas in vectors of their own
+		XMVECTOR edges1[4];
+		XMVECTOR edges2[4];
+		XMVECTOR uvDeltas[4];
+		for (int l = 0; l < 4; l++)
+		{
+			const UINT* corners = indices + min(t + l, last - 1) * 3;
+			const Vertex& v1 = vertices[corners[0]];
+			const Vertex& v2 = vertices[corners[1]];
+			const Vertex& v3 = vertices[corners[2]];
+
+			XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+			edges1[l] = XMLoadFloat3(&v2.Position) - p1;
+			edges2[l] = XMLoadFloat3(&v3.Position) - p1;
+
+			// s1, s2, t1, t2
+			XMVECTOR uv1 = XMLoadFloat2(&v1.UV);
+			uvDeltas[l] = XMVectorMergeXY(XMLoadFloat2(&v2.UV) - uv1, XMLoadFloat2(&v3.UV) - uv1);
+		}
+
+		// Transposed, so each vector holds one component of all
+		// four triangles
+		XMMATRIX edge1 = XMMatrixTranspose(XMMATRIX(edges1[0], edges1[1], edges1[2], edges1[3]));
+		XMMATRIX edge2 = XMMatrixTranspose(XMMATRIX(edges2[0], edges2[1], edges2[2], edges2[3]));
+		XMMATRIX uv = XMMatrixTranspose(XMMATRIX(uvDeltas[0], uvDeltas[1], uvDeltas[2], uvDeltas[3]));
+
+		XMVECTOR s1 = uv.r[0];
+		XMVECTOR s2 = uv.r[1];
+		XMVECTOR t1 = uv.r[2];
+		XMVECTOR t2 = uv.r[3];
+
+		// Triangles with no area in UV space add nothing
+		XMVECTOR det = s1 * t2 - s2 * t1;
+		XMVECTOR zero = XMVectorZero();
+		XMVECTOR r = XMVectorSelect(XMVectorReciprocal(det), zero, XMVectorEqual(det, zero));
+
+		XMVECTOR x = (t2 * edge1.r[0] - t1 * edge2.r[0]) * r;
+		XMVECTOR y = (t2 * edge1.r[1] - t1 * edge2.r[1]) * r;
+		XMVECTOR z = (t2 * edge1.r[2] - t1 * edge2.r[2]) * r;
+
+		// And back again, a triangle's tangent per vector
+		XMMATRIX tangents = XMMatrixTranspose(XMMATRIX(x, y, z, zero));
+
+		int count = min(4, last - t);
+		for (int l = 0; l < count; l++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				XMFLOAT3& sum = sums[indices[(t + l) * 3 + c]];
+				XMStoreFloat3(&sum, XMLoadFloat3(&sum) + tangents.r[l]);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Each thread adds its share of the triangles into sums of
+// its own, so no two threads write the same memory.  The
+// partial sums are then added up (in a fixed order, so the
+// result never depends on timing) and orthonormalized per
+// vert, also split across threads.
+// --------------------------------------------------------
+void TangentGenerator::Generate(Vertex * vertices, int vertNum, const UINT * indices, int indexNum, int threadCount)
+{
+	int triNum = indexNum / 3;
+	if (vertNum == 0)
+		return;
+
+	if (threadCount <= 0)
+		threadCount = max((int)std::thread::hardware_concurrency(), 1);
+	if (triNum < TANGENT_PARALLEL_MIN_TRIANGLES)
+		threadCount = 1;
+
+	std::vector<std::vector<XMFLOAT3>> sums(threadCount, std::vector<XMFLOAT3>(vertNum, XMFLOAT3(0, 0, 0)));
+
+	// Triangle ranges start on multiples of 4 to keep SIMD blocks whole
+	int triChunk = ((triNum + threadCount - 1) / threadCount + 3) & ~3;
+	WorkerPool::RunParallel(threadCount, [&](int i)
+	{
+		int first = min(i * triChunk, triNum);
+		int last = min(first + triChunk, triNum);
+		AccumulateTriangleTangents(vertices, indices, first, last, &sums[i][0]);
+	});
+
+	int vertChunk = (vertNum + threadCount - 1) / threadCount;
+	WorkerPool::RunParallel(threadCount, [&](int i)
+	{
+		int first = min(i * vertChunk, vertNum);
+		int last = min(first + vertChunk, vertNum);
+		for (int v = first; v < last; v++)
+		{
+			XMVECTOR sum = XMLoadFloat3(&sums[0][v]);
+			for (int t = 1; t < threadCount; t++)
+				sum = sum + XMLoadFloat3(&sums[t][v]);
+
+			vertices[v].Tangent = Orthonormalize(vertices[v].Normal, sum);
+		}
+	});
+}
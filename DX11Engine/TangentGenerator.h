@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Vertex.h"
+#include <d3d11.h>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Meshes with fewer triangles than this aren't worth the threads
+#define TANGENT_PARALLEL_MIN_TRIANGLES	16384
+
+// --------------------------------------------------------
+// Per-vertex tangents for indexed meshes, from each
+// triangle's UV mapping (Lengyel's method).
+//
+// Triangle tangents are worked out four at a time: their
+// verts are loaded as vectors and transposed so each SIMD
+// lane holds one triangle, and the tangents transposed back
+// to be summed per vert.  Large meshes split the triangles
+// between threads, each summing into its own copy of the
+// verts, then add the copies up and make every sum
+// orthonormal to its normal.
+// --------------------------------------------------------
+class TangentGenerator
+{
+public:
+	// threadCount = 0 uses every hardware thread
+	static void Generate(Vertex* vertices, int vertNum, const UINT* indices, int indexNum, int threadCount = 0);
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// A texture that may still be loading.  View starts out as
+// a one texel placeholder and is swapped for the real
+// texture on the main thread, so anything holding the handle
+// (rather than the view) picks it up on its next bind.
+// --------------------------------------------------------
+struct TextureHandle
+{
+	ID3D11ShaderResourceView* View;
+	bool Loaded;
+};
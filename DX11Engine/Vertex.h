@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 struct Vertex
 {
@@ -8,4 +9,35 @@ struct Vertex
 	DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT3 Tangent;
 	DirectX::XMFLOAT2 UV;
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// 20 byte version of Vertex, see VertexPacking for the
+// encoding.  Positions are relative to the mesh's bounds,
+// so they need the mesh's offset and scale to decode.
+// --------------------------------------------------------
+struct PackedVertex
+{
+	DirectX::PackedVector::XMUSHORTN4 Position;	// UNORM across the bounds, w unused
+	DirectX::PackedVector::XMSHORTN2 Normal;	// Octahedral
+	DirectX::PackedVector::XMSHORTN2 Tangent;	// Octahedral
+	DirectX::PackedVector::XMHALF2 UV;
+};
+
+// --------------------------------------------------------
+// Everything but the position, for meshes that keep their
+// positions in a separate stream (VERTEX_FORMAT_SPLIT)
+// --------------------------------------------------------
+struct VertexAttributes
+{
+	DirectX::XMFLOAT3 Normal;
+	DirectX::XMFLOAT3 Tangent;
+	DirectX::XMFLOAT2 UV;
+};
+
+struct PackedVertexAttributes
+{
+	DirectX::PackedVector::XMSHORTN2 Normal;	// Octahedral
+	DirectX::PackedVector::XMSHORTN2 Tangent;	// Octahedral
+	DirectX::PackedVector::XMHALF2 UV;
+};
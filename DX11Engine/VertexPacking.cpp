@@ -0,0 +1,256 @@
+#include "VertexPacking.h"
+#include <vector>
+#include <cmath>
+
+using namespace DirectX::PackedVector;
+
+static const D3D11_INPUT_ELEMENT_DESC InputElements[VERTEX_FORMAT_COUNT][VERTEX_ELEMENT_COUNT] =
+{
+	// VERTEX_FORMAT_FULL
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Vertex, UV), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	},
+	// VERTEX_FORMAT_PACKED
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(PackedVertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(PackedVertex, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(PackedVertex, UV), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	},
+	// VERTEX_FORMAT_SPLIT
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, offsetof(VertexAttributes, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, offsetof(VertexAttributes, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, offsetof(VertexAttributes, UV), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	},
+	// VERTEX_FORMAT_PACKED_SPLIT - float positions, so the packed
+	// shader decodes them with an offset of 0 and a scale of 1
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 1, offsetof(PackedVertexAttributes, Normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 1, offsetof(PackedVertexAttributes, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 1, offsetof(PackedVertexAttributes, UV), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	}
+};
+
+// Quantizes a value in [0, 1] to a 16-bit UNORM
+static unsigned short QuantizeUnorm(float value)
+{
+	value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (unsigned short)(value * 65535.0f + 0.5f);
+}
+
+// SNORMs decode -32768 and -32767 both to -1, so only the latter is used
+static float DecodeSnorm(short value)
+{
+	return max(value / 32767.0f, -1.0f);
+}
+
+static XMFLOAT3 DecodeOctahedral(float x, float y)
+{
+	XMFLOAT3 n(x, y, 1.0f - fabsf(x) - fabsf(y));
+
+	// Unfold the lower hemisphere
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+// Angle in degrees; atan2 stays accurate for tiny angles where acos doesn't
+static float AngleBetween(FXMVECTOR a, FXMVECTOR b)
+{
+	float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(a, b)));
+	float cosine = XMVectorGetX(XMVector3Dot(a, b));
+	return XMConvertToDegrees(atan2f(sine, cosine));
+}
+
+void VertexPacking::Pack(const Vertex * vertices, int vertNum, XMFLOAT3 offset, XMFLOAT3 scale, PackedVertex * packed)
+{
+	// Zero scale means the bounds are flat on that axis
+	XMFLOAT3 invScale(
+		scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+		scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+		scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+
+	for (int i = 0; i < vertNum; i++)
+	{
+		const Vertex& v = vertices[i];
+		PackedVertex& p = packed[i];
+
+		p.Position.x = QuantizeUnorm((v.Position.x - offset.x) * invScale.x);
+		p.Position.y = QuantizeUnorm((v.Position.y - offset.y) * invScale.y);
+		p.Position.z = QuantizeUnorm((v.Position.z - offset.z) * invScale.z);
+		p.Position.w = 0;
+
+		p.Normal = EncodeOctahedral(v.Normal);
+		p.Tangent = EncodeOctahedral(v.Tangent);
+
+		p.UV.x = XMConvertFloatToHalf(v.UV.x);
+		p.UV.y = XMConvertFloatToHalf(v.UV.y);
+	}
+}
+
+void VertexPacking::Unpack(const PackedVertex * packed, int vertNum, XMFLOAT3 offset, XMFLOAT3 scale, Vertex * vertices)
+{
+	for (int i = 0; i < vertNum; i++)
+	{
+		const PackedVertex& p = packed[i];
+		Vertex& v = vertices[i];
+
+		v.Position.x = offset.x + (p.Position.x / 65535.0f) * scale.x;
+		v.Position.y = offset.y + (p.Position.y / 65535.0f) * scale.y;
+		v.Position.z = offset.z + (p.Position.z / 65535.0f) * scale.z;
+
+		v.Normal = DecodeOctahedral(p.Normal);
+		v.Tangent = DecodeOctahedral(p.Tangent);
+
+		v.UV.x = XMConvertHalfToFloat(p.UV.x);
+		v.UV.y = XMConvertHalfToFloat(p.UV.y);
+	}
+}
+
+void VertexPacking::CalculatePositionRange(const Vertex * vertices, int vertNum, XMFLOAT3 & offset, XMFLOAT3 & scale)
+{
+	offset = XMFLOAT3(0, 0, 0);
+	scale = XMFLOAT3(0, 0, 0);
+	if (vertNum == 0)
+		return;
+
+	XMVECTOR boundsMin = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR boundsMax = boundsMin;
+	for (int i = 1; i < vertNum; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&vertices[i].Position);
+		boundsMin = XMVectorMin(boundsMin, pos);
+		boundsMax = XMVectorMax(boundsMax, pos);
+	}
+
+	XMStoreFloat3(&offset, boundsMin);
+	XMStoreFloat3(&scale, boundsMax - boundsMin);
+}
+
+// --------------------------------------------------------
+// Projects the direction onto an octahedron and unfolds it
+// into a square.  Rounding each coordinate to the nearest
+// SNORM isn't always the closest direction, so all four
+// neighbouring codes are tried and the best one kept.
+// --------------------------------------------------------
+XMSHORTN2 VertexPacking::EncodeOctahedral(XMFLOAT3 direction)
+{
+	XMSHORTN2 encoded;
+	encoded.x = 0;
+	encoded.y = 0;
+
+	float length = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+	if (length == 0.0f)
+		return encoded;
+
+	float x = direction.x / length;
+	float y = direction.y / length;
+	if (direction.z < 0.0f)
+	{
+		float foldX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldX;
+		y = foldY;
+	}
+
+	XMVECTOR target = XMVector3Normalize(XMLoadFloat3(&direction));
+	float best = -2.0f;
+
+	for (int i = 0; i < 4; i++)
+	{
+		float qx = (i & 1) ? ceilf(x * 32767.0f) : floorf(x * 32767.0f);
+		float qy = (i & 2) ? ceilf(y * 32767.0f) : floorf(y * 32767.0f);
+		qx = max(-32767.0f, min(32767.0f, qx));
+		qy = max(-32767.0f, min(32767.0f, qy));
+
+		XMFLOAT3 decoded = ::DecodeOctahedral(qx / 32767.0f, qy / 32767.0f);
+		float similarity = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&decoded), target));
+		if (similarity > best)
+		{
+			best = similarity;
+			encoded.x = (short)qx;
+			encoded.y = (short)qy;
+		}
+	}
+
+	return encoded;
+}
+
+XMFLOAT3 VertexPacking::DecodeOctahedral(XMSHORTN2 encoded)
+{
+	return ::DecodeOctahedral(DecodeSnorm(encoded.x), DecodeSnorm(encoded.y));
+}
+
+VertexPackingError VertexPacking::MeasureError(const Vertex * vertices, int vertNum)
+{
+	VertexPackingError error = {};
+	if (vertNum == 0)
+		return error;
+
+	XMFLOAT3 offset, scale;
+	CalculatePositionRange(vertices, vertNum, offset, scale);
+
+	std::vector<PackedVertex> packed(vertNum);
+	std::vector<Vertex> unpacked(vertNum);
+	Pack(vertices, vertNum, offset, scale, &packed[0]);
+	Unpack(&packed[0], vertNum, offset, scale, &unpacked[0]);
+
+	for (int i = 0; i < vertNum; i++)
+	{
+		const Vertex& a = vertices[i];
+		const Vertex& b = unpacked[i];
+
+		XMVECTOR distance = XMVector3Length(XMLoadFloat3(&a.Position) - XMLoadFloat3(&b.Position));
+		error.Position = max(error.Position, XMVectorGetX(distance));
+
+		// Compare against the normalized source, only the direction is stored
+		XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&a.Normal));
+		XMVECTOR tangent = XMVector3Normalize(XMLoadFloat3(&a.Tangent));
+		error.Normal = max(error.Normal, AngleBetween(normal, XMLoadFloat3(&b.Normal)));
+		error.Tangent = max(error.Tangent, AngleBetween(tangent, XMLoadFloat3(&b.Tangent)));
+
+		error.UV = max(error.UV, max(fabsf(a.UV.x - b.UV.x), fabsf(a.UV.y - b.UV.y)));
+	}
+
+	return error;
+}
+
+const D3D11_INPUT_ELEMENT_DESC * VertexPacking::GetInputElements(MeshVertexFormat format)
+{
+	return InputElements[format];
+}
+
+HRESULT VertexPacking::CreateInputLayout(ID3D11Device * device, MeshVertexFormat format, const void * shaderBytecode, SIZE_T bytecodeLength, ID3D11InputLayout ** inputLayout)
+{
+	return device->CreateInputLayout(
+		InputElements[format],
+		VERTEX_ELEMENT_COUNT,
+		shaderBytecode,
+		bytecodeLength,
+		inputLayout);
+}
+
+int VertexPacking::GetStreamCount(MeshVertexFormat format)
+{
+	return (format & VERTEX_FORMAT_SPLIT) ? 2 : 1;
+}
+
+UINT VertexPacking::GetStride(MeshVertexFormat format, int slot)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_PACKED: return sizeof(PackedVertex);
+	case VERTEX_FORMAT_SPLIT: return slot == 0 ? sizeof(XMFLOAT3) : sizeof(VertexAttributes);
+	case VERTEX_FORMAT_PACKED_SPLIT: return slot == 0 ? sizeof(XMFLOAT3) : sizeof(PackedVertexAttributes);
+	default: return sizeof(Vertex);
+	}
+}
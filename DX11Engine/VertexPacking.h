@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Vertex.h"
+#include <d3d11.h>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Number of elements in every mesh input layout
+#define VERTEX_ELEMENT_COUNT	4
+
+// --------------------------------------------------------
+// Vertex layout used by a mesh's vertex buffers.  PACKED and
+// SPLIT are flags and can be combined.
+//
+// Split meshes keep float positions in their own tightly
+// packed stream (slot 0) and the rest in a second stream
+// (slot 1), so position-only passes fetch 12 bytes a vertex.
+// --------------------------------------------------------
+enum MeshVertexFormat
+{
+	VERTEX_FORMAT_FULL = 0,				// Vertex, 44 bytes of floats
+	VERTEX_FORMAT_PACKED = 1,			// PackedVertex, 20 bytes
+	VERTEX_FORMAT_SPLIT = 2,			// XMFLOAT3 + VertexAttributes, 12 + 32 bytes
+	VERTEX_FORMAT_PACKED_SPLIT = 3,		// XMFLOAT3 + PackedVertexAttributes, 12 + 12 bytes
+	VERTEX_FORMAT_COUNT
+};
+
+// --------------------------------------------------------
+// Largest differences between a set of verts and the same
+// verts after a round trip through PackedVertex
+// --------------------------------------------------------
+struct VertexPackingError
+{
+	float Position;		// Distance, in model units
+	float Normal;		// Angle, in degrees
+	float Tangent;		// Angle, in degrees
+	float UV;			// Difference in either coordinate
+};
+
+// --------------------------------------------------------
+// Converts between Vertex and PackedVertex.
+//
+// Normals and tangents are octahedral encoded into two
+// 16-bit SNORMs, UVs are half floats and positions are 16-bit
+// UNORMs spanning the mesh's bounds.  The GPU gets the same
+// values back with
+//    position = offset + unorm * scale
+// and the octahedral decode in PackedVertexShader.hlsl.
+// --------------------------------------------------------
+class VertexPacking
+{
+public:
+	static void Pack(const Vertex* vertices, int vertNum, XMFLOAT3 offset, XMFLOAT3 scale, PackedVertex* packed);
+	static void Unpack(const PackedVertex* packed, int vertNum, XMFLOAT3 offset, XMFLOAT3 scale, Vertex* vertices);
+
+	// Offset and scale that map the verts' bounds onto 0-1
+	static void CalculatePositionRange(const Vertex* vertices, int vertNum, XMFLOAT3& offset, XMFLOAT3& scale);
+
+	static PackedVector::XMSHORTN2 EncodeOctahedral(XMFLOAT3 direction);
+	static XMFLOAT3 DecodeOctahedral(PackedVector::XMSHORTN2 encoded);
+
+	// Packs and unpacks the verts to see how much was lost
+	static VertexPackingError MeasureError(const Vertex* vertices, int vertNum);
+
+	// Input layouts for each format.  The packed formats can't be
+	// reflected from a shader (it only sees floats) and the split
+	// ones use two slots, so layouts are built from these instead.
+	static const D3D11_INPUT_ELEMENT_DESC* GetInputElements(MeshVertexFormat format);
+	static HRESULT CreateInputLayout(ID3D11Device* device, MeshVertexFormat format, const void* shaderBytecode, SIZE_T bytecodeLength, ID3D11InputLayout** inputLayout);
+
+	// Number of vertex streams a format uses, and the stride of each.
+	// Split formats have positions in slot 0 and the rest in slot 1.
+	static int GetStreamCount(MeshVertexFormat format);
+	static UINT GetStride(MeshVertexFormat format, int slot);
+};
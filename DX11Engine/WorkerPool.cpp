@@ -0,0 +1,111 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threadNum)
+{
+	job = 0;
+	jobNum = 0;
+	generation = 0;
+	busyWorkers = 0;
+	stopping = false;
+	nextJob = 0;
+
+	if (threadNum <= 0)
+		threadNum = (int)std::thread::hardware_concurrency() - 1;
+	if (threadNum < 1)
+		threadNum = 1;
+
+	for (int i = 0; i < threadNum; i++)
+		workers.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	started.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+int WorkerPool::GetThreadCount()
+{
+	return (int)workers.size() + 1;
+}
+
+void WorkerPool::Run(int jobNum, const std::function<void(int)>& job)
+{
+	// Not worth waking anyone for
+	if (jobNum <= 1)
+	{
+		if (jobNum == 1)
+			job(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->job = &job;
+		this->jobNum = jobNum;
+		nextJob = 0;
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	started.notify_all();
+
+	RunJobs();
+
+	// Every worker has to have seen this Run before the next
+	// one can change what it's running
+	std::unique_lock<std::mutex> guard(lock);
+	finished.wait(guard, [this] { return busyWorkers == 0; });
+	this->job = 0;
+}
+
+void WorkerPool::RunParallel(int jobNum, const std::function<void(int)>& job)
+{
+	std::vector<std::thread> threads;
+	for (int i = 1; i < jobNum; i++)
+		threads.push_back(std::thread(job, i));
+
+	if (jobNum > 0)
+		job(0);
+
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned int seen = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			started.wait(guard, [this, seen] { return stopping || generation != seen; });
+			if (stopping)
+				break;
+
+			seen = generation;
+		}
+
+		RunJobs();
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			last = --busyWorkers == 0;
+		}
+		if (last)
+			finished.notify_one();
+	}
+}
+
+void WorkerPool::RunJobs()
+{
+	for (int i = nextJob++; i < jobNum; i = nextJob++)
+		(*job)(i);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// --------------------------------------------------------
+// Threads kept around for work that's split up every frame,
+// where starting threads each time would cost more than the
+// work itself.
+//
+// Run hands out job indices to the workers and the calling
+// thread, a job at a time until they're gone, and returns
+// once every one has finished.  Jobs can finish in any order,
+// so anything that has to be deterministic should write
+// results to a slot of its own and be combined afterwards.
+// --------------------------------------------------------
+class WorkerPool
+{
+public:
+	// threadNum of 0 uses one thread per core, less the caller's
+	WorkerPool(int threadNum = 0);
+	~WorkerPool();
+
+	// Threads that work on a Run, counting the caller
+	int GetThreadCount();
+
+	// Runs job(0) .. job(jobNum - 1).  Only one thread may be
+	// in Run at a time.
+	void Run(int jobNum, const std::function<void(int)>& job);
+
+	// Runs job(0) .. job(jobNum - 1) on threads started for the
+	// call, one job each, the first on the calling thread.  For
+	// one-off work with no pool to hand, like loading a file.
+	static void RunParallel(int jobNum, const std::function<void(int)>& job);
+
+private:
+	void WorkerLoop();
+	void RunJobs();
+
+	std::mutex lock;
+	std::condition_variable started;
+	std::condition_variable finished;
+
+	// Set under lock for each Run
+	const std::function<void(int)>* job;
+	int jobNum;
+	unsigned int generation;	// Bumped by every Run, so workers see it's new
+	int busyWorkers;
+	bool stopping;
+
+	std::atomic<int> nextJob;
+
+	std::vector<std::thread> workers;
+};